@@ -38,6 +38,20 @@
 #include "stats.h"
 #include "parallel.h"
 #include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#ifdef PBRT_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+#if defined(PBRT_HAVE_AVX) && !defined(PBRT_FLOAT_AS_DOUBLE)
+#include <immintrin.h>
+#elif defined(PBRT_HAVE_SSE) && !defined(PBRT_FLOAT_AS_DOUBLE)
+#include <xmmintrin.h>
+#endif
 
 namespace pbrt {
 
@@ -45,6 +59,17 @@ STAT_MEMORY_COUNTER("Memory/BVH tree", treeBytes);
 STAT_RATIO("BVH/Primitives per leaf node", totalPrimitives, totalLeafNodes);
 STAT_COUNTER("BVH/Interior nodes", interiorNodes);
 STAT_COUNTER("BVH/Leaf nodes", leafNodes);
+STAT_COUNTER("BVH/Packet traversals", nPacketTraversals);
+STAT_COUNTER("BVH/Packet single-ray fallbacks", nPacketFallbacks);
+STAT_COUNTER("BVH/Wide interior nodes", wideInteriorNodes);
+STAT_PERCENT("BVH/Cache hits", nCacheHits, nCacheLookups);
+STAT_COUNTER("BVH/SBVH spatial splits", nSpatialSplits);
+STAT_COUNTER("BVH/SBVH duplicated references", nDuplicatedReferences);
+STAT_INT_DISTRIBUTION("BVH/Nodes visited per ray", nodesVisitedPerRay);
+STAT_INT_DISTRIBUTION("BVH/Primitives tested per ray", primitivesTestedPerRay);
+STAT_COUNTER("BVH/Refits", nRefits);
+STAT_PERCENT("BVH/Triangle block lanes passed to exact test",
+             nTriangleCandidates, nTriangleBlockLanes);
 
 // BVHAccel Local Declarations
 struct BVHPrimitiveInfo {
@@ -103,7 +128,565 @@ struct LinearBVHNode {
     uint8_t pad[1];        // ensure 32 byte total size
 };
 
+template <int Width>
+struct WideBVHNode {
+    static PBRT_CONSTEXPR int width = Width;
+    Float bounds[2][3][Width];      // [pMin/pMax][axis][child], SoA
+    int32_t offset[Width];          // child node index or first primitive
+    uint16_t nPrimitives[Width];    // 0 -> interior child
+    uint8_t nChildren;
+};
+
+template <int Width, typename Quant>
+struct QuantizedBVHNode {
+    // QuantizedBVHNode Public Methods
+    QuantizedBVHNode() {}
+    explicit QuantizedBVHNode(const WideBVHNode<Width> &wide)
+        : nChildren(wide.nChildren) {
+        const int maxQ = std::numeric_limits<Quant>::max();
+        for (int c = 0; c < Width; ++c) {
+            offset[c] = wide.offset[c];
+            nPrimitives[c] = wide.nPrimitives[c];
+        }
+        for (int axis = 0; axis < 3; ++axis) {
+            // Quantize relative to the union of the children's bounds
+            Float lo = Infinity, hi = -Infinity;
+            for (int c = 0; c < nChildren; ++c) {
+                lo = std::min(lo, wide.bounds[0][axis][c]);
+                hi = std::max(hi, wide.bounds[1][axis][c]);
+            }
+            origin[axis] = lo;
+
+            // Use a power-of-two _scale_ so that $q \cdot scale$ is exact
+            // and decoding rounds the same way with or without FMA
+            int exponent;
+            std::frexp((hi - lo) / maxQ, &exponent);
+            scale[axis] = std::ldexp(Float(1), exponent);
+            while (lo + maxQ * scale[axis] < hi) scale[axis] *= 2;
+
+            // Round each child's bounds outward so decoded boxes enclose it
+            for (int c = 0; c < Width; ++c) {
+                if (c >= nChildren) {
+                    qBounds[0][axis][c] = qBounds[1][axis][c] = 0;
+                    continue;
+                }
+                Float cLo = wide.bounds[0][axis][c];
+                Float cHi = wide.bounds[1][axis][c];
+                int qLo =
+                    (int)Clamp(std::floor((cLo - lo) / scale[axis]), 0, maxQ);
+                while (qLo > 0 && lo + qLo * scale[axis] > cLo) --qLo;
+                int qHi =
+                    (int)Clamp(std::ceil((cHi - lo) / scale[axis]), 0, maxQ);
+                while (qHi < maxQ && lo + qHi * scale[axis] < cHi) ++qHi;
+                qBounds[0][axis][c] = qLo;
+                qBounds[1][axis][c] = qHi;
+            }
+        }
+    }
+    void Decode(Float bounds[2][3][Width]) const {
+        for (int side = 0; side < 2; ++side)
+            for (int axis = 0; axis < 3; ++axis)
+                for (int c = 0; c < Width; ++c)
+                    bounds[side][axis][c] =
+                        origin[axis] + qBounds[side][axis][c] * scale[axis];
+    }
+
+    // QuantizedBVHNode Public Data
+    static PBRT_CONSTEXPR int width = Width;
+    Float origin[3], scale[3];
+    Quant qBounds[2][3][Width];     // [pMin/pMax][axis][child], SoA
+    int32_t offset[Width];
+    uint16_t nPrimitives[Width];
+    uint8_t nChildren;
+};
+
+// Returns a bit mask of the first _nChildren_ boxes in _bounds_ overlapped
+// by the ray and their entry distances; exits are scaled by
+// $1 + 2\gamma_3$ as in _Bounds3::IntersectP()_.
+template <int Width>
+inline int IntersectChildBounds(const Float bounds[2][3][Width],
+                                int nChildren, const Float o[3],
+                                const Float invDir[3], const int dirIsNeg[3],
+                                Float tMax, Float tEnter[Width]) {
+    int mask = 0;
+    for (int c = 0; c < nChildren; ++c) {
+        Float t0 = 0, t1 = tMax;
+        for (int axis = 0; axis < 3; ++axis) {
+            Float tNear =
+                (bounds[dirIsNeg[axis]][axis][c] - o[axis]) * invDir[axis];
+            Float tFar =
+                (bounds[1 - dirIsNeg[axis]][axis][c] - o[axis]) * invDir[axis];
+            tFar *= 1 + 2 * gamma(3);
+            t0 = tNear > t0 ? tNear : t0;
+            t1 = tFar < t1 ? tFar : t1;
+        }
+        tEnter[c] = t0;
+        if (t0 <= t1) mask |= 1 << c;
+    }
+    return mask;
+}
+
+#if defined(PBRT_HAVE_SSE) && !defined(PBRT_FLOAT_AS_DOUBLE)
+template <>
+inline int IntersectChildBounds<4>(const Float bounds[2][3][4], int nChildren,
+                                   const Float o[3], const Float invDir[3],
+                                   const int dirIsNeg[3], Float tMax,
+                                   Float tEnter[4]) {
+    const __m128 robust = _mm_set1_ps(1 + 2 * gamma(3));
+    __m128 t0 = _mm_setzero_ps(), t1 = _mm_set1_ps(tMax);
+    for (int axis = 0; axis < 3; ++axis) {
+        __m128 org = _mm_set1_ps(o[axis]), inv = _mm_set1_ps(invDir[axis]);
+        __m128 tNear = _mm_mul_ps(
+            _mm_sub_ps(_mm_loadu_ps(bounds[dirIsNeg[axis]][axis]), org), inv);
+        __m128 tFar = _mm_mul_ps(
+            _mm_sub_ps(_mm_loadu_ps(bounds[1 - dirIsNeg[axis]][axis]), org),
+            inv);
+        t0 = _mm_max_ps(tNear, t0);
+        t1 = _mm_min_ps(_mm_mul_ps(tFar, robust), t1);
+    }
+    _mm_storeu_ps(tEnter, t0);
+    return _mm_movemask_ps(_mm_cmple_ps(t0, t1)) & ((1 << nChildren) - 1);
+}
+#endif
+
+#if defined(PBRT_HAVE_AVX) && !defined(PBRT_FLOAT_AS_DOUBLE)
+template <>
+inline int IntersectChildBounds<8>(const Float bounds[2][3][8], int nChildren,
+                                   const Float o[3], const Float invDir[3],
+                                   const int dirIsNeg[3], Float tMax,
+                                   Float tEnter[8]) {
+    const __m256 robust = _mm256_set1_ps(1 + 2 * gamma(3));
+    __m256 t0 = _mm256_setzero_ps(), t1 = _mm256_set1_ps(tMax);
+    for (int axis = 0; axis < 3; ++axis) {
+        __m256 org = _mm256_set1_ps(o[axis]);
+        __m256 inv = _mm256_set1_ps(invDir[axis]);
+        __m256 tNear = _mm256_mul_ps(
+            _mm256_sub_ps(_mm256_loadu_ps(bounds[dirIsNeg[axis]][axis]), org),
+            inv);
+        __m256 tFar = _mm256_mul_ps(
+            _mm256_sub_ps(_mm256_loadu_ps(bounds[1 - dirIsNeg[axis]][axis]),
+                          org),
+            inv);
+        t0 = _mm256_max_ps(tNear, t0);
+        t1 = _mm256_min_ps(_mm256_mul_ps(tFar, robust), t1);
+    }
+    _mm256_storeu_ps(tEnter, t0);
+    return _mm256_movemask_ps(_mm256_cmp_ps(t0, t1, _CMP_LE_OQ)) &
+           ((1 << nChildren) - 1);
+}
+#endif
+
+template <int Width>
+inline int IntersectChildren(const WideBVHNode<Width> &node, const Float o[3],
+                             const Float invDir[3], const int dirIsNeg[3],
+                             Float tMax, Float tEnter[Width]) {
+    return IntersectChildBounds<Width>(node.bounds, node.nChildren, o, invDir,
+                                       dirIsNeg, tMax, tEnter);
+}
+
+template <int Width, typename Quant>
+inline int IntersectChildren(const QuantizedBVHNode<Width, Quant> &node,
+                             const Float o[3], const Float invDir[3],
+                             const int dirIsNeg[3], Float tMax,
+                             Float tEnter[Width]) {
+    // Decode the children's bounds on the fly
+    Float bounds[2][3][Width];
+    node.Decode(bounds);
+    return IntersectChildBounds<Width>(bounds, node.nChildren, o, invDir,
+                                       dirIsNeg, tMax, tEnter);
+}
+
+template <int Width, typename Quant>
+QuantizedBVHNode<Width, Quant> *QuantizeBVHNodes(
+    const WideBVHNode<Width> *wideNodes, int nNodes) {
+    QuantizedBVHNode<Width, Quant> *quantized =
+        AllocAligned<QuantizedBVHNode<Width, Quant>>(nNodes);
+    for (int i = 0; i < nNodes; ++i)
+        quantized[i] = QuantizedBVHNode<Width, Quant>(wideNodes[i]);
+    return quantized;
+}
+
+struct BVHRayPacket {
+    // BVHRayPacket Public Methods
+    void Set(int lane, const Ray &ray) {
+        ox[lane] = ray.o.x;
+        oy[lane] = ray.o.y;
+        oz[lane] = ray.o.z;
+        invDx[lane] = 1 / ray.d.x;
+        invDy[lane] = 1 / ray.d.y;
+        invDz[lane] = 1 / ray.d.z;
+        tMax[lane] = ray.tMax;
+        dirIsNeg[lane][0] = invDx[lane] < 0;
+        dirIsNeg[lane][1] = invDy[lane] < 0;
+        dirIsNeg[lane][2] = invDz[lane] < 0;
+    }
+    void Clear(int lane) {
+        ox[lane] = oy[lane] = oz[lane] = 0;
+        invDx[lane] = invDy[lane] = invDz[lane] = 1;
+        tMax[lane] = -1;
+        dirIsNeg[lane][0] = dirIsNeg[lane][1] = dirIsNeg[lane][2] = 0;
+    }
+    int IntersectP(const Bounds3f &b) const;
+
+    // BVHRayPacket Public Data
+    Float ox[BVHPacketSize], oy[BVHPacketSize], oz[BVHPacketSize];
+    Float invDx[BVHPacketSize], invDy[BVHPacketSize], invDz[BVHPacketSize];
+    Float tMax[BVHPacketSize];
+    int dirIsNeg[BVHPacketSize][3];
+};
+
+// Returns a bit mask of the packet's lanes whose rays overlap _b_; like
+// _Bounds3::IntersectP()_, slab exits are scaled by $1 + 2\gamma_3$ so that
+// rounding never culls a node that the ray actually enters.
+#if defined(PBRT_HAVE_AVX) && !defined(PBRT_FLOAT_AS_DOUBLE)
+int BVHRayPacket::IntersectP(const Bounds3f &b) const {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 robust = _mm256_set1_ps(1 + 2 * gamma(3));
+    __m256 tEnter = zero, tExit = _mm256_loadu_ps(tMax);
+    auto slab = [&](Float lo, Float hi, const Float *o, const Float *invD) {
+        __m256 org = _mm256_loadu_ps(o), inv = _mm256_loadu_ps(invD);
+        __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(lo), org), inv);
+        __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(hi), org), inv);
+        tEnter = _mm256_max_ps(_mm256_min_ps(t0, t1), tEnter);
+        tExit = _mm256_min_ps(_mm256_mul_ps(_mm256_max_ps(t0, t1), robust),
+                              tExit);
+    };
+    slab(b.pMin.x, b.pMax.x, ox, invDx);
+    slab(b.pMin.y, b.pMax.y, oy, invDy);
+    slab(b.pMin.z, b.pMax.z, oz, invDz);
+    return _mm256_movemask_ps(_mm256_cmp_ps(tEnter, tExit, _CMP_LE_OQ));
+}
+#elif defined(PBRT_HAVE_SSE) && !defined(PBRT_FLOAT_AS_DOUBLE)
+int BVHRayPacket::IntersectP(const Bounds3f &b) const {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 robust = _mm_set1_ps(1 + 2 * gamma(3));
+    __m128 tEnter = zero, tExit = _mm_loadu_ps(tMax);
+    auto slab = [&](Float lo, Float hi, const Float *o, const Float *invD) {
+        __m128 org = _mm_loadu_ps(o), inv = _mm_loadu_ps(invD);
+        __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(lo), org), inv);
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(hi), org), inv);
+        tEnter = _mm_max_ps(_mm_min_ps(t0, t1), tEnter);
+        tExit = _mm_min_ps(_mm_mul_ps(_mm_max_ps(t0, t1), robust), tExit);
+    };
+    slab(b.pMin.x, b.pMax.x, ox, invDx);
+    slab(b.pMin.y, b.pMax.y, oy, invDy);
+    slab(b.pMin.z, b.pMax.z, oz, invDz);
+    return _mm_movemask_ps(_mm_cmple_ps(tEnter, tExit));
+}
+#else
+int BVHRayPacket::IntersectP(const Bounds3f &b) const {
+    int mask = 0;
+    for (int lane = 0; lane < BVHPacketSize; ++lane) {
+        Float tEnter = 0, tExit = tMax[lane];
+        const Float o[3] = {ox[lane], oy[lane], oz[lane]};
+        const Float invD[3] = {invDx[lane], invDy[lane], invDz[lane]};
+        for (int axis = 0; axis < 3; ++axis) {
+            Float t0 = (b.pMin[axis] - o[axis]) * invD[axis];
+            Float t1 = (b.pMax[axis] - o[axis]) * invD[axis];
+            if (t0 > t1) std::swap(t0, t1);
+            t1 *= 1 + 2 * gamma(3);
+            tEnter = t0 > tEnter ? t0 : tEnter;
+            tExit = t1 < tExit ? t1 : tExit;
+        }
+        if (tEnter <= tExit) mask |= 1 << lane;
+    }
+    return mask;
+}
+#endif
+
+// BVHAccel Triangle Block Width
+#if defined(PBRT_HAVE_AVX) && !defined(PBRT_FLOAT_AS_DOUBLE)
+static PBRT_CONSTEXPR int TriangleBlockWidth = 8;
+#else
+static PBRT_CONSTEXPR int TriangleBlockWidth = 4;
+#endif
+
+// The per-ray part of the watertight test in _Triangle::Intersect()_: the
+// ray origin and the shear, with axes permuted so that $z$ is the
+// direction's largest component
+struct TriangleRay {
+    TriangleRay() {}
+    explicit TriangleRay(const Ray &ray) {
+        kz = MaxDimension(Abs(ray.d));
+        kx = kz + 1;
+        if (kx == 3) kx = 0;
+        ky = kx + 1;
+        if (ky == 3) ky = 0;
+        Vector3f d = Permute(ray.d, kx, ky, kz);
+        Sx = -d.x / d.z;
+        Sy = -d.y / d.z;
+        Sz = 1.f / d.z;
+        o[0] = ray.o[kx];
+        o[1] = ray.o[ky];
+        o[2] = ray.o[kz];
+    }
+    int kx, ky, kz;
+    Float o[3];
+    Float Sx, Sy, Sz;
+};
+
+// Vertices of up to _TriangleBlockWidth_ triangles from one BVH leaf,
+// stored by vertex, then axis, then triangle
+struct TriangleBlock {
+    int Intersect(const TriangleRay &ray, Float tMax, int nTriangles) const;
+    Float p[3][3][TriangleBlockWidth];
+};
+
+// Returns a bit mask of the first _nTriangles_ triangles that
+// _Triangle::Intersect()_ may report as hit. The edge functions,
+// determinant and scaled $t$ are computed with the same operations in the
+// same order as there, so a triangle is culled only if the exact test
+// rejects it too; triangles with a zero edge function, which that test
+// retries in double precision, are always returned.
+#if defined(PBRT_HAVE_AVX) && !defined(PBRT_FLOAT_AS_DOUBLE)
+int TriangleBlock::Intersect(const TriangleRay &ray, Float tMax,
+                             int nTriangles) const {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 Sx = _mm256_set1_ps(ray.Sx), Sy = _mm256_set1_ps(ray.Sy);
+    const __m256 Sz = _mm256_set1_ps(ray.Sz);
+    __m256 x[3], y[3], z[3];
+    for (int v = 0; v < 3; ++v) {
+        z[v] = _mm256_sub_ps(_mm256_load_ps(p[v][ray.kz]),
+                             _mm256_set1_ps(ray.o[2]));
+        x[v] = _mm256_add_ps(_mm256_sub_ps(_mm256_load_ps(p[v][ray.kx]),
+                                           _mm256_set1_ps(ray.o[0])),
+                             _mm256_mul_ps(Sx, z[v]));
+        y[v] = _mm256_add_ps(_mm256_sub_ps(_mm256_load_ps(p[v][ray.ky]),
+                                           _mm256_set1_ps(ray.o[1])),
+                             _mm256_mul_ps(Sy, z[v]));
+    }
+    __m256 e[3];
+    for (int i = 0; i < 3; ++i) {
+        int a = (i + 1) % 3, b = (i + 2) % 3;
+        e[i] = _mm256_sub_ps(_mm256_mul_ps(x[a], y[b]),
+                             _mm256_mul_ps(y[a], x[b]));
+    }
+    __m256 edgeZero = zero, edgeNeg = zero, edgePos = zero;
+    for (int i = 0; i < 3; ++i) {
+        edgeZero =
+            _mm256_or_ps(edgeZero, _mm256_cmp_ps(e[i], zero, _CMP_EQ_OQ));
+        edgeNeg = _mm256_or_ps(edgeNeg, _mm256_cmp_ps(e[i], zero, _CMP_LT_OQ));
+        edgePos = _mm256_or_ps(edgePos, _mm256_cmp_ps(e[i], zero, _CMP_GT_OQ));
+    }
+    __m256 det = _mm256_add_ps(_mm256_add_ps(e[0], e[1]), e[2]);
+    __m256 tScaled = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(e[0], _mm256_mul_ps(z[0], Sz)),
+                      _mm256_mul_ps(e[1], _mm256_mul_ps(z[1], Sz))),
+        _mm256_mul_ps(e[2], _mm256_mul_ps(z[2], Sz)));
+    __m256 tMaxDet = _mm256_mul_ps(_mm256_set1_ps(tMax), det);
+    __m256 culled = _mm256_or_ps(_mm256_and_ps(edgeNeg, edgePos),
+                                 _mm256_cmp_ps(det, zero, _CMP_EQ_OQ));
+    culled = _mm256_or_ps(
+        culled,
+        _mm256_and_ps(
+            _mm256_cmp_ps(det, zero, _CMP_LT_OQ),
+            _mm256_or_ps(_mm256_cmp_ps(tScaled, zero, _CMP_GE_OQ),
+                         _mm256_cmp_ps(tScaled, tMaxDet, _CMP_LT_OQ))));
+    culled = _mm256_or_ps(
+        culled,
+        _mm256_and_ps(
+            _mm256_cmp_ps(det, zero, _CMP_GT_OQ),
+            _mm256_or_ps(_mm256_cmp_ps(tScaled, zero, _CMP_LE_OQ),
+                         _mm256_cmp_ps(tScaled, tMaxDet, _CMP_GT_OQ))));
+    return (~_mm256_movemask_ps(culled) | _mm256_movemask_ps(edgeZero)) &
+           ((1 << nTriangles) - 1);
+}
+#elif defined(PBRT_HAVE_SSE) && !defined(PBRT_FLOAT_AS_DOUBLE)
+int TriangleBlock::Intersect(const TriangleRay &ray, Float tMax,
+                             int nTriangles) const {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 Sx = _mm_set1_ps(ray.Sx), Sy = _mm_set1_ps(ray.Sy);
+    const __m128 Sz = _mm_set1_ps(ray.Sz);
+    __m128 x[3], y[3], z[3];
+    for (int v = 0; v < 3; ++v) {
+        z[v] = _mm_sub_ps(_mm_load_ps(p[v][ray.kz]), _mm_set1_ps(ray.o[2]));
+        x[v] = _mm_add_ps(
+            _mm_sub_ps(_mm_load_ps(p[v][ray.kx]), _mm_set1_ps(ray.o[0])),
+            _mm_mul_ps(Sx, z[v]));
+        y[v] = _mm_add_ps(
+            _mm_sub_ps(_mm_load_ps(p[v][ray.ky]), _mm_set1_ps(ray.o[1])),
+            _mm_mul_ps(Sy, z[v]));
+    }
+    __m128 e[3];
+    for (int i = 0; i < 3; ++i) {
+        int a = (i + 1) % 3, b = (i + 2) % 3;
+        e[i] = _mm_sub_ps(_mm_mul_ps(x[a], y[b]), _mm_mul_ps(y[a], x[b]));
+    }
+    __m128 edgeZero = zero, edgeNeg = zero, edgePos = zero;
+    for (int i = 0; i < 3; ++i) {
+        edgeZero = _mm_or_ps(edgeZero, _mm_cmpeq_ps(e[i], zero));
+        edgeNeg = _mm_or_ps(edgeNeg, _mm_cmplt_ps(e[i], zero));
+        edgePos = _mm_or_ps(edgePos, _mm_cmpgt_ps(e[i], zero));
+    }
+    __m128 det = _mm_add_ps(_mm_add_ps(e[0], e[1]), e[2]);
+    __m128 tScaled =
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(e[0], _mm_mul_ps(z[0], Sz)),
+                              _mm_mul_ps(e[1], _mm_mul_ps(z[1], Sz))),
+                   _mm_mul_ps(e[2], _mm_mul_ps(z[2], Sz)));
+    __m128 tMaxDet = _mm_mul_ps(_mm_set1_ps(tMax), det);
+    __m128 culled = _mm_or_ps(_mm_and_ps(edgeNeg, edgePos),
+                              _mm_cmpeq_ps(det, zero));
+    culled = _mm_or_ps(
+        culled, _mm_and_ps(_mm_cmplt_ps(det, zero),
+                           _mm_or_ps(_mm_cmpge_ps(tScaled, zero),
+                                     _mm_cmplt_ps(tScaled, tMaxDet))));
+    culled = _mm_or_ps(
+        culled, _mm_and_ps(_mm_cmpgt_ps(det, zero),
+                           _mm_or_ps(_mm_cmple_ps(tScaled, zero),
+                                     _mm_cmpgt_ps(tScaled, tMaxDet))));
+    return (~_mm_movemask_ps(culled) | _mm_movemask_ps(edgeZero)) &
+           ((1 << nTriangles) - 1);
+}
+#else
+int TriangleBlock::Intersect(const TriangleRay &ray, Float tMax,
+                             int nTriangles) const {
+    int mask = 0;
+    for (int i = 0; i < nTriangles; ++i) {
+        // Translate, permute and shear the triangle's vertices
+        Float x[3], y[3], z[3];
+        for (int v = 0; v < 3; ++v) {
+            z[v] = p[v][ray.kz][i] - ray.o[2];
+            x[v] = p[v][ray.kx][i] - ray.o[0] + ray.Sx * z[v];
+            y[v] = p[v][ray.ky][i] - ray.o[1] + ray.Sy * z[v];
+        }
+
+        // Apply the edge, determinant and $t$ range tests
+        Float e0 = x[1] * y[2] - y[1] * x[2];
+        Float e1 = x[2] * y[0] - y[2] * x[0];
+        Float e2 = x[0] * y[1] - y[0] * x[1];
+        if (e0 == 0 || e1 == 0 || e2 == 0) {
+            mask |= 1 << i;
+            continue;
+        }
+        if ((e0 < 0 || e1 < 0 || e2 < 0) && (e0 > 0 || e1 > 0 || e2 > 0))
+            continue;
+        Float det = e0 + e1 + e2;
+        if (det == 0) continue;
+        Float tScaled = e0 * (z[0] * ray.Sz) + e1 * (z[1] * ray.Sz) +
+                        e2 * (z[2] * ray.Sz);
+        if (det < 0 && (tScaled >= 0 || tScaled < tMax * det))
+            continue;
+        else if (det > 0 && (tScaled <= 0 || tScaled > tMax * det))
+            continue;
+        mask |= 1 << i;
+    }
+    return mask;
+}
+#endif
+
+// The on-disk BVH cache stores a _BVHCacheHeader_, the original index of
+// each primitive reference in traversal order, and then the _LinearBVHNode_s,
+// starting at a 32-byte aligned offset so they can be used in place once
+// the file is memory-mapped.
+struct BVHCacheHeader {
+    BVHCacheHeader(uint64_t geometryHash, int maxPrimsInNode, int splitMethod,
+                   int64_t nPrimitives, int64_t nReferences, int totalNodes) {
+        memset(this, 0, sizeof(*this));
+        strncpy(magic, "pbrtBVH", sizeof(magic));
+        version = 2;
+        floatSize = sizeof(Float);
+        nodeSize = sizeof(LinearBVHNode);
+        this->maxPrimsInNode = maxPrimsInNode;
+        this->splitMethod = splitMethod;
+        this->totalNodes = totalNodes;
+        this->nPrimitives = nPrimitives;
+        this->nReferences = nReferences;
+        this->geometryHash = geometryHash;
+    }
+    size_t NodeOffset() const {
+        return (sizeof(BVHCacheHeader) + nReferences * sizeof(int32_t) + 31) &
+               ~size_t(31);
+    }
+    size_t FileSize() const {
+        return NodeOffset() + totalNodes * sizeof(LinearBVHNode);
+    }
+
+    char magic[8];
+    uint32_t version, floatSize, nodeSize;
+    int32_t maxPrimsInNode, splitMethod, totalNodes;
+    int64_t nPrimitives, nReferences;
+    uint64_t geometryHash;
+};
+
+// BVHAccel Build Constants
+// Subtrees with at least this many primitives build their children as
+// parallel tasks; ranges of four or more chunks are bounded and binned in
+// parallel.
+static PBRT_CONSTEXPR int ParallelBuildThreshold = 16384;
+static PBRT_CONSTEXPR int ParallelBinningChunkSize = 16384;
+// SBVH builds only look for spatial splits when the object split's
+// children overlap by more than this fraction of the root's surface area,
+// and stop looking below this depth to bound the traversal stack.
+static PBRT_CONSTEXPR Float SpatialSplitMinOverlap = 1e-5f;
+static PBRT_CONSTEXPR int MaxSpatialSplitDepth = 48;
+
 // BVHAccel Utility Functions
+inline uint64_t MixBits(uint64_t v) {
+    v ^= (v >> 31);
+    v *= 0x7fb5d329728ea185;
+    v ^= (v >> 27);
+    v *= 0x81dadef4bc2dd44d;
+    v ^= (v >> 33);
+    return v;
+}
+
+static void CollectLeaves(const BVHBuildNode *node,
+                          std::vector<std::pair<int, int>> *leaves) {
+    if (node->nPrimitives > 0)
+        leaves->push_back(
+            std::make_pair(node->firstPrimOffset, node->nPrimitives));
+    else {
+        CollectLeaves(node->children[0], leaves);
+        CollectLeaves(node->children[1], leaves);
+    }
+}
+
+inline bool IsEmptyBound(const Bounds3f &b) {
+    return b.pMin.x > b.pMax.x || b.pMin.y > b.pMax.y || b.pMin.z > b.pMax.z;
+}
+
+static uint64_t HashBVHBuild(const std::vector<BVHPrimitiveInfo> &primitiveInfo,
+                             int maxPrimsInNode, int splitMethod,
+                             Float maxDuplication) {
+    // Non-spatial-split builds only see primitive bounds, so hashing them
+    // (in order) along with the build parameters identifies the resulting
+    // tree; SBVH builds also clip the shapes themselves and aren't cached
+    PBRT_CONSTEXPR int chunkSize = 65536;
+    int64_t nChunks = (primitiveInfo.size() + chunkSize - 1) / chunkSize;
+    std::vector<uint64_t> chunkHashes(nChunks);
+    ParallelFor([&](int64_t chunk) {
+        uint64_t hash = chunk;
+        size_t end =
+            std::min(primitiveInfo.size(), size_t(chunk + 1) * chunkSize);
+        for (size_t i = chunk * chunkSize; i < end; ++i) {
+            const Bounds3f &b = primitiveInfo[i].bounds;
+            for (int c = 0; c < 3; ++c) {
+                hash = MixBits(hash ^ FloatToBits(b.pMin[c]));
+                hash = MixBits(hash ^ FloatToBits(b.pMax[c]));
+            }
+        }
+        chunkHashes[chunk] = hash;
+    }, nChunks);
+    uint64_t hash = MixBits(primitiveInfo.size());
+    hash = MixBits(hash ^ maxPrimsInNode);
+    hash = MixBits(hash ^ splitMethod);
+    hash = MixBits(hash ^ FloatToBits(maxDuplication));
+    for (uint64_t chunkHash : chunkHashes) hash = MixBits(hash ^ chunkHash);
+    return hash;
+}
+
+inline int CountActiveLanes(int mask) {
+    int n = 0;
+    for (; mask; mask &= mask - 1) ++n;
+    return n;
+}
+
+inline int FirstActiveLane(int mask) {
+    int lane = 0;
+    while (!(mask & (1 << lane))) ++lane;
+    return lane;
+}
+
 inline uint32_t LeftShift3(uint32_t x) {
     CHECK_LE(x, (1 << 10));
     if (x == (1 << 10)) --x;
@@ -181,10 +764,14 @@ static void RadixSort(std::vector<MortonPrimitive> *v) {
 
 // BVHAccel Method Definitions
 BVHAccel::BVHAccel(std::vector<std::shared_ptr<Primitive>> p,
-                   int maxPrimsInNode, SplitMethod splitMethod)
+                   int maxPrimsInNode, SplitMethod splitMethod, int width,
+                   int quantizeBits, const std::string &cacheDir,
+                   Float maxDuplication, bool soaTriangles)
     : maxPrimsInNode(std::min(255, maxPrimsInNode)),
       splitMethod(splitMethod),
-      primitives(std::move(p)) {
+      primitives(std::move(p)),
+      width(width),
+      quantizeBits(quantizeBits) {
     ProfilePhase _(Prof::AccelConstruction);
     if (primitives.empty()) return;
     // Build BVH from _primitives_
@@ -194,38 +781,479 @@ BVHAccel::BVHAccel(std::vector<std::shared_ptr<Primitive>> p,
     for (size_t i = 0; i < primitives.size(); ++i)
         primitiveInfo[i] = {i, primitives[i]->WorldBound()};
 
+    // Reuse a cached BVH that was built from the same primitive bounds
+    uint64_t geometryHash = 0;
+    if (!cacheDir.empty() && width == 2 &&
+        splitMethod != SplitMethod::SBVH) {
+        geometryHash = HashBVHBuild(primitiveInfo, this->maxPrimsInNode,
+                                    (int)splitMethod, maxDuplication);
+        cacheFilename =
+            cacheDir + StringPrintf("/bvh-%016llx.cache",
+                                    (unsigned long long)geometryHash);
+        ++nCacheLookups;
+        if (readCache(cacheFilename, geometryHash)) {
+            ++nCacheHits;
+            treeBytes += sizeof(*this) +
+                         primitives.size() * sizeof(primitives[0]) + nodeBytes;
+            LOG(INFO) << StringPrintf("BVH with %d primitives loaded from %s",
+                                      (int)primitives.size(),
+                                      cacheFilename.c_str());
+            if (soaTriangles) {
+                std::vector<std::pair<int, int>> leaves;
+                for (size_t i = 0; i < nodeBytes / sizeof(LinearBVHNode); ++i)
+                    if (nodes[i].nPrimitives > 0)
+                        leaves.push_back(std::make_pair(
+                            nodes[i].primitivesOffset, nodes[i].nPrimitives));
+                buildTriangleBlocks(leaves);
+            }
+            return;
+        }
+    }
+
     // Build BVH tree for primitives using _primitiveInfo_
-    MemoryArena arena(1024 * 1024);
+    std::vector<MemoryArena> arenas(MaxThreadIndex());
     int totalNodes = 0;
     std::vector<std::shared_ptr<Primitive>> orderedPrims;
-    orderedPrims.reserve(primitives.size());
     BVHBuildNode *root;
-    if (splitMethod == SplitMethod::HLBVH)
-        root = HLBVHBuild(arena, primitiveInfo, &totalNodes, orderedPrims);
-    else
-        root = recursiveBuild(arena, primitiveInfo, 0, primitives.size(),
-                              &totalNodes, orderedPrims);
+    if (splitMethod == SplitMethod::HLBVH) {
+        orderedPrims.resize(primitives.size());
+        root = HLBVHBuild(arenas[ThreadIndex], primitiveInfo, &totalNodes,
+                          orderedPrims);
+    } else if (splitMethod == SplitMethod::SBVH) {
+        // Allow up to _maxDuplication_ extra references per primitive
+        Bounds3f rootBounds;
+        for (const BVHPrimitiveInfo &pi : primitiveInfo)
+            rootBounds = Union(rootBounds, pi.bounds);
+        int64_t duplicationBudget =
+            std::max(Float(0), maxDuplication) * primitives.size();
+        orderedPrims.reserve(primitives.size() + duplicationBudget);
+        root = sbvhBuild(arenas[ThreadIndex], primitiveInfo,
+                         rootBounds.SurfaceArea(), 0, &totalNodes,
+                         &duplicationBudget, orderedPrims);
+    } else {
+        orderedPrims.resize(primitives.size());
+        std::atomic<int> atomicTotal(0);
+        root = recursiveBuild(arenas, primitiveInfo, 0, primitives.size(),
+                              &atomicTotal, orderedPrims);
+        totalNodes = atomicTotal;
+    }
     primitives.swap(orderedPrims);
     primitiveInfo.resize(0);
+    size_t arenaBytes = 0;
+    for (const MemoryArena &arena : arenas)
+        arenaBytes += arena.TotalAllocated();
     LOG(INFO) << StringPrintf("BVH created with %d nodes for %d "
                               "primitives (%.2f MB), arena allocated %.2f MB",
                               totalNodes, (int)primitives.size(),
                               float(totalNodes * sizeof(LinearBVHNode)) /
                               (1024.f * 1024.f),
-                              float(arena.TotalAllocated()) /
-                              (1024.f * 1024.f));
+                              float(arenaBytes) / (1024.f * 1024.f));
+
+    bounds = root->bounds;
+    treeBytes += sizeof(*this) + primitives.size() * sizeof(primitives[0]);
+    if (soaTriangles) {
+        // Copy the vertices of all-triangle leaves into SIMD-friendly blocks
+        std::vector<std::pair<int, int>> leaves;
+        CollectLeaves(root, &leaves);
+        buildTriangleBlocks(leaves);
+    }
+    if (width == 4 || width == 8) {
+        // Collapse the binary tree into _width_-wide nodes
+        int totalWideNodes = 0;
+        if (width == 4) {
+            nodes4 = collapseBVHTree<4>(root, &totalWideNodes);
+            nodeBytes = totalWideNodes * sizeof(WideBVHNode<4>);
+        } else {
+            nodes8 = collapseBVHTree<8>(root, &totalWideNodes);
+            nodeBytes = totalWideNodes * sizeof(WideBVHNode<8>);
+        }
+        LOG(INFO) << StringPrintf("BVH collapsed to %d nodes of width %d "
+                                  "(%.2f MB)", totalWideNodes, width,
+                                  float(nodeBytes) / (1024.f * 1024.f));
+
+        if (quantizeBits != 0) {
+            // Replace the wide nodes with their quantized encoding
+            CHECK(quantizeBits == 8 || quantizeBits == 16);
+            if (width == 4 && quantizeBits == 8) {
+                quantizedNodes =
+                    QuantizeBVHNodes<4, uint8_t>(nodes4, totalWideNodes);
+                nodeBytes =
+                    totalWideNodes * sizeof(QuantizedBVHNode<4, uint8_t>);
+            } else if (width == 4) {
+                quantizedNodes =
+                    QuantizeBVHNodes<4, uint16_t>(nodes4, totalWideNodes);
+                nodeBytes =
+                    totalWideNodes * sizeof(QuantizedBVHNode<4, uint16_t>);
+            } else if (quantizeBits == 8) {
+                quantizedNodes =
+                    QuantizeBVHNodes<8, uint8_t>(nodes8, totalWideNodes);
+                nodeBytes =
+                    totalWideNodes * sizeof(QuantizedBVHNode<8, uint8_t>);
+            } else {
+                quantizedNodes =
+                    QuantizeBVHNodes<8, uint16_t>(nodes8, totalWideNodes);
+                nodeBytes =
+                    totalWideNodes * sizeof(QuantizedBVHNode<8, uint16_t>);
+            }
+            FreeAligned(nodes4);
+            FreeAligned(nodes8);
+            nodes4 = nullptr;
+            nodes8 = nullptr;
+            LOG(INFO) << StringPrintf("BVH nodes quantized to %d bits "
+                                      "(%.2f MB)", quantizeBits,
+                                      float(nodeBytes) / (1024.f * 1024.f));
+        }
+        treeBytes += nodeBytes;
+        return;
+    }
+    CHECK_EQ(width, 2);
+    CHECK_EQ(quantizeBits, 0);
 
     // Compute representation of depth-first traversal of BVH tree
-    treeBytes += totalNodes * sizeof(LinearBVHNode) + sizeof(*this) +
-                 primitives.size() * sizeof(primitives[0]);
+    nodeBytes = totalNodes * sizeof(LinearBVHNode);
+    treeBytes += nodeBytes;
     nodes = AllocAligned<LinearBVHNode>(totalNodes);
     int offset = 0;
     flattenBVHTree(root, &offset);
     CHECK_EQ(totalNodes, offset);
+    if (!cacheFilename.empty())
+        writeCache(cacheFilename, geometryHash, orderedPrims, totalNodes);
 }
 
-Bounds3f BVHAccel::WorldBound() const {
-    return nodes ? nodes[0].bounds : Bounds3f();
+bool BVHAccel::readCache(const std::string &filename, uint64_t geometryHash) {
+    // Map (or read) the entire cache file into memory
+    void *data = nullptr;
+    size_t length = 0;
+#ifdef PBRT_HAVE_MMAP
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) return false;
+    struct stat stat;
+    if (fstat(fd, &stat) == 0 && stat.st_size > 0) {
+        length = stat.st_size;
+        data = mmap(0, length, PROT_READ, MAP_FILE | MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) data = nullptr;
+    }
+    close(fd);
+#else
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (!f) return false;
+    long end;
+    if (fseek(f, 0, SEEK_END) == 0 && (end = ftell(f)) > 0) {
+        length = end;
+        data = AllocAligned<uint8_t>(length);
+        rewind(f);
+        if (fread(data, 1, length, f) != length) {
+            FreeAligned(data);
+            data = nullptr;
+        }
+    }
+    fclose(f);
+#endif
+    if (!data) return false;
+    cacheData = data;
+    cacheDataLength = length;
+
+    // Check that the cache matches the primitives and build parameters
+    const uint8_t *bytes = (const uint8_t *)data;
+    BVHCacheHeader header(0, 0, 0, 0, 0, 0);
+    bool valid = length >= sizeof(header);
+    if (valid) {
+        memcpy(&header, bytes, sizeof(header));
+        BVHCacheHeader expected(geometryHash, maxPrimsInNode, (int)splitMethod,
+                                primitives.size(), header.nReferences,
+                                header.totalNodes);
+        valid = memcmp(&header, &expected, sizeof(header)) == 0 &&
+                header.totalNodes > 0 && header.nReferences > 0 &&
+                length == header.FileSize();
+    }
+
+    // Reorder _primitives_ to match the cached leaves
+    int64_t nPrimitives = primitives.size();
+    std::vector<std::shared_ptr<Primitive>> orderedPrims;
+    if (valid) {
+        const int32_t *primIndices =
+            (const int32_t *)(bytes + sizeof(BVHCacheHeader));
+        orderedPrims.resize(header.nReferences);
+        for (int64_t i = 0; i < header.nReferences && valid; ++i) {
+            valid = primIndices[i] >= 0 && primIndices[i] < nPrimitives;
+            if (valid) orderedPrims[i] = primitives[primIndices[i]];
+        }
+    }
+    if (!valid) {
+        Warning("%s: BVH cache doesn't match scene. Rebuilding.",
+                filename.c_str());
+        releaseCache();
+        return false;
+    }
+    primitives.swap(orderedPrims);
+    nodes = (LinearBVHNode *)(bytes + header.NodeOffset());
+    nodeBytes = header.totalNodes * sizeof(LinearBVHNode);
+    bounds = nodes[0].bounds;
+    return true;
+}
+
+void BVHAccel::releaseCache() {
+#ifdef PBRT_HAVE_MMAP
+    munmap(cacheData, cacheDataLength);
+#else
+    FreeAligned(cacheData);
+#endif
+    cacheData = nullptr;
+    cacheDataLength = 0;
+}
+
+void BVHAccel::writeCache(
+    const std::string &filename, uint64_t geometryHash,
+    const std::vector<std::shared_ptr<Primitive>> &unorderedPrims,
+    int totalNodes) const {
+    // Recover each ordered primitive's index in the original list
+    int64_t nPrimitives = unorderedPrims.size();
+    int64_t nReferences = primitives.size();
+    std::vector<std::pair<const Primitive *, int32_t>> originalIndex;
+    originalIndex.reserve(nPrimitives);
+    for (int64_t i = 0; i < nPrimitives; ++i)
+        originalIndex.push_back(std::make_pair(unorderedPrims[i].get(), i));
+    std::sort(originalIndex.begin(), originalIndex.end());
+    std::vector<int32_t> primIndices(nReferences);
+    for (int64_t i = 0; i < nReferences; ++i) {
+        auto iter = std::lower_bound(
+            originalIndex.begin(), originalIndex.end(),
+            std::make_pair((const Primitive *)primitives[i].get(), 0));
+        CHECK(iter != originalIndex.end() &&
+              iter->first == primitives[i].get());
+        primIndices[i] = iter->second;
+    }
+
+    // Write to a temporary file and rename it so that concurrent renders
+    // never see a partially written cache
+    BVHCacheHeader header(geometryHash, maxPrimsInNode, (int)splitMethod,
+                          nPrimitives, nReferences, totalNodes);
+#ifdef PBRT_HAVE_MMAP
+    std::string tempFilename =
+        StringPrintf("%s.%d.tmp", filename.c_str(), (int)getpid());
+#else
+    std::string tempFilename = filename + ".tmp";
+#endif
+    FILE *f = fopen(tempFilename.c_str(), "wb");
+    if (!f) {
+        Warning("%s: unable to write BVH cache", tempFilename.c_str());
+        return;
+    }
+    const char padding[32] = {0};
+    size_t paddingSize = header.NodeOffset() - sizeof(header) -
+                         nReferences * sizeof(int32_t);
+    bool written =
+        fwrite(&header, sizeof(header), 1, f) == 1 &&
+        fwrite(primIndices.data(), sizeof(int32_t), nReferences, f) ==
+            (size_t)nReferences &&
+        fwrite(padding, 1, paddingSize, f) == paddingSize &&
+        fwrite(nodes, sizeof(LinearBVHNode), totalNodes, f) ==
+            (size_t)totalNodes;
+    written = (fclose(f) == 0) && written;
+    if (!written || rename(tempFilename.c_str(), filename.c_str()) != 0) {
+        Warning("%s: unable to write BVH cache", filename.c_str());
+        remove(tempFilename.c_str());
+    }
+}
+
+void BVHAccel::buildTriangleBlocks(
+    const std::vector<std::pair<int, int>> &leaves) {
+    // Assign blocks to the leaves whose primitives are all triangles
+    leafTriangleBlocks.assign(primitives.size(), -1);
+    int nBlocks = 0;
+    Point3f p[3];
+    for (const std::pair<int, int> &leaf : leaves) {
+        bool allTriangles = true;
+        for (int i = 0; i < leaf.second && allTriangles; ++i)
+            allTriangles = primitives[leaf.first + i]->GetTriangleVertices(p);
+        if (!allTriangles) continue;
+        leafTriangleBlocks[leaf.first] = nBlocks;
+        nBlocks += (leaf.second + TriangleBlockWidth - 1) / TriangleBlockWidth;
+    }
+    if (nBlocks == 0) {
+        std::vector<int32_t>().swap(leafTriangleBlocks);
+        return;
+    }
+
+    // Copy the triangles' vertices into their leaves' blocks
+    triangleBlocks = AllocAligned<TriangleBlock>(nBlocks);
+    memset(triangleBlocks, 0, nBlocks * sizeof(TriangleBlock));
+    for (const std::pair<int, int> &leaf : leaves) {
+        int firstBlock = leafTriangleBlocks[leaf.first];
+        if (firstBlock < 0) continue;
+        for (int i = 0; i < leaf.second; ++i) {
+            primitives[leaf.first + i]->GetTriangleVertices(p);
+            TriangleBlock &block =
+                triangleBlocks[firstBlock + i / TriangleBlockWidth];
+            int lane = i % TriangleBlockWidth;
+            for (int v = 0; v < 3; ++v)
+                for (int axis = 0; axis < 3; ++axis)
+                    block.p[v][axis][lane] = p[v][axis];
+        }
+    }
+    size_t blockBytes = nBlocks * sizeof(TriangleBlock) +
+                        leafTriangleBlocks.size() * sizeof(int32_t);
+    treeBytes += blockBytes;
+    LOG(INFO) << StringPrintf("BVH triangle blocks: %d blocks of %d (%.2f MB)",
+                              nBlocks, TriangleBlockWidth,
+                              float(blockBytes) / (1024.f * 1024.f));
+}
+
+bool BVHAccel::intersectLeaf(const Ray &ray, const TriangleRay &triRay,
+                             int offset, int nPrimitives,
+                             SurfaceInteraction *isect) const {
+    // Find the closest hit when _isect_ is given, otherwise any hit
+    bool hit = false;
+    int block =
+        leafTriangleBlocks.empty() ? -1 : leafTriangleBlocks[offset];
+    if (block < 0) {
+        for (int i = 0; i < nPrimitives; ++i) {
+            const Primitive &prim = *primitives[offset + i];
+            if (!isect) {
+                if (prim.IntersectP(ray)) return true;
+            } else if (prim.Intersect(ray, isect))
+                hit = true;
+        }
+        return hit;
+    }
+    for (int first = 0; first < nPrimitives;
+         first += TriangleBlockWidth, ++block) {
+        // Run the exact test only on the triangles the block doesn't cull
+        int n = std::min(TriangleBlockWidth, nPrimitives - first);
+        int mask = triangleBlocks[block].Intersect(triRay, ray.tMax, n);
+        nTriangleBlockLanes += n;
+        for (; mask; mask &= mask - 1) {
+            ++nTriangleCandidates;
+            const Primitive &prim =
+                *primitives[offset + first + FirstActiveLane(mask)];
+            if (!isect) {
+                if (prim.IntersectP(ray)) return true;
+            } else if (prim.Intersect(ray, isect))
+                hit = true;
+        }
+    }
+    return hit;
+}
+
+Bounds3f BVHAccel::WorldBound() const { return bounds; }
+
+bool BVHAccel::Refit() {
+    // Recompute node bounds from the primitives' current bounds, keeping
+    // the tree's topology; only binary nodes can be refit
+    ProfilePhase _(Prof::AccelConstruction);
+    if (!nodes) return primitives.empty();
+    int totalNodes = nodeBytes / sizeof(LinearBVHNode);
+    if (cacheData) {
+        // Copy the nodes out of the read-only cache mapping first
+        LinearBVHNode *ownedNodes = AllocAligned<LinearBVHNode>(totalNodes);
+        std::copy(nodes, nodes + totalNodes, ownedNodes);
+        releaseCache();
+        nodes = ownedNodes;
+    }
+
+    // Children follow their parent in depth-first order, so a reverse
+    // pass updates both children before the parent
+    for (int i = totalNodes - 1; i >= 0; --i) {
+        LinearBVHNode &node = nodes[i];
+        if (node.nPrimitives > 0) {
+            Bounds3f b;
+            for (int j = 0; j < node.nPrimitives; ++j)
+                b = Union(b,
+                          primitives[node.primitivesOffset + j]->WorldBound());
+            node.bounds = b;
+        } else
+            node.bounds = Union(nodes[i + 1].bounds,
+                                nodes[node.secondChildOffset].bounds);
+    }
+    bounds = nodes[0].bounds;
+    if (motionBounds) computeMotionBounds();
+    if (!nodeReplicas.empty()) copyNodeReplicas();
+    ++nRefits;
+    return true;
+}
+
+void BVHAccel::BuildMotionBounds(int nSegments, Float time0, Float time1) {
+    // Give each binary node a box per equal slice of $[time0, time1]$ so
+    // that rays only see where the geometry is around their own time
+    ProfilePhase _(Prof::AccelConstruction);
+    if (!nodes || nSegments < 2 || !(time1 > time0)) return;
+    int totalNodes = nodeBytes / sizeof(LinearBVHNode);
+    if (!motionBounds) {
+        motionBounds = AllocAligned<Bounds3f>(totalNodes * nSegments);
+        treeBytes += totalNodes * nSegments * sizeof(Bounds3f);
+    }
+    nMotionSegments = nSegments;
+    motionTime0 = time0;
+    motionTime1 = time1;
+    computeMotionBounds();
+}
+
+void BVHAccel::ReplicatePerNumaNode() {
+    // Give each NUMA node a copy of the binary nodes in its own memory so
+    // that pinned threads don't traverse the tree across sockets
+    ProfilePhase _(Prof::AccelConstruction);
+    if (!nodes || !nodeReplicas.empty() || NumaNodeCount() < 2) return;
+    nodeReplicas.resize(NumaNodeCount(), nullptr);
+    treeBytes += nodeReplicas.size() * nodeBytes;
+    copyNodeReplicas();
+}
+
+void BVHAccel::copyNodeReplicas() {
+    int totalNodes = nodeBytes / sizeof(LinearBVHNode);
+    for (size_t node = 0; node < nodeReplicas.size(); ++node)
+        // Pages are placed on the node of the thread that first writes them
+        RunOnNumaNode(node, [&]() {
+            if (!nodeReplicas[node])
+                nodeReplicas[node] = AllocAligned<LinearBVHNode>(totalNodes);
+            std::copy(nodes, nodes + totalNodes, nodeReplicas[node]);
+        });
+}
+
+inline const LinearBVHNode *BVHAccel::threadNodes() const {
+    return nodeReplicas.empty() ? nodes : nodeReplicas[ThreadNumaNode];
+}
+
+void BVHAccel::computeMotionBounds() {
+    int totalNodes = nodeBytes / sizeof(LinearBVHNode);
+    int n = nMotionSegments;
+    for (int i = totalNodes - 1; i >= 0; --i) {
+        const LinearBVHNode &node = nodes[i];
+        Bounds3f *segmentBounds = &motionBounds[i * n];
+        if (node.nPrimitives == 0) {
+            for (int s = 0; s < n; ++s)
+                segmentBounds[s] =
+                    Union(motionBounds[(i + 1) * n + s],
+                          motionBounds[node.secondChildOffset * n + s]);
+            continue;
+        }
+        for (int s = 0; s < n; ++s) {
+            // Rays outside the time range use the first or last segment,
+            // so those segments extend to all earlier or later times
+            Float t0 = s == 0 ? -Infinity
+                              : Lerp(Float(s) / n, motionTime0, motionTime1);
+            Float t1 = s == n - 1
+                           ? Infinity
+                           : Lerp(Float(s + 1) / n, motionTime0, motionTime1);
+            Bounds3f b;
+            for (int j = 0; j < node.nPrimitives; ++j)
+                b = Union(b, primitives[node.primitivesOffset + j]
+                                 ->MotionWorldBound(t0, t1));
+            // Split references may only cover part of their primitive
+            segmentBounds[s] = pbrt::Intersect(b, node.bounds);
+        }
+    }
+}
+
+Float BVHAccel::SAHCost() const {
+    // Expected node visits and primitive tests for rays that hit the root
+    if (!nodes) return 0;
+    Float rootArea = nodes[0].bounds.SurfaceArea();
+    if (rootArea == 0) return 0;
+    Float cost = 0;
+    for (size_t i = 0; i < nodeBytes / sizeof(LinearBVHNode); ++i)
+        cost += nodes[i].bounds.SurfaceArea() / rootArea *
+                (nodes[i].nPrimitives > 0 ? nodes[i].nPrimitives : 1);
+    return cost;
 }
 
 struct BucketInfo {
@@ -233,42 +1261,71 @@ struct BucketInfo {
     Bounds3f bounds;
 };
 
+static void ComputeRangeBounds(
+    const std::vector<BVHPrimitiveInfo> &primitiveInfo, int start, int end,
+    Bounds3f *bounds, Bounds3f *centroidBounds) {
+    if (end - start < 4 * ParallelBinningChunkSize) {
+        for (int i = start; i < end; ++i) {
+            *bounds = Union(*bounds, primitiveInfo[i].bounds);
+            *centroidBounds = Union(*centroidBounds, primitiveInfo[i].centroid);
+        }
+        return;
+    }
+    // Bound chunks of a large range in parallel and merge the results
+    int nChunks = (end - start + ParallelBinningChunkSize - 1) /
+                  ParallelBinningChunkSize;
+    std::vector<Bounds3f> chunkBounds(nChunks), chunkCentroidBounds(nChunks);
+    ParallelFor([&](int64_t chunk) {
+        int chunkStart = start + chunk * ParallelBinningChunkSize;
+        int chunkEnd = std::min(end, chunkStart + ParallelBinningChunkSize);
+        for (int i = chunkStart; i < chunkEnd; ++i) {
+            chunkBounds[chunk] =
+                Union(chunkBounds[chunk], primitiveInfo[i].bounds);
+            chunkCentroidBounds[chunk] =
+                Union(chunkCentroidBounds[chunk], primitiveInfo[i].centroid);
+        }
+    }, nChunks);
+    for (int chunk = 0; chunk < nChunks; ++chunk) {
+        *bounds = Union(*bounds, chunkBounds[chunk]);
+        *centroidBounds = Union(*centroidBounds, chunkCentroidBounds[chunk]);
+    }
+}
+
 BVHBuildNode *BVHAccel::recursiveBuild(
-    MemoryArena &arena, std::vector<BVHPrimitiveInfo> &primitiveInfo, int start,
-    int end, int *totalNodes,
+    std::vector<MemoryArena> &arenas,
+    std::vector<BVHPrimitiveInfo> &primitiveInfo, int start, int end,
+    std::atomic<int> *totalNodes,
     std::vector<std::shared_ptr<Primitive>> &orderedPrims) {
     CHECK_NE(start, end);
-    BVHBuildNode *node = arena.Alloc<BVHBuildNode>();
+    BVHBuildNode *node = arenas[ThreadIndex].Alloc<BVHBuildNode>();
     (*totalNodes)++;
-    // Compute bounds of all primitives in BVH node
-    Bounds3f bounds;
-    for (int i = start; i < end; ++i)
-        bounds = Union(bounds, primitiveInfo[i].bounds);
+    // Compute bounds of all primitives and their centroids in BVH node
+    Bounds3f bounds, centroidBounds;
+    ComputeRangeBounds(primitiveInfo, start, end, &bounds, &centroidBounds);
     int nPrimitives = end - start;
+    // Leaves store their primitives at the same offsets as their
+    // _primitiveInfo_ range, which is what depth-first order gives
     if (nPrimitives == 1) {
         // Create leaf _BVHBuildNode_
-        int firstPrimOffset = orderedPrims.size();
+        int firstPrimOffset = start;
         for (int i = start; i < end; ++i) {
             int primNum = primitiveInfo[i].primitiveNumber;
-            orderedPrims.push_back(primitives[primNum]);
+            orderedPrims[i] = primitives[primNum];
         }
         node->InitLeaf(firstPrimOffset, nPrimitives, bounds);
         return node;
     } else {
-        // Compute bound of primitive centroids, choose split dimension _dim_
-        Bounds3f centroidBounds;
-        for (int i = start; i < end; ++i)
-            centroidBounds = Union(centroidBounds, primitiveInfo[i].centroid);
+        // Choose split dimension _dim_
         int dim = centroidBounds.MaximumExtent();
 
         // Partition primitives into two sets and build children
         int mid = (start + end) / 2;
         if (centroidBounds.pMax[dim] == centroidBounds.pMin[dim]) {
             // Create leaf _BVHBuildNode_
-            int firstPrimOffset = orderedPrims.size();
+            int firstPrimOffset = start;
             for (int i = start; i < end; ++i) {
                 int primNum = primitiveInfo[i].primitiveNumber;
-                orderedPrims.push_back(primitives[primNum]);
+                orderedPrims[i] = primitives[primNum];
             }
             node->InitLeaf(firstPrimOffset, nPrimitives, bounds);
             return node;
@@ -321,16 +1378,48 @@ BVHBuildNode *BVHAccel::recursiveBuild(
                     BucketInfo buckets[nBuckets];
 
                     // Initialize _BucketInfo_ for SAH partition buckets
-                    for (int i = start; i < end; ++i) {
-                        int b = nBuckets *
-                                centroidBounds.Offset(
-                                    primitiveInfo[i].centroid)[dim];
-                        if (b == nBuckets) b = nBuckets - 1;
-                        CHECK_GE(b, 0);
-                        CHECK_LT(b, nBuckets);
-                        buckets[b].count++;
-                        buckets[b].bounds =
-                            Union(buckets[b].bounds, primitiveInfo[i].bounds);
+                    auto binPrimitives = [&](int binStart, int binEnd,
+                                             BucketInfo *buckets) {
+                        for (int i = binStart; i < binEnd; ++i) {
+                            int b = nBuckets *
+                                    centroidBounds.Offset(
+                                        primitiveInfo[i].centroid)[dim];
+                            if (b == nBuckets) b = nBuckets - 1;
+                            CHECK_GE(b, 0);
+                            CHECK_LT(b, nBuckets);
+                            buckets[b].count++;
+                            buckets[b].bounds = Union(buckets[b].bounds,
+                                                      primitiveInfo[i].bounds);
+                        }
+                    };
+                    if (nPrimitives < 4 * ParallelBinningChunkSize)
+                        binPrimitives(start, end, buckets);
+                    else {
+                        // Bin chunks of the range in parallel; counts and
+                        // bounds merge exactly, so the buckets are the same
+                        // as serial binning gives
+                        int nChunks =
+                            (nPrimitives + ParallelBinningChunkSize - 1) /
+                            ParallelBinningChunkSize;
+                        std::vector<BucketInfo> chunkBuckets(nChunks *
+                                                             nBuckets);
+                        ParallelFor([&](int64_t chunk) {
+                            int chunkStart =
+                                start + chunk * ParallelBinningChunkSize;
+                            binPrimitives(
+                                chunkStart,
+                                std::min(end, chunkStart +
+                                                  ParallelBinningChunkSize),
+                                &chunkBuckets[chunk * nBuckets]);
+                        }, nChunks);
+                        for (int chunk = 0; chunk < nChunks; ++chunk)
+                            for (int b = 0; b < nBuckets; ++b) {
+                                const BucketInfo &cb =
+                                    chunkBuckets[chunk * nBuckets + b];
+                                buckets[b].count += cb.count;
+                                buckets[b].bounds =
+                                    Union(buckets[b].bounds, cb.bounds);
+                            }
                     }
 
                     // Compute costs for splitting after each bucket
@@ -379,10 +1468,10 @@ BVHBuildNode *BVHAccel::recursiveBuild(
                         mid = pmid - &primitiveInfo[0];
                     } else {
                         // Create leaf _BVHBuildNode_
-                        int firstPrimOffset = orderedPrims.size();
+                        int firstPrimOffset = start;
                         for (int i = start; i < end; ++i) {
                             int primNum = primitiveInfo[i].primitiveNumber;
-                            orderedPrims.push_back(primitives[primNum]);
+                            orderedPrims[i] = primitives[primNum];
                         }
                         node->InitLeaf(firstPrimOffset, nPrimitives, bounds);
                         return node;
@@ -391,16 +1480,238 @@ BVHBuildNode *BVHAccel::recursiveBuild(
                 break;
             }
             }
-            node->InitInterior(dim,
-                               recursiveBuild(arena, primitiveInfo, start, mid,
-                                              totalNodes, orderedPrims),
-                               recursiveBuild(arena, primitiveInfo, mid, end,
-                                              totalNodes, orderedPrims));
+            // Build children, as parallel tasks for large subtrees
+            BVHBuildNode *children[2];
+            auto buildChild = [&](int64_t child) {
+                children[child] =
+                    child == 0 ? recursiveBuild(arenas, primitiveInfo, start,
+                                                mid, totalNodes, orderedPrims)
+                               : recursiveBuild(arenas, primitiveInfo, mid, end,
+                                                totalNodes, orderedPrims);
+            };
+            if (nPrimitives >= ParallelBuildThreshold)
+                ParallelFor(buildChild, 2);
+            else {
+                buildChild(0);
+                buildChild(1);
+            }
+            node->InitInterior(dim, children[0], children[1]);
         }
     }
     return node;
 }
 
+BVHBuildNode *BVHAccel::sbvhBuild(
+    MemoryArena &arena, std::vector<BVHPrimitiveInfo> &references,
+    Float rootArea, int depth, int *totalNodes, int64_t *duplicationBudget,
+    std::vector<std::shared_ptr<Primitive>> &orderedPrims) const {
+    CHECK(!references.empty());
+    BVHBuildNode *node = arena.Alloc<BVHBuildNode>();
+    (*totalNodes)++;
+    // Compute bounds of all references and their centroids in BVH node
+    Bounds3f bounds, centroidBounds;
+    for (const BVHPrimitiveInfo &ref : references) {
+        bounds = Union(bounds, ref.bounds);
+        centroidBounds = Union(centroidBounds, ref.centroid);
+    }
+    int nReferences = references.size();
+    // Unlike the other builds, a primitive may be referenced by several
+    // leaves, so leaves append their primitives to _orderedPrims_
+    auto createLeaf = [&]() {
+        int firstPrimOffset = orderedPrims.size();
+        for (const BVHPrimitiveInfo &ref : references)
+            orderedPrims.push_back(primitives[ref.primitiveNumber]);
+        node->InitLeaf(firstPrimOffset, nReferences, bounds);
+        return node;
+    };
+    if (nReferences == 1) return createLeaf();
+
+    // Find the best object split with binned SAH, as in _recursiveBuild()_
+    PBRT_CONSTEXPR int nBuckets = 12;
+    int dim = centroidBounds.MaximumExtent();
+    auto objectBucket = [&](const BVHPrimitiveInfo &ref) {
+        int b = nBuckets * centroidBounds.Offset(ref.centroid)[dim];
+        return Clamp(b, 0, nBuckets - 1);
+    };
+    Float objectCost = Infinity;
+    int objectSplitBucket = -1;
+    Bounds3f objectBounds[2];
+    if (centroidBounds.pMax[dim] > centroidBounds.pMin[dim]) {
+        BucketInfo buckets[nBuckets];
+        for (const BVHPrimitiveInfo &ref : references) {
+            int b = objectBucket(ref);
+            buckets[b].count++;
+            buckets[b].bounds = Union(buckets[b].bounds, ref.bounds);
+        }
+        for (int i = 0; i < nBuckets - 1; ++i) {
+            Bounds3f b0, b1;
+            int count0 = 0, count1 = 0;
+            for (int j = 0; j <= i; ++j) {
+                b0 = Union(b0, buckets[j].bounds);
+                count0 += buckets[j].count;
+            }
+            for (int j = i + 1; j < nBuckets; ++j) {
+                b1 = Union(b1, buckets[j].bounds);
+                count1 += buckets[j].count;
+            }
+            if (count0 == 0 || count1 == 0) continue;
+            Float cost = 1 + (count0 * b0.SurfaceArea() +
+                              count1 * b1.SurfaceArea()) /
+                                 bounds.SurfaceArea();
+            if (cost < objectCost) {
+                objectCost = cost;
+                objectSplitBucket = i;
+                objectBounds[0] = b0;
+                objectBounds[1] = b1;
+            }
+        }
+    }
+
+    // Look for a spatial split if the object split's children overlap
+    // enough and the reference budget isn't used up
+    Float spatialCost = Infinity;
+    int spatialAxis = -1;
+    Float spatialPlane = 0;
+    Bounds3f overlap = pbrt::Intersect(objectBounds[0], objectBounds[1]);
+    bool childrenOverlap =
+        objectSplitBucket == -1 ||
+        (!IsEmptyBound(overlap) &&
+         overlap.SurfaceArea() > SpatialSplitMinOverlap * rootArea);
+    if (childrenOverlap && *duplicationBudget > 0 &&
+        depth < MaxSpatialSplitDepth) {
+        PBRT_CONSTEXPR int nBins = 32;
+        for (int axis = 0; axis < 3; ++axis) {
+            Float lo = bounds.pMin[axis];
+            Float extent = bounds.pMax[axis] - lo;
+            if (extent <= 0) continue;
+            auto binIndex = [&](Float x) {
+                return Clamp(int(nBins * (x - lo) / extent), 0, nBins - 1);
+            };
+            auto binEdge = [&](int b) {
+                return b == nBins ? bounds.pMax[axis] : lo + extent * b / nBins;
+            };
+
+            // Bin the parts of each reference that fall in each bin; count
+            // where references start and end
+            Bounds3f binBounds[nBins];
+            int entries[nBins] = {0}, exits[nBins] = {0};
+            for (const BVHPrimitiveInfo &ref : references) {
+                int first = binIndex(ref.bounds.pMin[axis]);
+                int last = binIndex(ref.bounds.pMax[axis]);
+                if (first == last)
+                    binBounds[first] = Union(binBounds[first], ref.bounds);
+                else
+                    for (int b = first; b <= last; ++b) {
+                        Bounds3f slab = ref.bounds;
+                        slab.pMin[axis] = std::max(slab.pMin[axis], binEdge(b));
+                        slab.pMax[axis] =
+                            std::min(slab.pMax[axis], binEdge(b + 1));
+                        Bounds3f part =
+                            primitives[ref.primitiveNumber]->ClippedWorldBound(
+                                slab);
+                        if (!IsEmptyBound(part))
+                            binBounds[b] = Union(binBounds[b], part);
+                    }
+                ++entries[first];
+                ++exits[last];
+            }
+
+            // Sweep the planes between bins to find the cheapest one
+            Bounds3f rightBounds[nBins];
+            int rightCount[nBins];
+            Bounds3f accum;
+            int count = 0;
+            for (int b = nBins - 1; b > 0; --b) {
+                accum = Union(accum, binBounds[b]);
+                count += exits[b];
+                rightBounds[b] = accum;
+                rightCount[b] = count;
+            }
+            accum = Bounds3f();
+            count = 0;
+            for (int b = 0; b < nBins - 1; ++b) {
+                accum = Union(accum, binBounds[b]);
+                count += entries[b];
+                if (count == 0 || rightCount[b + 1] == 0) continue;
+                Float cost = 1 + (count * accum.SurfaceArea() +
+                                  rightCount[b + 1] *
+                                      rightBounds[b + 1].SurfaceArea()) /
+                                     bounds.SurfaceArea();
+                if (cost < spatialCost) {
+                    spatialCost = cost;
+                    spatialAxis = axis;
+                    spatialPlane = binEdge(b + 1);
+                }
+            }
+        }
+    }
+
+    // Create a leaf if no split is possible or worthwhile
+    Float minCost = std::min(objectCost, spatialCost);
+    if (minCost == Infinity ||
+        (nReferences <= maxPrimsInNode && minCost >= nReferences))
+        return createLeaf();
+
+    // Partition references into two sets
+    std::vector<BVHPrimitiveInfo> left, right;
+    int splitAxis = dim;
+    if (spatialCost < objectCost) {
+        // Clip references that straddle the plane to either side
+        int64_t nDuplicated = 0;
+        for (const BVHPrimitiveInfo &ref : references) {
+            if (ref.bounds.pMax[spatialAxis] <= spatialPlane)
+                left.push_back(ref);
+            else if (ref.bounds.pMin[spatialAxis] >= spatialPlane)
+                right.push_back(ref);
+            else {
+                const Primitive &prim = *primitives[ref.primitiveNumber];
+                Bounds3f leftClip = ref.bounds, rightClip = ref.bounds;
+                leftClip.pMax[spatialAxis] = spatialPlane;
+                rightClip.pMin[spatialAxis] = spatialPlane;
+                Bounds3f leftPart = prim.ClippedWorldBound(leftClip);
+                Bounds3f rightPart = prim.ClippedWorldBound(rightClip);
+                bool inLeft = !IsEmptyBound(leftPart);
+                bool inRight = !IsEmptyBound(rightPart);
+                if (inLeft)
+                    left.push_back(BVHPrimitiveInfo(ref.primitiveNumber,
+                                                    leftPart));
+                if (inRight)
+                    right.push_back(BVHPrimitiveInfo(ref.primitiveNumber,
+                                                     rightPart));
+                if (inLeft && inRight)
+                    ++nDuplicated;
+                else if (!inLeft && !inRight)
+                    left.push_back(ref);
+            }
+        }
+        if (nDuplicated <= *duplicationBudget && !left.empty() &&
+            !right.empty()) {
+            *duplicationBudget -= nDuplicated;
+            nDuplicatedReferences += nDuplicated;
+            ++nSpatialSplits;
+            splitAxis = spatialAxis;
+        } else {
+            left.clear();
+            right.clear();
+        }
+    }
+    if (left.empty() && right.empty()) {
+        if (objectSplitBucket == -1) return createLeaf();
+        for (const BVHPrimitiveInfo &ref : references)
+            (objectBucket(ref) <= objectSplitBucket ? left : right)
+                .push_back(ref);
+    }
+
+    // Release this node's references before building its children
+    std::vector<BVHPrimitiveInfo>().swap(references);
+    BVHBuildNode *c0 = sbvhBuild(arena, left, rootArea, depth + 1, totalNodes,
+                                 duplicationBudget, orderedPrims);
+    BVHBuildNode *c1 = sbvhBuild(arena, right, rootArea, depth + 1,
+                                 totalNodes, duplicationBudget, orderedPrims);
+    node->InitInterior(splitAxis, c0, c1);
+    return node;
+}
+
 BVHBuildNode *BVHAccel::HLBVHBuild(
     MemoryArena &arena, const std::vector<BVHPrimitiveInfo> &primitiveInfo,
     int *totalNodes,
@@ -657,27 +1968,120 @@ int BVHAccel::flattenBVHTree(BVHBuildNode *node, int *offset) {
     return myOffset;
 }
 
-BVHAccel::~BVHAccel() { FreeAligned(nodes); }
+template <int Width>
+WideBVHNode<Width> *BVHAccel::collapseBVHTree(BVHBuildNode *root,
+                                              int *totalWideNodes) const {
+    std::vector<WideBVHNode<Width>> wideNodes;
+    collapseBVHNode(root, &wideNodes);
+    *totalWideNodes = wideNodes.size();
+    WideBVHNode<Width> *result =
+        AllocAligned<WideBVHNode<Width>>(wideNodes.size());
+    std::copy(wideNodes.begin(), wideNodes.end(), result);
+    return result;
+}
+
+template <int Width>
+int BVHAccel::collapseBVHNode(
+    BVHBuildNode *node, std::vector<WideBVHNode<Width>> *wideNodes) const {
+    // Gather up to _Width_ descendants of _node_, repeatedly opening the
+    // interior child with the largest surface area
+    BVHBuildNode *children[Width];
+    int nChildren = 0;
+    if (node->nPrimitives > 0)
+        children[nChildren++] = node;
+    else {
+        children[nChildren++] = node->children[0];
+        children[nChildren++] = node->children[1];
+    }
+    while (nChildren < Width) {
+        int open = -1;
+        Float maxArea = -1;
+        for (int c = 0; c < nChildren; ++c)
+            if (children[c]->nPrimitives == 0 &&
+                children[c]->bounds.SurfaceArea() > maxArea) {
+                open = c;
+                maxArea = children[c]->bounds.SurfaceArea();
+            }
+        if (open == -1) break;
+        BVHBuildNode *opened = children[open];
+        children[open] = opened->children[0];
+        children[nChildren++] = opened->children[1];
+    }
+
+    // Initialize the wide node's SoA child bounds and offsets
+    int myOffset = wideNodes->size();
+    wideNodes->push_back(WideBVHNode<Width>());
+    ++wideInteriorNodes;
+    WideBVHNode<Width> wide{};
+    wide.nChildren = nChildren;
+    for (int c = 0; c < nChildren; ++c) {
+        const BVHBuildNode *child = children[c];
+        for (int axis = 0; axis < 3; ++axis) {
+            wide.bounds[0][axis][c] = child->bounds.pMin[axis];
+            wide.bounds[1][axis][c] = child->bounds.pMax[axis];
+        }
+        if (child->nPrimitives > 0) {
+            CHECK_LT(child->nPrimitives, 65536);
+            wide.offset[c] = child->firstPrimOffset;
+            wide.nPrimitives[c] = child->nPrimitives;
+        } else
+            wide.offset[c] = collapseBVHNode(children[c], wideNodes);
+    }
+    (*wideNodes)[myOffset] = wide;
+    return myOffset;
+}
+
+BVHAccel::~BVHAccel() {
+    // Cached nodes live inside the cache file's mapping
+    if (cacheData)
+        releaseCache();
+    else
+        FreeAligned(nodes);
+    FreeAligned(nodes4);
+    FreeAligned(nodes8);
+    FreeAligned(quantizedNodes);
+    FreeAligned(triangleBlocks);
+    FreeAligned(motionBounds);
+    for (LinearBVHNode *replica : nodeReplicas) FreeAligned(replica);
+}
 
 bool BVHAccel::Intersect(const Ray &ray, SurfaceInteraction *isect) const {
-    if (!nodes) return false;
     ProfilePhase p(Prof::AccelIntersect);
+    if (quantizedNodes) return intersectQuantized(ray, isect);
+    if (nodes4) return intersectWide(nodes4, ray, isect);
+    if (nodes8) return intersectWide(nodes8, ray, isect);
+    if (!nodes) return false;
+    return intersectSubtree(ray, 0, isect);
+}
+
+bool BVHAccel::intersectSubtree(const Ray &ray, int root,
+                                SurfaceInteraction *isect) const {
     bool hit = false;
     Vector3f invDir(1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z);
     int dirIsNeg[3] = {invDir.x < 0, invDir.y < 0, invDir.z < 0};
     // Follow ray through BVH nodes to find primitive intersections
-    int toVisitOffset = 0, currentNodeIndex = 0;
+    int toVisitOffset = 0, currentNodeIndex = root;
     int nodesToVisit[64];
+    int nodesVisited = 0, primitivesTested = 0;
+    TriangleRay triRay(ray);
+    int segment = motionBounds ? motionSegment(ray.time) : 0;
+    const LinearBVHNode *localNodes = threadNodes();
     while (true) {
-        const LinearBVHNode *node = &nodes[currentNodeIndex];
-        // Check ray against BVH node
-        if (node->bounds.IntersectP(ray, invDir, dirIsNeg)) {
+        const LinearBVHNode *node = &localNodes[currentNodeIndex];
+        ++nodesVisited;
+        // Check ray against BVH node, using the box for the ray's time
+        // when the nodes are bounded per motion segment
+        const Bounds3f &nodeBounds =
+            motionBounds
+                ? motionBounds[currentNodeIndex * nMotionSegments + segment]
+                : node->bounds;
+        if (nodeBounds.IntersectP(ray, invDir, dirIsNeg)) {
             if (node->nPrimitives > 0) {
                 // Intersect ray with primitives in leaf BVH node
-                for (int i = 0; i < node->nPrimitives; ++i)
-                    if (primitives[node->primitivesOffset + i]->Intersect(
-                            ray, isect))
-                        hit = true;
+                primitivesTested += node->nPrimitives;
+                if (intersectLeaf(ray, triRay, node->primitivesOffset,
+                                  node->nPrimitives, isect))
+                    hit = true;
                 if (toVisitOffset == 0) break;
                 currentNodeIndex = nodesToVisit[--toVisitOffset];
             } else {
@@ -696,26 +2100,115 @@ bool BVHAccel::Intersect(const Ray &ray, SurfaceInteraction *isect) const {
             currentNodeIndex = nodesToVisit[--toVisitOffset];
         }
     }
+    ReportValue(nodesVisitedPerRay, nodesVisited);
+    ReportValue(primitivesTestedPerRay, primitivesTested);
     return hit;
 }
 
 bool BVHAccel::IntersectP(const Ray &ray) const {
-    if (!nodes) return false;
     ProfilePhase p(Prof::AccelIntersectP);
+    if (quantizedNodes) return intersectQuantized(ray, nullptr);
+    if (nodes4) return intersectWide(nodes4, ray, nullptr);
+    if (nodes8) return intersectWide(nodes8, ray, nullptr);
+    if (!nodes) return false;
+    return intersectPSubtree(ray, 0);
+}
+
+bool BVHAccel::intersectQuantized(const Ray &ray,
+                                  SurfaceInteraction *isect) const {
+    // Dispatch to the traversal for the node encoding chosen at build time
+    if (width == 4 && quantizeBits == 8)
+        return intersectWide(
+            (const QuantizedBVHNode<4, uint8_t> *)quantizedNodes, ray, isect);
+    else if (width == 4)
+        return intersectWide(
+            (const QuantizedBVHNode<4, uint16_t> *)quantizedNodes, ray, isect);
+    else if (quantizeBits == 8)
+        return intersectWide(
+            (const QuantizedBVHNode<8, uint8_t> *)quantizedNodes, ray, isect);
+    else
+        return intersectWide(
+            (const QuantizedBVHNode<8, uint16_t> *)quantizedNodes, ray, isect);
+}
+
+template <typename Node>
+bool BVHAccel::intersectWide(const Node *wideNodes, const Ray &ray,
+                             SurfaceInteraction *isect) const {
+    // Find the closest hit when _isect_ is given, otherwise any hit
+    bool hit = false;
+    const Float o[3] = {ray.o.x, ray.o.y, ray.o.z};
+    const Float invDir[3] = {1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z};
+    const int dirIsNeg[3] = {invDir[0] < 0, invDir[1] < 0, invDir[2] < 0};
+    TriangleRay triRay(ray);
+    struct ToVisit {
+        int offset, nPrimitives;
+        Float tEnter;
+    };
+    ToVisit nodesToVisit[64 * (Node::width - 1)];
+    int toVisitOffset = 0;
+    nodesToVisit[toVisitOffset++] = {0, 0, 0};
+    while (toVisitOffset > 0) {
+        const ToVisit current = nodesToVisit[--toVisitOffset];
+        // Skip entries that a closer hit found since they were pushed
+        if (current.tEnter > ray.tMax) continue;
+        if (current.nPrimitives > 0) {
+            // Intersect ray with primitives in leaf child
+            if (intersectLeaf(ray, triRay, current.offset, current.nPrimitives,
+                              isect)) {
+                if (!isect) return true;
+                hit = true;
+            }
+            continue;
+        }
+
+        // Test all children at once and push the overlapped ones so that
+        // the nearest is visited next
+        const Node &node = wideNodes[current.offset];
+        Float tEnter[Node::width];
+        int hitMask =
+            IntersectChildren(node, o, invDir, dirIsNeg, ray.tMax, tEnter);
+        int order[Node::width], nHit = 0;
+        for (int c = 0; c < node.nChildren; ++c) {
+            if (!(hitMask & (1 << c))) continue;
+            int j = nHit++;
+            for (; j > 0 && tEnter[order[j - 1]] < tEnter[c]; --j)
+                order[j] = order[j - 1];
+            order[j] = c;
+        }
+        for (int k = 0; k < nHit; ++k) {
+            int c = order[k];
+            nodesToVisit[toVisitOffset++] = {node.offset[c],
+                                             node.nPrimitives[c], tEnter[c]};
+        }
+    }
+    return hit;
+}
+
+bool BVHAccel::intersectPSubtree(const Ray &ray, int root) const {
     Vector3f invDir(1.f / ray.d.x, 1.f / ray.d.y, 1.f / ray.d.z);
     int dirIsNeg[3] = {invDir.x < 0, invDir.y < 0, invDir.z < 0};
     int nodesToVisit[64];
-    int toVisitOffset = 0, currentNodeIndex = 0;
+    int toVisitOffset = 0, currentNodeIndex = root;
+    int nodesVisited = 0, primitivesTested = 0;
+    TriangleRay triRay(ray);
+    int segment = motionBounds ? motionSegment(ray.time) : 0;
+    const LinearBVHNode *localNodes = threadNodes();
     while (true) {
-        const LinearBVHNode *node = &nodes[currentNodeIndex];
-        if (node->bounds.IntersectP(ray, invDir, dirIsNeg)) {
+        const LinearBVHNode *node = &localNodes[currentNodeIndex];
+        ++nodesVisited;
+        const Bounds3f &nodeBounds =
+            motionBounds
+                ? motionBounds[currentNodeIndex * nMotionSegments + segment]
+                : node->bounds;
+        if (nodeBounds.IntersectP(ray, invDir, dirIsNeg)) {
             // Process BVH node _node_ for traversal
             if (node->nPrimitives > 0) {
-                for (int i = 0; i < node->nPrimitives; ++i) {
-                    if (primitives[node->primitivesOffset + i]->IntersectP(
-                            ray)) {
-                        return true;
-                    }
+                primitivesTested += node->nPrimitives;
+                if (intersectLeaf(ray, triRay, node->primitivesOffset,
+                                  node->nPrimitives, nullptr)) {
+                    ReportValue(nodesVisitedPerRay, nodesVisited);
+                    ReportValue(primitivesTestedPerRay, primitivesTested);
+                    return true;
                 }
                 if (toVisitOffset == 0) break;
                 currentNodeIndex = nodesToVisit[--toVisitOffset];
@@ -734,9 +2227,127 @@ bool BVHAccel::IntersectP(const Ray &ray) const {
             currentNodeIndex = nodesToVisit[--toVisitOffset];
         }
     }
+    ReportValue(nodesVisitedPerRay, nodesVisited);
+    ReportValue(primitivesTestedPerRay, primitivesTested);
     return false;
 }
 
+void BVHAccel::IntersectPacket(const Ray *rays, int nRays,
+                               SurfaceInteraction *isects, bool *hits) const {
+    // Wide nodes already test a ray against several boxes at once, and
+    // rays in a packet may fall in different motion segments, so these
+    // packets are traced one ray at a time
+    if (nodes4 || nodes8 || quantizedNodes || motionBounds) {
+        Primitive::IntersectPacket(rays, nRays, isects, hits);
+        return;
+    }
+    if (!nodes) {
+        for (int i = 0; i < nRays; ++i) hits[i] = false;
+        return;
+    }
+    ProfilePhase p(Prof::AccelIntersect);
+    for (int start = 0; start < nRays; start += BVHPacketSize)
+        tracePacket(&rays[start], std::min(BVHPacketSize, nRays - start),
+                    &isects[start], &hits[start]);
+}
+
+void BVHAccel::IntersectPPacket(const Ray *rays, int nRays,
+                                bool *occluded) const {
+    if (nodes4 || nodes8 || quantizedNodes || motionBounds) {
+        Primitive::IntersectPPacket(rays, nRays, occluded);
+        return;
+    }
+    if (!nodes) {
+        for (int i = 0; i < nRays; ++i) occluded[i] = false;
+        return;
+    }
+    ProfilePhase p(Prof::AccelIntersectP);
+    for (int start = 0; start < nRays; start += BVHPacketSize)
+        tracePacket(&rays[start], std::min(BVHPacketSize, nRays - start),
+                    nullptr, &occluded[start]);
+}
+
+void BVHAccel::tracePacket(const Ray *rays, int nRays,
+                           SurfaceInteraction *isects, bool *hits) const {
+    // Closest hits are wanted when _isects_ is given; otherwise any hit
+    // occludes its ray and retires the lane
+    ++nPacketTraversals;
+    BVHRayPacket packet;
+    TriangleRay triRays[BVHPacketSize];
+    int activeMask = 0;
+    for (int lane = 0; lane < BVHPacketSize; ++lane) {
+        if (lane < nRays) {
+            packet.Set(lane, rays[lane]);
+            triRays[lane] = TriangleRay(rays[lane]);
+            hits[lane] = false;
+            activeMask |= 1 << lane;
+        } else
+            packet.Clear(lane);
+    }
+
+    // Below this many overlapping rays a node's subtree is cheaper to
+    // finish one ray at a time than with mostly-empty packet tests
+    const int minCoherentLanes = std::max(2, BVHPacketSize / 4);
+    int toVisitOffset = 0, currentNodeIndex = 0;
+    int nodesToVisit[64];
+    const LinearBVHNode *localNodes = threadNodes();
+    while (true) {
+        const LinearBVHNode *node = &localNodes[currentNodeIndex];
+        int hitMask = packet.IntersectP(node->bounds) & activeMask;
+        if (hitMask != 0 && CountActiveLanes(hitMask) < minCoherentLanes) {
+            // Fall back to single-ray traversal of _node_'s subtree
+            ++nPacketFallbacks;
+            for (int lane = 0; lane < nRays; ++lane) {
+                if (!(hitMask & (1 << lane))) continue;
+                if (isects) {
+                    if (intersectSubtree(rays[lane], currentNodeIndex,
+                                         &isects[lane])) {
+                        hits[lane] = true;
+                        packet.tMax[lane] = rays[lane].tMax;
+                    }
+                } else if (intersectPSubtree(rays[lane], currentNodeIndex)) {
+                    hits[lane] = true;
+                    activeMask &= ~(1 << lane);
+                }
+            }
+            hitMask = 0;
+        }
+        if (hitMask != 0 && node->nPrimitives > 0) {
+            // Intersect the overlapping rays with the leaf's primitives
+            for (int lane = 0; lane < nRays; ++lane) {
+                if (!(hitMask & (1 << lane))) continue;
+                if (isects) {
+                    if (intersectLeaf(rays[lane], triRays[lane],
+                                      node->primitivesOffset,
+                                      node->nPrimitives, &isects[lane])) {
+                        hits[lane] = true;
+                        packet.tMax[lane] = rays[lane].tMax;
+                    }
+                } else if (intersectLeaf(rays[lane], triRays[lane],
+                                         node->primitivesOffset,
+                                         node->nPrimitives, nullptr)) {
+                    hits[lane] = true;
+                    activeMask &= ~(1 << lane);
+                }
+            }
+            if (activeMask == 0 || toVisitOffset == 0) break;
+            currentNodeIndex = nodesToVisit[--toVisitOffset];
+        } else if (hitMask != 0) {
+            // Order children by the direction of the first overlapping ray
+            if (packet.dirIsNeg[FirstActiveLane(hitMask)][node->axis]) {
+                nodesToVisit[toVisitOffset++] = currentNodeIndex + 1;
+                currentNodeIndex = node->secondChildOffset;
+            } else {
+                nodesToVisit[toVisitOffset++] = node->secondChildOffset;
+                currentNodeIndex = currentNodeIndex + 1;
+            }
+        } else {
+            if (activeMask == 0 || toVisitOffset == 0) break;
+            currentNodeIndex = nodesToVisit[--toVisitOffset];
+        }
+    }
+}
+
 std::shared_ptr<BVHAccel> CreateBVHAccelerator(
     std::vector<std::shared_ptr<Primitive>> prims, const ParamSet &ps) {
     std::string splitMethodName = ps.FindOneString("splitmethod", "sah");
@@ -749,6 +2360,8 @@ std::shared_ptr<BVHAccel> CreateBVHAccelerator(
         splitMethod = BVHAccel::SplitMethod::Middle;
     else if (splitMethodName == "equal")
         splitMethod = BVHAccel::SplitMethod::EqualCounts;
+    else if (splitMethodName == "sbvh")
+        splitMethod = BVHAccel::SplitMethod::SBVH;
     else {
         Warning("BVH split method \"%s\" unknown.  Using \"sah\".",
                 splitMethodName.c_str());
@@ -756,7 +2369,68 @@ std::shared_ptr<BVHAccel> CreateBVHAccelerator(
     }
 
     int maxPrimsInNode = ps.FindOneInt("maxnodeprims", 4);
-    return std::make_shared<BVHAccel>(std::move(prims), maxPrimsInNode, splitMethod);
+    int width = ps.FindOneInt("width", 2);
+    if (width != 2 && width != 4 && width != 8) {
+        Warning("BVH width %d unsupported; must be 2, 4, or 8.  Using 2.",
+                width);
+        width = 2;
+    }
+    int quantizeBits = ps.FindOneInt("quantize", 0);
+    if (quantizeBits != 0 && quantizeBits != 8 && quantizeBits != 16) {
+        Warning("BVH quantization to %d bits unsupported; must be 0, 8, or "
+                "16.  Using 0.", quantizeBits);
+        quantizeBits = 0;
+    }
+    if (quantizeBits != 0 && width == 2) {
+        Warning("Quantized BVH nodes require a width of 4 or 8.  Using 4.");
+        width = 4;
+    }
+    std::string cacheDir = ps.FindOneFilename("cachedir", "");
+    if (!cacheDir.empty() && width != 2) {
+        Warning("BVH caching is only supported with width 2. "
+                "Ignoring \"cachedir\".");
+        cacheDir.clear();
+    } else if (!cacheDir.empty() &&
+               splitMethod == BVHAccel::SplitMethod::SBVH) {
+        Warning("BVH caching isn't supported with the \"sbvh\" split "
+                "method, whose splits depend on more than primitive bounds. "
+                "Ignoring \"cachedir\".");
+        cacheDir.clear();
+    }
+    Float maxDuplication = ps.FindOneFloat("maxduplication", 0.3f);
+    bool soaTriangles = ps.FindOneBool("soatriangles", false);
+    int motionSegments = ps.FindOneInt("motionsegments", 1);
+    if (motionSegments > 1 && width != 2) {
+        Warning("BVH motion segments require a width of 2. "
+                "Ignoring \"motionsegments\".");
+        motionSegments = 1;
+    }
+    bool numaReplicate = ps.FindOneBool("numareplicate", false);
+    if (numaReplicate && width != 2) {
+        Warning("BVH NUMA replication requires a width of 2. "
+                "Ignoring \"numareplicate\".");
+        numaReplicate = false;
+    } else if (numaReplicate && !PbrtOptions.pinThreads) {
+        Warning("\"numareplicate\" has no effect unless threads are "
+                "pinned with --pinthreads.");
+        numaReplicate = false;
+    }
+    Float motionTime0 = 0, motionTime1 = 1;
+    int nMotionTimes;
+    const Float *motionTimes = ps.FindFloat("motiontimes", &nMotionTimes);
+    if (motionTimes && nMotionTimes == 2 && motionTimes[1] > motionTimes[0]) {
+        motionTime0 = motionTimes[0];
+        motionTime1 = motionTimes[1];
+    } else if (motionTimes)
+        Warning("\"motiontimes\" should be two increasing values. "
+                "Using [ 0 1 ].");
+    std::shared_ptr<BVHAccel> bvh = std::make_shared<BVHAccel>(
+        std::move(prims), maxPrimsInNode, splitMethod, width, quantizeBits,
+        cacheDir, maxDuplication, soaTriangles);
+    if (motionSegments > 1)
+        bvh->BuildMotionBounds(motionSegments, motionTime0, motionTime1);
+    if (numaReplicate) bvh->ReplicatePerNumaNode();
+    return bvh;
 }
 
 }  // namespace pbrt
@@ -50,28 +50,57 @@ struct BVHBuildNode;
 struct BVHPrimitiveInfo;
 struct MortonPrimitive;
 struct LinearBVHNode;
+template <int Width>
+struct WideBVHNode;
+struct TriangleBlock;
+struct TriangleRay;
+
+// BVHAccel Packet Traversal Width
+#if defined(PBRT_HAVE_AVX) && !defined(PBRT_FLOAT_AS_DOUBLE)
+static PBRT_CONSTEXPR int BVHPacketSize = 8;
+#else
+static PBRT_CONSTEXPR int BVHPacketSize = 4;
+#endif
 
 // BVHAccel Declarations
 class BVHAccel : public Aggregate {
   public:
     // BVHAccel Public Types
-    enum class SplitMethod { SAH, HLBVH, Middle, EqualCounts };
+    enum class SplitMethod { SAH, HLBVH, Middle, EqualCounts, SBVH };
 
     // BVHAccel Public Methods
     BVHAccel(std::vector<std::shared_ptr<Primitive>> p,
              int maxPrimsInNode = 1,
-             SplitMethod splitMethod = SplitMethod::SAH);
+             SplitMethod splitMethod = SplitMethod::SAH, int width = 2,
+             int quantizeBits = 0, const std::string &cacheDir = "",
+             Float maxDuplication = 0.3f, bool soaTriangles = false);
     Bounds3f WorldBound() const;
     ~BVHAccel();
     bool Intersect(const Ray &ray, SurfaceInteraction *isect) const;
     bool IntersectP(const Ray &ray) const;
+    void IntersectPacket(const Ray *rays, int nRays, SurfaceInteraction *isects,
+                         bool *hits) const;
+    void IntersectPPacket(const Ray *rays, int nRays, bool *occluded) const;
+    size_t NodeBytes() const { return nodeBytes; }
+    const std::string &CacheFilename() const { return cacheFilename; }
+    bool LoadedFromCache() const { return cacheData != nullptr; }
+    bool Refit();
+    Float SAHCost() const;
+    void BuildMotionBounds(int nSegments, Float time0, Float time1);
+    void ReplicatePerNumaNode();
 
   private:
     // BVHAccel Private Methods
     BVHBuildNode *recursiveBuild(
-        MemoryArena &arena, std::vector<BVHPrimitiveInfo> &primitiveInfo,
-        int start, int end, int *totalNodes,
+        std::vector<MemoryArena> &arenas,
+        std::vector<BVHPrimitiveInfo> &primitiveInfo, int start, int end,
+        std::atomic<int> *totalNodes,
         std::vector<std::shared_ptr<Primitive>> &orderedPrims);
+    BVHBuildNode *sbvhBuild(
+        MemoryArena &arena, std::vector<BVHPrimitiveInfo> &references,
+        Float rootArea, int depth, int *totalNodes,
+        int64_t *duplicationBudget,
+        std::vector<std::shared_ptr<Primitive>> &orderedPrims) const;
     BVHBuildNode *HLBVHBuild(
         MemoryArena &arena, const std::vector<BVHPrimitiveInfo> &primitiveInfo,
         int *totalNodes,
@@ -86,12 +115,60 @@ class BVHAccel : public Aggregate {
                                 std::vector<BVHBuildNode *> &treeletRoots,
                                 int start, int end, int *totalNodes) const;
     int flattenBVHTree(BVHBuildNode *node, int *offset);
+    template <int Width>
+    WideBVHNode<Width> *collapseBVHTree(BVHBuildNode *root,
+                                        int *totalWideNodes) const;
+    template <int Width>
+    int collapseBVHNode(BVHBuildNode *node,
+                        std::vector<WideBVHNode<Width>> *wideNodes) const;
+    template <typename Node>
+    bool intersectWide(const Node *wideNodes, const Ray &ray,
+                       SurfaceInteraction *isect) const;
+    bool intersectQuantized(const Ray &ray, SurfaceInteraction *isect) const;
+    bool readCache(const std::string &filename, uint64_t geometryHash);
+    void writeCache(
+        const std::string &filename, uint64_t geometryHash,
+        const std::vector<std::shared_ptr<Primitive>> &unorderedPrims,
+        int totalNodes) const;
+    void releaseCache();
+    void computeMotionBounds();
+    void copyNodeReplicas();
+    const LinearBVHNode *threadNodes() const;
+    int motionSegment(Float time) const {
+        Float t = (time - motionTime0) / (motionTime1 - motionTime0);
+        if (!(t > 0)) return 0;
+        return std::min(int(t * nMotionSegments), nMotionSegments - 1);
+    }
+    void buildTriangleBlocks(const std::vector<std::pair<int, int>> &leaves);
+    bool intersectLeaf(const Ray &ray, const TriangleRay &triRay, int offset,
+                       int nPrimitives, SurfaceInteraction *isect) const;
+    bool intersectSubtree(const Ray &ray, int root,
+                          SurfaceInteraction *isect) const;
+    bool intersectPSubtree(const Ray &ray, int root) const;
+    void tracePacket(const Ray *rays, int nRays, SurfaceInteraction *isects,
+                     bool *hits) const;
 
     // BVHAccel Private Data
     const int maxPrimsInNode;
     const SplitMethod splitMethod;
     std::vector<std::shared_ptr<Primitive>> primitives;
     LinearBVHNode *nodes = nullptr;
+    const int width;
+    WideBVHNode<4> *nodes4 = nullptr;
+    WideBVHNode<8> *nodes8 = nullptr;
+    const int quantizeBits;
+    void *quantizedNodes = nullptr;
+    Bounds3f bounds;
+    size_t nodeBytes = 0;
+    std::string cacheFilename;
+    void *cacheData = nullptr;
+    size_t cacheDataLength = 0;
+    TriangleBlock *triangleBlocks = nullptr;
+    std::vector<int32_t> leafTriangleBlocks;
+    int nMotionSegments = 0;
+    Float motionTime0 = 0, motionTime1 = 1;
+    Bounds3f *motionBounds = nullptr;
+    std::vector<LinearBVHNode *> nodeReplicas;
 };
 
 std::shared_ptr<BVHAccel> CreateBVHAccelerator(
@@ -36,6 +36,7 @@
 #include "paramset.h"
 #include "interaction.h"
 #include "stats.h"
+#include "parallel.h"
 #include <algorithm>
 
 namespace pbrt {
@@ -54,6 +55,13 @@ struct KdAccelNode {
     int SplitAxis() const { return flags & 3; }
     bool IsLeaf() const { return (flags & 3) == 3; }
     int AboveChild() const { return aboveChild >> 2; }
+    void Relocate(int nodeOffset, int indexOffset) {
+        // Shift a node built in a separate subtree to its final position
+        if (!IsLeaf())
+            aboveChild += nodeOffset << 2;
+        else if (nPrimitives() > 1)
+            primitiveIndicesOffset += indexOffset;
+    }
     union {
         Float split;                 // Interior
         int onePrimitive;            // Leaf
@@ -80,6 +88,18 @@ struct BoundEdge {
     EdgeType type;
 };
 
+// Nodes and leaf primitive indices for a subtree, numbered from its root;
+// subtrees built as separate tasks are spliced into their parent's
+struct KdSubtree {
+    std::vector<KdAccelNode> nodes;
+    std::vector<int> primitiveIndices;
+};
+
+// KdTreeAccel Build Constants
+// Interior nodes with at least this many primitives build their above
+// child as a parallel task with its own scratch buffers.
+static PBRT_CONSTEXPR int ParallelBuildThreshold = 8192;
+
 // KdTreeAccel Method Definitions
 KdTreeAccel::KdTreeAccel(std::vector<std::shared_ptr<Primitive>> p,
                          int isectCost, int traversalCost, Float emptyBonus,
@@ -91,7 +111,6 @@ KdTreeAccel::KdTreeAccel(std::vector<std::shared_ptr<Primitive>> p,
       primitives(std::move(p)) {
     // Build kd-tree for accelerator
     ProfilePhase _(Prof::AccelConstruction);
-    nextFreeNode = nAllocedNodes = 0;
     if (maxDepth <= 0)
         maxDepth = std::round(8 + 1.3f * Log2Int(int64_t(primitives.size())));
 
@@ -116,8 +135,13 @@ KdTreeAccel::KdTreeAccel(std::vector<std::shared_ptr<Primitive>> p,
     for (size_t i = 0; i < primitives.size(); ++i) primNums[i] = i;
 
     // Start recursive construction of kd-tree
-    buildTree(0, bounds, primBounds, primNums.get(), primitives.size(),
+    KdSubtree tree;
+    buildTree(&tree, bounds, primBounds, primNums.get(), primitives.size(),
               maxDepth, edges, prims0.get(), prims1.get());
+    nNodes = tree.nodes.size();
+    nodes = AllocAligned<KdAccelNode>(nNodes);
+    memcpy(nodes, tree.nodes.data(), nNodes * sizeof(KdAccelNode));
+    primitiveIndices = std::move(tree.primitiveIndices);
 }
 
 void KdAccelNode::InitLeaf(int *primNums, int np,
@@ -137,28 +161,21 @@ void KdAccelNode::InitLeaf(int *primNums, int np,
 
 KdTreeAccel::~KdTreeAccel() { FreeAligned(nodes); }
 
-void KdTreeAccel::buildTree(int nodeNum, const Bounds3f &nodeBounds,
+size_t KdTreeAccel::NodeBytes() const { return nNodes * sizeof(KdAccelNode); }
+
+void KdTreeAccel::buildTree(KdSubtree *tree, const Bounds3f &nodeBounds,
                             const std::vector<Bounds3f> &allPrimBounds,
                             int *primNums, int nPrimitives, int depth,
                             const std::unique_ptr<BoundEdge[]> edges[3],
                             int *prims0, int *prims1, int badRefines) {
-    CHECK_EQ(nodeNum, nextFreeNode);
-    // Get next free node from _nodes_ array
-    if (nextFreeNode == nAllocedNodes) {
-        int nNewAllocNodes = std::max(2 * nAllocedNodes, 512);
-        KdAccelNode *n = AllocAligned<KdAccelNode>(nNewAllocNodes);
-        if (nAllocedNodes > 0) {
-            memcpy(n, nodes, nAllocedNodes * sizeof(KdAccelNode));
-            FreeAligned(nodes);
-        }
-        nodes = n;
-        nAllocedNodes = nNewAllocNodes;
-    }
-    ++nextFreeNode;
+    // Get next free node from _tree_'s nodes
+    int nodeNum = tree->nodes.size();
+    tree->nodes.push_back(KdAccelNode());
 
     // Initialize leaf node if termination criteria met
     if (nPrimitives <= maxPrims || depth == 0) {
-        nodes[nodeNum].InitLeaf(primNums, nPrimitives, &primitiveIndices);
+        tree->nodes[nodeNum].InitLeaf(primNums, nPrimitives,
+                                      &tree->primitiveIndices);
         return;
     }
 
@@ -237,7 +254,8 @@ retrySplit:
     if (bestCost > oldCost) ++badRefines;
     if ((bestCost > 4 * oldCost && nPrimitives < 16) || bestAxis == -1 ||
         badRefines == 3) {
-        nodes[nodeNum].InitLeaf(primNums, nPrimitives, &primitiveIndices);
+        tree->nodes[nodeNum].InitLeaf(primNums, nPrimitives,
+                                      &tree->primitiveIndices);
         return;
     }
 
@@ -254,12 +272,46 @@ retrySplit:
     Float tSplit = edges[bestAxis][bestOffset].t;
     Bounds3f bounds0 = nodeBounds, bounds1 = nodeBounds;
     bounds0.pMax[bestAxis] = bounds1.pMin[bestAxis] = tSplit;
-    buildTree(nodeNum + 1, bounds0, allPrimBounds, prims0, n0, depth - 1, edges,
-              prims0, prims1 + nPrimitives, badRefines);
-    int aboveChild = nextFreeNode;
-    nodes[nodeNum].InitInterior(bestAxis, aboveChild, tSplit);
-    buildTree(aboveChild, bounds1, allPrimBounds, prims1, n1, depth - 1, edges,
-              prims0, prims1 + nPrimitives, badRefines);
+    if (nPrimitives < ParallelBuildThreshold) {
+        buildTree(tree, bounds0, allPrimBounds, prims0, n0, depth - 1, edges,
+                  prims0, prims1 + nPrimitives, badRefines);
+        int aboveChild = tree->nodes.size();
+        tree->nodes[nodeNum].InitInterior(bestAxis, aboveChild, tSplit);
+        buildTree(tree, bounds1, allPrimBounds, prims1, n1, depth - 1, edges,
+                  prims0, prims1 + nPrimitives, badRefines);
+        return;
+    }
+
+    // Build the above child concurrently into its own subtree; it only
+    // reads _prims1_'s first _n1_ entries, which the below child leaves
+    // alone
+    KdSubtree above;
+    ParallelFor([&](int64_t child) {
+        if (child == 0) {
+            buildTree(tree, bounds0, allPrimBounds, prims0, n0, depth - 1,
+                      edges, prims0, prims1 + nPrimitives, badRefines);
+            return;
+        }
+        std::unique_ptr<BoundEdge[]> aboveEdges[3];
+        for (int i = 0; i < 3; ++i) aboveEdges[i].reset(new BoundEdge[2 * n1]);
+        std::unique_ptr<int[]> abovePrims0(new int[n1]);
+        std::unique_ptr<int[]> abovePrims1(new int[size_t(depth) * n1]);
+        buildTree(&above, bounds1, allPrimBounds, prims1, n1, depth - 1,
+                  aboveEdges, abovePrims0.get(), abovePrims1.get(), badRefines);
+    }, 2);
+
+    // Append the above subtree, giving the same layout as a serial build
+    int aboveChild = tree->nodes.size();
+    tree->nodes[nodeNum].InitInterior(bestAxis, aboveChild, tSplit);
+    int indexOffset = tree->primitiveIndices.size();
+    tree->nodes.reserve(tree->nodes.size() + above.nodes.size());
+    for (KdAccelNode &node : above.nodes) {
+        node.Relocate(aboveChild, indexOffset);
+        tree->nodes.push_back(node);
+    }
+    tree->primitiveIndices.insert(tree->primitiveIndices.end(),
+                                  above.primitiveIndices.begin(),
+                                  above.primitiveIndices.end());
 }
 
 bool KdTreeAccel::Intersect(const Ray &ray, SurfaceInteraction *isect) const {
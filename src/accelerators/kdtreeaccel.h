@@ -47,6 +47,7 @@ namespace pbrt {
 // KdTreeAccel Declarations
 struct KdAccelNode;
 struct BoundEdge;
+struct KdSubtree;
 class KdTreeAccel : public Aggregate {
   public:
     // KdTreeAccel Public Methods
@@ -57,10 +58,11 @@ class KdTreeAccel : public Aggregate {
     ~KdTreeAccel();
     bool Intersect(const Ray &ray, SurfaceInteraction *isect) const;
     bool IntersectP(const Ray &ray) const;
+    size_t NodeBytes() const;
 
   private:
     // KdTreeAccel Private Methods
-    void buildTree(int nodeNum, const Bounds3f &bounds,
+    void buildTree(KdSubtree *tree, const Bounds3f &bounds,
                    const std::vector<Bounds3f> &primBounds, int *primNums,
                    int nprims, int depth,
                    const std::unique_ptr<BoundEdge[]> edges[3], int *prims0,
@@ -72,7 +74,7 @@ class KdTreeAccel : public Aggregate {
     std::vector<std::shared_ptr<Primitive>> primitives;
     std::vector<int> primitiveIndices;
     KdAccelNode *nodes;
-    int nAllocedNodes, nextFreeNode;
+    int nNodes;
     Bounds3f bounds;
 };
 
@@ -50,7 +50,7 @@ Float EnvironmentCamera::GenerateRay(const CameraSample &sample,
     Vector3f dir(std::sin(theta) * std::cos(phi), std::cos(theta),
                  std::sin(theta) * std::sin(phi));
                  
-    *ray = Ray(Point3f(0, 0, 0), dir, Vector4f(0.f), Infinity,
+    *ray = Ray(Point3f(0, 0, 0), dir, WvlPacketf(0.f), Infinity,
                Lerp(sample.time, shutterOpen, shutterClose));
                  
     // Compute wavelengths
@@ -47,7 +47,7 @@ Float OrthographicCamera::GenerateRay(const CameraSample &sample,
     // Compute raster and camera sample positions
     Point3f pFilm = Point3f(sample.pFilm.x, sample.pFilm.y, 0);
     Point3f pCamera = RasterToCamera(pFilm);
-    *ray = Ray(pCamera, Vector3f(0, 0, 1), Vector4f());
+    *ray = Ray(pCamera, Vector3f(0, 0, 1), WvlPacketf());
     // Modify ray for depth of field
     if (lensRadius > 0) {
         // Sample point on lens
@@ -80,7 +80,7 @@ Float OrthographicCamera::GenerateRayDifferential(const CameraSample &sample,
     // Compute raster and camera sample positions
     Point3f pFilm = Point3f(sample.pFilm.x, sample.pFilm.y, 0);
     Point3f pCamera = RasterToCamera(pFilm);
-    *ray = RayDifferential(pCamera, Vector3f(0, 0, 1), Vector4f());
+    *ray = RayDifferential(pCamera, Vector3f(0, 0, 1), WvlPacketf());
 
     // Modify ray for depth of field
     if (lensRadius > 0) {
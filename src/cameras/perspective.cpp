@@ -72,7 +72,7 @@ Float PerspectiveCamera::GenerateRay(const CameraSample &sample,
     // Compute raster and camera sample positions
     Point3f pFilm = Point3f(sample.pFilm.x, sample.pFilm.y, 0);
     Point3f pCamera = RasterToCamera(pFilm);
-    *ray = Ray(Point3f(0, 0, 0), Normalize(Vector3f(pCamera)), Vector4f());
+    *ray = Ray(Point3f(0, 0, 0), Normalize(Vector3f(pCamera)), WvlPacketf());
     // Modify ray for depth of field
     if (lensRadius > 0) {
         // Sample point on lens
@@ -104,7 +104,7 @@ Float PerspectiveCamera::GenerateRayDifferential(const CameraSample &sample,
     Point3f pFilm = Point3f(sample.pFilm.x, sample.pFilm.y, 0);
     Point3f pCamera = RasterToCamera(pFilm);
     Vector3f dir = Normalize(Vector3f(pCamera.x, pCamera.y, pCamera.z));
-    *ray = RayDifferential(Point3f(0, 0, 0), dir, Vector4f());
+    *ray = RayDifferential(Point3f(0, 0, 0), dir, WvlPacketf());
     // Modify ray for depth of field
     if (lensRadius > 0) {
         // Sample point on lens
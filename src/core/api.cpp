@@ -60,8 +60,11 @@
 #include "integrators/mypath.h"
 #include "integrators/hero_path.h"
 #include "integrators/hero_path_mis.h"
+#include "integrators/hero_volpath.h"
+#include "integrators/hero_bdpt.h"
 #include "integrators/sppm.h"
 #include "integrators/volpath.h"
+#include "integrators/wavefront.h"
 #include "integrators/whitted.h"
 #include "lights/diffuse.h"
 #include "lights/portal_arealight.h"
@@ -187,9 +190,62 @@ struct RenderOptions {
     std::vector<std::shared_ptr<Primitive>> primitives;
     std::map<std::string, std::vector<std::shared_ptr<Primitive>>> instances;
     std::vector<std::shared_ptr<Primitive>> *currentInstance = nullptr;
+    bool currentInstanceResident = false;
     bool haveScatteringMedia = false;
 };
 
+// With --multiframe, object instances and their placements outlive the
+// world block that created them, so that later frames only refit the
+// aggregate over the instances
+struct InstanceUse {
+    std::shared_ptr<Primitive> instance;
+    std::shared_ptr<TransformedPrimitive> prim;
+    std::unique_ptr<Transform[]> InstanceToWorld;
+};
+
+struct MultiFrameState {
+    // MultiFrameState Public Methods
+    std::shared_ptr<Primitive> PlaceInstance(
+        std::shared_ptr<Primitive> &instance, const TransformSet &transforms,
+        Float startTime, Float endTime);
+
+    // MultiFrameState Public Data
+    std::map<std::string, std::shared_ptr<Primitive>> instances;
+    std::vector<InstanceUse> uses, previousUses;
+    std::vector<std::shared_ptr<Primitive>> primitives;
+    std::shared_ptr<Primitive> accelerator;
+    Float builtCost = 0;
+};
+
+std::shared_ptr<Primitive> MultiFrameState::PlaceInstance(
+    std::shared_ptr<Primitive> &instance, const TransformSet &transforms,
+    Float startTime, Float endTime) {
+    // Move the previous frame's placement at the same position in the
+    // scene description if it's of the same instance
+    InstanceUse use;
+    size_t index = uses.size();
+    if (index < previousUses.size() &&
+        previousUses[index].instance == instance)
+        use = std::move(previousUses[index]);
+    else {
+        use.instance = instance;
+        use.InstanceToWorld.reset(new Transform[2]);
+    }
+    static_assert(MaxTransforms == 2,
+                  "InstanceUse assumes only two transforms");
+    use.InstanceToWorld[0] = transforms[0];
+    use.InstanceToWorld[1] = transforms[1];
+    AnimatedTransform animatedInstanceToWorld(
+        &use.InstanceToWorld[0], startTime, &use.InstanceToWorld[1], endTime);
+    if (use.prim)
+        use.prim->SetPrimitiveToWorld(animatedInstanceToWorld);
+    else
+        use.prim = std::make_shared<TransformedPrimitive>(
+            instance, animatedInstanceToWorld);
+    uses.push_back(std::move(use));
+    return uses.back().prim;
+}
+
 // MaterialInstance represents both an instance of a material as well as
 // the information required to create another instance of it (possibly with
 // different parameters from the shape).
@@ -375,6 +431,8 @@ static std::vector<GraphicsState> pushedGraphicsStates;
 static std::vector<TransformSet> pushedTransforms;
 static std::vector<uint32_t> pushedActiveTransformBits;
 static TransformCache transformCache;
+static TransformCache residentTransformCache;
+static std::unique_ptr<MultiFrameState> multiFrameState;
 int catIndentCount = 0;
 
 // API Forward Declarations
@@ -896,6 +954,8 @@ void pbrtInit(const Options &opt) {
     renderOptions.reset(new RenderOptions);
     graphicsState = GraphicsState();
     catIndentCount = 0;
+    if (opt.multiFrame && !opt.cat && !opt.toPly)
+        multiFrameState.reset(new MultiFrameState);
 
     // General \pbrt Initialization
     SampledSpectrum::Init();
@@ -911,6 +971,8 @@ void pbrtCleanup() {
     else if (currentApiState == APIState::WorldBlock)
         Error("pbrtCleanup() called while inside world block.");
     currentApiState = APIState::Uninitialized;
+    multiFrameState.reset();
+    residentTransformCache.Clear();
     ParallelCleanup();
     CleanupProfiler();
 }
@@ -1345,6 +1407,14 @@ void pbrtAreaLightSource(const std::string &name, const ParamSet &params) {
     }
 }
 
+// With --multiframe, instance definitions outlive the frame, so their
+// shapes take transforms from a cache that isn't cleared at WorldEnd.
+static TransformCache &ShapeTransformCache() {
+    return (multiFrameState && renderOptions->currentInstance)
+               ? residentTransformCache
+               : transformCache;
+}
+
 void pbrtShape(const std::string &name, const ParamSet &params) {
     VERIFY_WORLD("Shape");
     std::vector<std::shared_ptr<Primitive>> prims;
@@ -1354,13 +1424,15 @@ void pbrtShape(const std::string &name, const ParamSet &params) {
         params.Print(catIndentCount);
         printf("\n");
     }
+    if (renderOptions->currentInstanceResident) return;
 
+    TransformCache &cache = ShapeTransformCache();
     if (!curTransform.IsAnimated()) {
         // Initialize _prims_ and _areaLights_ for static shape
 
         // Create shapes for shape _name_
-        Transform *ObjToWorld = transformCache.Lookup(curTransform[0]);
-        Transform *WorldToObj = transformCache.Lookup(Inverse(curTransform[0]));
+        Transform *ObjToWorld = cache.Lookup(curTransform[0]);
+        Transform *WorldToObj = cache.Lookup(Inverse(curTransform[0]));
         std::vector<std::shared_ptr<Shape>> shapes =
             MakeShapes(name, ObjToWorld, WorldToObj,
                        graphicsState.reverseOrientation, params);
@@ -1388,7 +1460,7 @@ void pbrtShape(const std::string &name, const ParamSet &params) {
             Warning(
                 "Ignoring currently set area light when creating "
                 "animated shape");
-        Transform *identity = transformCache.Lookup(Transform());
+        Transform *identity = cache.Lookup(Transform());
         std::vector<std::shared_ptr<Shape>> shapes = MakeShapes(
             name, identity, identity, graphicsState.reverseOrientation, params);
         if (shapes.empty()) return;
@@ -1408,8 +1480,8 @@ void pbrtShape(const std::string &name, const ParamSet &params) {
         static_assert(MaxTransforms == 2,
                       "TransformCache assumes only two transforms");
         Transform *ObjToWorld[2] = {
-            transformCache.Lookup(curTransform[0]),
-            transformCache.Lookup(curTransform[1])
+            cache.Lookup(curTransform[0]),
+            cache.Lookup(curTransform[1])
         };
         AnimatedTransform animatedObjectToWorld(
             ObjToWorld[0], renderOptions->transformStartTime, ObjToWorld[1],
@@ -1448,12 +1520,13 @@ void pbrtPortal(const std::string &name, const ParamSet &params) {
             printf("\n");
         }
 
+        TransformCache &cache = ShapeTransformCache();
         if (!curTransform.IsAnimated()) {
             // Initialize _prims_ and _areaLights_ for static shape
 
             // Create shapes for shape _name_
-            Transform *ObjToWorld = transformCache.Lookup(curTransform[0]);
-            Transform *WorldToObj = transformCache.Lookup(Inverse(curTransform[0]));
+            Transform *ObjToWorld = cache.Lookup(curTransform[0]);
+            Transform *WorldToObj = cache.Lookup(Inverse(curTransform[0]));
             std::vector<std::shared_ptr<Shape>> shapes =
                     MakeShapes(name, ObjToWorld, WorldToObj,
                                graphicsState.reverseOrientation, params);
@@ -1481,7 +1554,7 @@ void pbrtPortal(const std::string &name, const ParamSet &params) {
                 Warning(
                         "Ignoring currently set area light when creating "
                         "animated shape");
-            Transform *identity = transformCache.Lookup(Transform());
+            Transform *identity = cache.Lookup(Transform());
             std::vector<std::shared_ptr<Shape>> shapes = MakeShapes(
                     name, identity, identity, graphicsState.reverseOrientation, params);
             if (shapes.empty()) return;
@@ -1501,8 +1574,8 @@ void pbrtPortal(const std::string &name, const ParamSet &params) {
             static_assert(MaxTransforms == 2,
                           "TransformCache assumes only two transforms");
             Transform *ObjToWorld[2] = {
-                    transformCache.Lookup(curTransform[0]),
-                    transformCache.Lookup(curTransform[1])
+                    cache.Lookup(curTransform[0]),
+                    cache.Lookup(curTransform[1])
             };
             AnimatedTransform animatedObjectToWorld(
                     ObjToWorld[0], renderOptions->transformStartTime, ObjToWorld[1],
@@ -1636,6 +1709,9 @@ void pbrtObjectBegin(const std::string &name) {
         Error("ObjectBegin called inside of instance definition");
     renderOptions->instances[name] = std::vector<std::shared_ptr<Primitive>>();
     renderOptions->currentInstance = &renderOptions->instances[name];
+    // Instances kept from an earlier frame ignore their shapes
+    renderOptions->currentInstanceResident =
+        multiFrameState && multiFrameState->instances.count(name) > 0;
     if (PbrtOptions.cat || PbrtOptions.toPly)
         printf("%*sObjectBegin \"%s\"\n", catIndentCount, "", name.c_str());
 }
@@ -1649,11 +1725,14 @@ void pbrtObjectEnd() {
     if (PbrtOptions.cat || PbrtOptions.toPly)
         printf("%*sObjectEnd\n", catIndentCount, "");
     renderOptions->currentInstance = nullptr;
+    renderOptions->currentInstanceResident = false;
     pbrtAttributeEnd();
     ++nObjectInstancesCreated;
 }
 
 STAT_COUNTER("Scene/Object instances used", nObjectInstancesUsed);
+STAT_COUNTER("Scene/Object instances used from earlier frames",
+             nResidentInstancesUsed);
 
 void pbrtObjectInstance(const std::string &name) {
     VERIFY_WORLD("ObjectInstance");
@@ -1667,6 +1746,16 @@ void pbrtObjectInstance(const std::string &name) {
         Error("ObjectInstance can't be called inside instance definition");
         return;
     }
+    if (multiFrameState && multiFrameState->instances.count(name)) {
+        // Place the aggregate built for _name_ in an earlier frame
+        ++nObjectInstancesUsed;
+        ++nResidentInstancesUsed;
+        renderOptions->primitives.push_back(multiFrameState->PlaceInstance(
+            multiFrameState->instances[name], curTransform,
+            renderOptions->transformStartTime,
+            renderOptions->transformEndTime));
+        return;
+    }
     if (renderOptions->instances.find(name) == renderOptions->instances.end()) {
         Error("Unable to find instance named \"%s\"", name.c_str());
         return;
@@ -1684,6 +1773,13 @@ void pbrtObjectInstance(const std::string &name) {
         in.clear();
         in.push_back(accel);
     }
+    if (multiFrameState) {
+        multiFrameState->instances[name] = in[0];
+        renderOptions->primitives.push_back(multiFrameState->PlaceInstance(
+            in[0], curTransform, renderOptions->transformStartTime,
+            renderOptions->transformEndTime));
+        return;
+    }
     static_assert(MaxTransforms == 2,
                   "TransformCache assumes only two transforms");
     // Create _animatedInstanceToWorld_ transform for instance
@@ -1760,10 +1856,40 @@ void pbrtWorldEnd() {
                                  namedCoordinateSystems.end());
 }
 
+STAT_COUNTER("Scene/Aggregates refit for a new frame", nFrameRefits);
+
 Scene *RenderOptions::MakeScene() {
-    std::shared_ptr<Primitive> accelerator =
-        MakeAccelerator(AcceleratorName, std::move(primitives), AcceleratorParams);
-    if (!accelerator) accelerator = std::make_shared<BVHAccel>(primitives);
+    std::shared_ptr<Primitive> accelerator;
+    if (multiFrameState && multiFrameState->accelerator &&
+        primitives == multiFrameState->primitives) {
+        // Only instance placements changed since the previous frame; refit
+        // its BVH unless that leaves it much worse than a rebuild would be
+        BVHAccel *bvh =
+            dynamic_cast<BVHAccel *>(multiFrameState->accelerator.get());
+        if (bvh && bvh->Refit() &&
+            bvh->SAHCost() <= 2 * multiFrameState->builtCost) {
+            accelerator = multiFrameState->accelerator;
+            ++nFrameRefits;
+        }
+    }
+    if (!accelerator) {
+        std::vector<std::shared_ptr<Primitive>> framePrimitives;
+        if (multiFrameState) framePrimitives = primitives;
+        accelerator = MakeAccelerator(AcceleratorName, std::move(primitives),
+                                      AcceleratorParams);
+        if (!accelerator) accelerator = std::make_shared<BVHAccel>(primitives);
+        if (multiFrameState) {
+            BVHAccel *bvh = dynamic_cast<BVHAccel *>(accelerator.get());
+            multiFrameState->accelerator = accelerator;
+            multiFrameState->primitives = std::move(framePrimitives);
+            multiFrameState->builtCost = bvh ? bvh->SAHCost() : 0;
+        }
+    }
+    if (multiFrameState) {
+        // This frame's placements are matched against the next frame's
+        multiFrameState->previousUses = std::move(multiFrameState->uses);
+        multiFrameState->uses.clear();
+    }
     Scene *scene = new Scene(accelerator, lights);
     // Erase primitives and lights from _RenderOptions_
     primitives.clear();
@@ -1793,12 +1919,19 @@ Integrator *RenderOptions::MakeIntegrator() const {
             CreateDirectLightingIntegrator(IntegratorParams, sampler, camera);
     else if (IntegratorName == "path")
         integrator = CreatePathIntegrator(IntegratorParams, sampler, camera);
+    else if (IntegratorName == "wavefrontpath")
+        integrator =
+            CreateWavefrontPathIntegrator(IntegratorParams, sampler, camera);
     else if (IntegratorName == "mypath")
         integrator = CreateMyPathIntegrator(IntegratorParams, sampler, camera);
     else if (IntegratorName == "hero_path")
         integrator = CreateHeroPathIntegrator(IntegratorParams, sampler, camera);
     else if (IntegratorName == "hero_path_mis")
         integrator = CreateHeroPathMISIntegrator(IntegratorParams, sampler, camera);
+    else if (IntegratorName == "hero_volpath")
+        integrator = CreateHeroVolPathIntegrator(IntegratorParams, sampler, camera);
+    else if (IntegratorName == "hero_bdpt")
+        integrator = CreateHeroBDPTIntegrator(IntegratorParams, sampler, camera);
     else if (IntegratorName == "volpath")
         integrator = CreateVolPathIntegrator(IntegratorParams, sampler, camera);
     else if (IntegratorName == "bdpt") {
@@ -1822,6 +1955,19 @@ Integrator *RenderOptions::MakeIntegrator() const {
             "\"mlt\".", IntegratorName.c_str());
     }
 
+    // Only the hero wavelength integrator tracks every wavelength through
+    // grid media with their own attenuation
+    if (IntegratorName != "hero_volpath") {
+        for (const auto &medium : namedMedia) {
+            const GridDensityMedium *grid =
+                dynamic_cast<const GridDensityMedium *>(medium.second.get());
+            if (grid && !grid->SpectrallyUniform())
+                Error(
+                    "GridDensityMedium requires a spectrally uniform "
+                    "attenuation coefficient!");
+        }
+    }
+
     IntegratorParams.ReportUnused();
     // Warn if no light sources are defined
     if (lights.empty())
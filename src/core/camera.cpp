@@ -61,12 +61,12 @@ Camera::Camera(const AnimatedTransform &CameraToWorld, Float shutterOpen,
 
 Float Camera::GenerateWvls(const CameraSample &sample, Ray *ray) const {
     // Draw initial wavelength sample
-    Vector4f wvls;
-    wvls.x = SampleUniformSpectrum(sample.wvl);
+    WvlPacketf wvls;
+    wvls[0] = SampleUniformSpectrum(sample.wvl);
 
     // Stratify samples across spectrum according to Hero Sampling (Wilkie et al., 2014)
-    for (int i = 1; i < 4; ++i) {
-        Float div = (Float)i / (Float)4;
+    for (int i = 1; i < nPacketWavelengths; ++i) {
+        Float div = (Float)i / (Float)nPacketWavelengths;
         wvls[i] = Mod(wvls[0] - (Float)sampledLambdaStart + div * (Float)sampledLambdaRange, 
                      (Float)sampledLambdaRange) + (Float)sampledLambdaStart;
     }
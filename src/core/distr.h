@@ -32,9 +32,16 @@ struct DiscreteDistribution {
     for (int i = 0; i < nEntries; ++i) {
       c[i + 1] = c[i] + f[i];
     }
-    Float invsum = 1.f / c[nEntries];
-    for (int i = 1; i < nEntries; ++i) {
-      c[i] *= invsum;
+    if (c[nEntries] <= 0.f) {
+      // Fall back to a uniform distribution if no entry carries weight
+      for (int i = 1; i < nEntries; ++i) {
+        c[i] = (Float) i / (Float) nEntries;
+      }
+    } else {
+      Float invsum = 1.f / c[nEntries];
+      for (int i = 1; i < nEntries; ++i) {
+        c[i] *= invsum;
+      }
     }
     c[nEntries] = 1.0f;
   }
@@ -88,7 +95,7 @@ struct SpectralDistribution : public DiscreteDistribution<nSpectralSamples> {
     Set(&(s[0]));
   }
 
-  inline Float sampleWavelength(Float sample1D, Float &pdf) {
+  inline Float sampleWavelength(Float sample1D, Float &pdf) const {
     const int i = Sample(sample1D, pdf);
     const Float minv = Cdf(i), 
                 maxv = Cdf(i + 1),
@@ -99,7 +106,7 @@ struct SpectralDistribution : public DiscreteDistribution<nSpectralSamples> {
          + sampledLambdaRange * ((alpha + (Float) i) / (Float) nSpectralSamples);
   }
 
-  inline Float sampleWavelength(Float sample1D) {
+  inline Float sampleWavelength(Float sample1D) const {
     const int i = Sample(sample1D);
     const Float minv = Cdf(i), 
                 maxv = Cdf(i + 1),
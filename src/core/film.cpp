@@ -35,6 +35,7 @@
 #include "film.h"
 #include "paramset.h"
 #include "imageio.h"
+#include "fileutil.h"
 #include "stats.h"
 
 namespace pbrt {
@@ -44,13 +45,16 @@ STAT_MEMORY_COUNTER("Memory/Film pixels", filmPixelMemory);
 // Film Method Definitions
 Film::Film(const Point2i &resolution, const Bounds2f &cropWindow,
            std::unique_ptr<Filter> filt, Float diagonal,
-           const std::string &filename, Float scale, Float maxSampleLuminance)
+           const std::string &filename, Float scale, Float maxSampleLuminance,
+           const std::string &spectralFilename, bool spectralHalf)
     : fullResolution(resolution),
       diagonal(diagonal * .001),
       filter(std::move(filt)),
       filename(filename),
       scale(scale),
-      maxSampleLuminance(maxSampleLuminance) {
+      maxSampleLuminance(maxSampleLuminance),
+      spectralFilename(spectralFilename),
+      spectralHalf(spectralHalf) {
     // Compute film image bounds
     croppedPixelBounds =
         Bounds2i(Point2i(std::ceil(fullResolution.x * cropWindow.pMin.x),
@@ -75,6 +79,31 @@ Film::Film(const Point2i &resolution, const Bounds2f &cropWindow,
             filterTable[offset] = filter->Evaluate(p);
         }
     }
+
+    if (!spectralFilename.empty()) OpenSpectralImage();
+}
+
+void Film::OpenSpectralImage() {
+    // Open spectral output; its tiles cover the sample bounds, so that they
+    // line up with the integrators' render tiles
+    std::vector<Float> wavelengths(Spectrum::nSamples);
+    for (int i = 0; i < Spectrum::nSamples; ++i)
+        wavelengths[i] = Lerp((i + 0.5f) / Spectrum::nSamples,
+                              sampledLambdaStart, sampledLambdaEnd);
+    spectralWriter.reset(new SpectralImageWriter(
+        spectralFilename, GetSampleBounds(), fullResolution, tileSize,
+        wavelengths, spectralHalf, scale));
+}
+
+void Film::BufferSpectralImage() {
+    if (spectralFilename.empty() || spectralSplats) return;
+    // Allocate per-pixel bins and sample counts and the splat sums over the
+    // sample bounds
+    int nPixels = GetSampleBounds().Area();
+    spectralBins.assign(nPixels * (Spectrum::nSamples + 1), 0);
+    spectralSplats.reset(new AtomicFloat[nPixels * Spectrum::nSamples]);
+    filmPixelMemory += nPixels * ((Spectrum::nSamples + 1) * sizeof(Float) +
+                                  Spectrum::nSamples * sizeof(AtomicFloat));
 }
 
 Bounds2i Film::GetSampleBounds() const {
@@ -102,7 +131,7 @@ std::unique_ptr<FilmTile> Film::GetFilmTile(const Bounds2i &sampleBounds) {
     Bounds2i tilePixelBounds = Intersect(Bounds2i(p0, p1), croppedPixelBounds);
     return std::unique_ptr<FilmTile>(new FilmTile(
         tilePixelBounds, filter->radius, filterTable, filterTableWidth,
-        maxSampleLuminance));
+        maxSampleLuminance, spectralWriter ? &sampleBounds : nullptr));
 }
 
 void Film::Clear() {
@@ -112,24 +141,53 @@ void Film::Clear() {
             pixel.splatXYZ[c] = pixel.xyz[c] = 0;
         pixel.filterWeightSum = 0;
     }
+    ClearSpectralImage();
+}
+
+void Film::ClearSpectralImage() {
+    if (!spectralSplats) return;
+    std::fill(spectralBins.begin(), spectralBins.end(), 0);
+    int nPixels = GetSampleBounds().Area();
+    for (int i = 0; i < nPixels * Spectrum::nSamples; ++i)
+        spectralSplats[i] = 0;
 }
 
 void Film::MergeFilmTile(std::unique_ptr<FilmTile> tile) {
     ProfilePhase p(Prof::MergeFilmTile);
     VLOG(1) << "Merging film tile " << tile->pixelBounds;
-    std::lock_guard<std::mutex> lock(mutex);
-    for (Point2i pixel : tile->GetPixelBounds()) {
-        // Merge _pixel_ into _Film::pixels_
-        const FilmTilePixel &tilePixel = tile->GetPixel(pixel);
-        Pixel &mergePixel = GetPixel(pixel);
-        Float xyz[3];
-        tilePixel.contribSum.ToXYZ(xyz);
-        for (int i = 0; i < 3; ++i) mergePixel.xyz[i] += xyz[i];
-        mergePixel.filterWeightSum += tilePixel.filterWeightSum;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Point2i pixel : tile->GetPixelBounds()) {
+            // Merge _pixel_ into _Film::pixels_
+            const FilmTilePixel &tilePixel = tile->GetPixel(pixel);
+            Pixel &mergePixel = GetPixel(pixel);
+            for (int i = 0; i < 3; ++i)
+                mergePixel.xyz[i] += tilePixel.contribXYZ[i];
+            mergePixel.filterWeightSum += tilePixel.filterWeightSum;
+        }
+
+        // Accumulate the tile's spectral bins if the image is buffered
+        if (spectralSplats && !tile->spectralBins.empty()) {
+            const int nBins = Spectrum::nSamples + 1;
+            const Float *tileBins = tile->spectralBins.data();
+            for (Point2i p : tile->spectralBounds) {
+                int offset = SpectralOffset(p);
+                if (offset >= 0)
+                    for (int i = 0; i < nBins; ++i)
+                        spectralBins[offset * nBins + i] += tileBins[i];
+                tileBins += nBins;
+            }
+        }
     }
+
+    // Otherwise stream the tile's spectral bins; they are final once the
+    // tile is done
+    if (spectralWriter && !spectralSplats && !tile->spectralBins.empty())
+        spectralWriter->WriteTile(tile->spectralBounds,
+                                  tile->spectralBins.data());
 }
 
-void Film::SetImage(const Spectrum *img) const {
+void Film::SetImage(const Spectrum *img) {
     int nPixels = croppedPixelBounds.Area();
     for (int i = 0; i < nPixels; ++i) {
         Pixel &p = pixels[i];
@@ -137,6 +195,22 @@ void Film::SetImage(const Spectrum *img) const {
         p.filterWeightSum = 1;
         p.splatXYZ[0] = p.splatXYZ[1] = p.splatXYZ[2] = 0;
     }
+
+    // Replace the buffered spectral image with _img_
+    if (spectralSplats) {
+        ClearSpectralImage();
+        const int nBins = Spectrum::nSamples + 1;
+        int i = 0;
+        for (Point2i p : croppedPixelBounds) {
+            int offset = SpectralOffset(p);
+            if (offset >= 0) {
+                for (int c = 0; c < Spectrum::nSamples; ++c)
+                    spectralBins[offset * nBins + c] = img[i][c];
+                spectralBins[offset * nBins + Spectrum::nSamples] = 1;
+            }
+            ++i;
+        }
+    }
 }
 
 void Film::AddSplat(const Point2f &p, Spectrum v) {
@@ -164,6 +238,49 @@ void Film::AddSplat(const Point2f &p, Spectrum v) {
     v.ToXYZ(xyz);
     Pixel &pixel = GetPixel(pi);
     for (int i = 0; i < 3; ++i) pixel.splatXYZ[i].Add(xyz[i]);
+    int offset = SpectralOffset(pi);
+    if (offset >= 0)
+        for (int i = 0; i < Spectrum::nSamples; ++i)
+            spectralSplats[offset * Spectrum::nSamples + i].Add(v[i]);
+}
+
+void Film::AddSplat(const Point2f &p, const WvlPacketf &wvls,
+                    const WvlPacketf &values, const WvlPacketf &pdfs) {
+    ProfilePhase pp(Prof::SplatFilm);
+
+    Float xyz[3];
+    WvlPacketToXYZ(wvls, values, pdfs, xyz);
+    if (std::isnan(xyz[0]) || std::isnan(xyz[1]) || std::isnan(xyz[2])) {
+        LOG(ERROR) << StringPrintf("Ignoring splatted packet with NaN values "
+                                   "at (%f, %f)", p.x, p.y);
+        return;
+    } else if (xyz[1] < 0.) {
+        LOG(ERROR) << StringPrintf("Ignoring splatted packet with negative "
+                                   "luminance %f at (%f, %f)", xyz[1], p.x, p.y);
+        return;
+    } else if (std::isinf(xyz[1])) {
+        LOG(ERROR) << StringPrintf("Ignoring splatted packet with infinite "
+                                   "luminance at (%f, %f)", p.x, p.y);
+        return;
+    }
+
+    Point2i pi = Point2i(Floor(p));
+    if (!InsideExclusive(pi, croppedPixelBounds)) return;
+    Float clampScale = xyz[1] > maxSampleLuminance ?
+                       maxSampleLuminance / xyz[1] : 1;
+    Pixel &pixel = GetPixel(pi);
+    for (int i = 0; i < 3; ++i) pixel.splatXYZ[i].Add(xyz[i] * clampScale);
+    int offset = SpectralOffset(pi);
+    if (offset >= 0) {
+        // Each wavelength estimates the average radiance of its bin
+        const Float binWidth = (sampledLambdaEnd - sampledLambdaStart) /
+                               (Float)Spectrum::nSamples;
+        for (int i = 0; i < wvls.nSamples; ++i)
+            if (pdfs[i] > 0)
+                spectralSplats[offset * Spectrum::nSamples +
+                               Spectrum::indexFromWavelength(wvls[i])]
+                    .Add(values[i] * clampScale / (pdfs[i] * binWidth));
+    }
 }
 
 void Film::WriteImage(Float splatScale) {
@@ -208,6 +325,43 @@ void Film::WriteImage(Float splatScale) {
     LOG(INFO) << "Writing image " << filename << " with bounds " <<
         croppedPixelBounds;
     pbrt::WriteImage(filename, &rgb[0], croppedPixelBounds, fullResolution);
+
+    // Write the buffered spectral image, or close the streamed one, whose
+    // tiles have all been written by now
+    if (spectralSplats) WriteSpectralImage(splatScale);
+    spectralWriter.reset();
+}
+
+void Film::WriteSpectralImage(Float splatScale) {
+    // Reopen the spectral image if an earlier _WriteImage()_ closed it
+    if (!spectralWriter) OpenSpectralImage();
+    const int nChannels = Spectrum::nSamples, nBins = nChannels + 1;
+    Bounds2i sampleBounds = GetSampleBounds();
+    std::vector<Float> tileBins(tileSize * tileSize * nBins);
+    for (int y0 = sampleBounds.pMin.y; y0 < sampleBounds.pMax.y;
+         y0 += tileSize) {
+        for (int x0 = sampleBounds.pMin.x; x0 < sampleBounds.pMax.x;
+             x0 += tileSize) {
+            Bounds2i tileBounds(
+                Point2i(x0, y0),
+                Point2i(std::min(x0 + tileSize, sampleBounds.pMax.x),
+                        std::min(y0 + tileSize, sampleBounds.pMax.y)));
+            // Add splats to the bins, which _WriteTile()_ divides by the
+            // pixel's sample count
+            Float *dst = tileBins.data();
+            for (Point2i p : tileBounds) {
+                int offset = SpectralOffset(p);
+                const Float *bins = &spectralBins[offset * nBins];
+                Float count = bins[nChannels] > 0 ? bins[nChannels] : 1;
+                const AtomicFloat *splats = &spectralSplats[offset * nChannels];
+                for (int c = 0; c < nChannels; ++c)
+                    dst[c] = bins[c] + splatScale * count * splats[c];
+                dst[nChannels] = count;
+                dst += nBins;
+            }
+            spectralWriter->WriteTile(tileBounds, tileBins.data());
+        }
+    }
 }
 
 Film *CreateFilm(const ParamSet &params, std::unique_ptr<Filter> filter) {
@@ -247,8 +401,23 @@ Film *CreateFilm(const ParamSet &params, std::unique_ptr<Filter> filter) {
     Float diagonal = params.FindOneFloat("diagonal", 35.);
     Float maxSampleLuminance = params.FindOneFloat("maxsampleluminance",
                                                    Infinity);
+    std::string spectralFilename = params.FindOneString("spectralfilename", "");
+    bool spectralHalf = params.FindOneBool("spectralhalf", false);
+#ifndef PBRT_SAMPLED_SPECTRUM
+    if (!spectralFilename.empty()) {
+        Warning("\"spectralfilename\" requires a build with sampled spectra. "
+                "Ignoring.");
+        spectralFilename = "";
+    }
+#endif
+    if (!spectralFilename.empty() && !HasExtension(spectralFilename, ".exr")) {
+        Warning("Spectral output \"%s\" must be an OpenEXR file. Ignoring.",
+                spectralFilename.c_str());
+        spectralFilename = "";
+    }
     return new Film(Point2i(xres, yres), crop, std::move(filter), diagonal,
-                    filename, scale, maxSampleLuminance);
+                    filename, scale, maxSampleLuminance, spectralFilename,
+                    spectralHalf);
 }
 
 }  // namespace pbrt
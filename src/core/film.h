@@ -45,31 +45,59 @@
 #include "filter.h"
 #include "stats.h"
 #include "parallel.h"
+#include "imageio.h"
 
 namespace pbrt {
 
 // FilmTilePixel Declarations
 struct FilmTilePixel {
-    Spectrum contribSum = 0.f;
+    FilmTilePixel() { contribXYZ[0] = contribXYZ[1] = contribXYZ[2] = 0; }
+    Float contribXYZ[3];
     Float filterWeightSum = 0.f;
 };
 
 // Film Declarations
+// Estimate the $XYZ$ coefficients of radiance _values_ carried at _wvls_,
+// which were sampled with densities _pdfs_
+inline void WvlPacketToXYZ(const WvlPacketf &wvls, const WvlPacketf &values,
+                           const WvlPacketf &pdfs, Float xyz[3]) {
+    xyz[0] = xyz[1] = xyz[2] = 0;
+    for (int i = 0; i < wvls.nSamples; ++i) {
+        if (pdfs[i] == 0 || values[i] == 0) continue;
+        Float cie[3];
+        CIEMatchingFunctions(wvls[i], cie);
+        Float v = values[i] / (pdfs[i] * CIE_Y_integral);
+        for (int j = 0; j < 3; ++j) xyz[j] += cie[j] * v;
+    }
+}
+
 class Film {
   public:
     // Film Public Methods
     Film(const Point2i &resolution, const Bounds2f &cropWindow,
          std::unique_ptr<Filter> filter, Float diagonal,
          const std::string &filename, Float scale,
-         Float maxSampleLuminance = Infinity);
+         Float maxSampleLuminance = Infinity,
+         const std::string &spectralFilename = "",
+         bool spectralHalf = false);
     Bounds2i GetSampleBounds() const;
     Bounds2f GetPhysicalExtent() const;
     std::unique_ptr<FilmTile> GetFilmTile(const Bounds2i &sampleBounds);
     void MergeFilmTile(std::unique_ptr<FilmTile> tile);
-    void SetImage(const Spectrum *img) const;
+    void SetImage(const Spectrum *img);
     void AddSplat(const Point2f &p, Spectrum v);
+    void AddSplat(const Point2f &p, const WvlPacketf &wvls,
+                  const WvlPacketf &values, const WvlPacketf &pdfs);
     void WriteImage(Float splatScale = 1);
     void Clear();
+    // Integrators that call _AddSplat()_ or _SetImage()_ call this before
+    // rendering; the spectral image is then kept in memory and written by
+    // _WriteImage()_ instead of being streamed as tiles are merged
+    void BufferSpectralImage();
+
+    // Side length of the render tiles that the integrators pass to
+    // _GetFilmTile()_; spectral output is written with the same tiling
+    static PBRT_CONSTEXPR int tileSize = 16;
 
     // Film Public Data
     const Point2i fullResolution;
@@ -93,6 +121,11 @@ class Film {
     std::mutex mutex;
     const Float scale;
     const Float maxSampleLuminance;
+    std::unique_ptr<SpectralImageWriter> spectralWriter;
+    const std::string spectralFilename;
+    const bool spectralHalf;
+    std::vector<Float> spectralBins;
+    std::unique_ptr<AtomicFloat[]> spectralSplats;
 
     // Film Private Methods
     Pixel &GetPixel(const Point2i &p) {
@@ -102,6 +135,18 @@ class Film {
                      (p.y - croppedPixelBounds.pMin.y) * width;
         return pixels[offset];
     }
+    void OpenSpectralImage();
+    void ClearSpectralImage();
+    void WriteSpectralImage(Float splatScale);
+    // Returns the offset of pixel _p_ in the buffered spectral image, or -1
+    // if it lies outside of it
+    int SpectralOffset(const Point2i &p) const {
+        Bounds2i sampleBounds = GetSampleBounds();
+        if (!spectralSplats || !InsideExclusive(p, sampleBounds)) return -1;
+        int width = sampleBounds.pMax.x - sampleBounds.pMin.x;
+        return (p.x - sampleBounds.pMin.x) +
+               (p.y - sampleBounds.pMin.y) * width;
+    }
 };
 
 class FilmTile {
@@ -109,7 +154,8 @@ class FilmTile {
     // FilmTile Public Methods
     FilmTile(const Bounds2i &pixelBounds, const Vector2f &filterRadius,
              const Float *filterTable, int filterTableSize,
-             Float maxSampleLuminance)
+             Float maxSampleLuminance,
+             const Bounds2i *spectralBounds = nullptr)
         : pixelBounds(pixelBounds),
           filterRadius(filterRadius),
           invFilterRadius(1 / filterRadius.x, 1 / filterRadius.y),
@@ -117,12 +163,89 @@ class FilmTile {
           filterTableSize(filterTableSize),
           maxSampleLuminance(maxSampleLuminance) {
         pixels = std::vector<FilmTilePixel>(std::max(0, pixelBounds.Area()));
+        if (spectralBounds) {
+            this->spectralBounds = *spectralBounds;
+            spectralBins = std::vector<Float>(
+                std::max(0, spectralBounds->Area()) * nSpectralChannels, 0.f);
+        }
     }
     void AddSample(const Point2f &pFilm, Spectrum L,
                    Float sampleWeight = 1.) {
         ProfilePhase _(Prof::AddFilmSample);
-        if (L.y() > maxSampleLuminance)
-            L *= maxSampleLuminance / L.y();
+        Float xyz[3];
+        L.ToXYZ(xyz);
+        sampleWeight *= LuminanceClampScale(xyz[1]);
+        AddXYZ(pFilm, xyz, sampleWeight);
+        if (Float *bins = GetSpectralBins(pFilm)) {
+            for (int i = 0; i < Spectrum::nSamples; ++i)
+                bins[i] += L[i] * sampleWeight;
+            bins[Spectrum::nSamples] += 1;
+        }
+    }
+    void AddSample(const Point2f &pFilm, const WvlPacketf &wvls,
+                   const WvlPacketf &values, const WvlPacketf &pdfs,
+                   Float sampleWeight = 1.) {
+        AddSample(pFilm, wvls, values, pdfs, Spectrum(0.f), sampleWeight);
+    }
+    // Adds one sample whose radiance is the packet estimate plus _L_, which
+    // holds the contributions known over the whole spectrum
+    void AddSample(const Point2f &pFilm, const WvlPacketf &wvls,
+                   const WvlPacketf &values, const WvlPacketf &pdfs,
+                   const Spectrum &L, Float sampleWeight = 1.) {
+        ProfilePhase _(Prof::AddFilmSample);
+        // Estimate the sample's $XYZ$ coefficients from its wavelengths
+        Float xyz[3], xyzL[3];
+        WvlPacketToXYZ(wvls, values, pdfs, xyz);
+        L.ToXYZ(xyzL);
+        for (int i = 0; i < 3; ++i) xyz[i] += xyzL[i];
+        sampleWeight *= LuminanceClampScale(xyz[1]);
+        AddXYZ(pFilm, xyz, sampleWeight);
+        if (Float *bins = GetSpectralBins(pFilm)) {
+            for (int i = 0; i < Spectrum::nSamples; ++i)
+                bins[i] += L[i] * sampleWeight;
+            // Each wavelength estimates the average radiance of its bin
+            const Float binWidth = (sampledLambdaEnd - sampledLambdaStart) /
+                                   (Float)Spectrum::nSamples;
+            for (int i = 0; i < wvls.nSamples; ++i)
+                if (pdfs[i] > 0)
+                    bins[Spectrum::indexFromWavelength(wvls[i])] +=
+                        values[i] * sampleWeight / (pdfs[i] * binWidth);
+            bins[Spectrum::nSamples] += 1;
+        }
+    }
+    FilmTilePixel &GetPixel(const Point2i &p) {
+        CHECK(InsideExclusive(p, pixelBounds));
+        int width = pixelBounds.pMax.x - pixelBounds.pMin.x;
+        int offset =
+            (p.x - pixelBounds.pMin.x) + (p.y - pixelBounds.pMin.y) * width;
+        return pixels[offset];
+    }
+    const FilmTilePixel &GetPixel(const Point2i &p) const {
+        CHECK(InsideExclusive(p, pixelBounds));
+        int width = pixelBounds.pMax.x - pixelBounds.pMin.x;
+        int offset =
+            (p.x - pixelBounds.pMin.x) + (p.y - pixelBounds.pMin.y) * width;
+        return pixels[offset];
+    }
+    Bounds2i GetPixelBounds() const { return pixelBounds; }
+
+  private:
+    // FilmTile Private Methods
+    Float LuminanceClampScale(Float y) const {
+        return y > maxSampleLuminance ? maxSampleLuminance / y : 1;
+    }
+    Float *GetSpectralBins(const Point2f &pFilm) {
+        // Spectral output is box filtered over the pixel containing the
+        // sample, so that every tile's pixels are final once it completes
+        Point2i p = (Point2i)Floor(pFilm);
+        if (spectralBins.empty() || !InsideExclusive(p, spectralBounds))
+            return nullptr;
+        int width = spectralBounds.pMax.x - spectralBounds.pMin.x;
+        int offset = (p.x - spectralBounds.pMin.x) +
+                     (p.y - spectralBounds.pMin.y) * width;
+        return &spectralBins[offset * nSpectralChannels];
+    }
+    void AddXYZ(const Point2f &pFilm, const Float xyz[3], Float sampleWeight) {
         // Compute sample's raster bounds
         Point2f pFilmDiscrete = pFilm - Vector2f(0.5f, 0.5f);
         Point2i p0 = (Point2i)Ceil(pFilmDiscrete - filterRadius);
@@ -154,28 +277,13 @@ class FilmTile {
 
                 // Update pixel values with filtered sample contribution
                 FilmTilePixel &pixel = GetPixel(Point2i(x, y));
-                pixel.contribSum += L * sampleWeight * filterWeight;
+                Float w = sampleWeight * filterWeight;
+                for (int i = 0; i < 3; ++i) pixel.contribXYZ[i] += xyz[i] * w;
                 pixel.filterWeightSum += filterWeight;
             }
         }
     }
-    FilmTilePixel &GetPixel(const Point2i &p) {
-        CHECK(InsideExclusive(p, pixelBounds));
-        int width = pixelBounds.pMax.x - pixelBounds.pMin.x;
-        int offset =
-            (p.x - pixelBounds.pMin.x) + (p.y - pixelBounds.pMin.y) * width;
-        return pixels[offset];
-    }
-    const FilmTilePixel &GetPixel(const Point2i &p) const {
-        CHECK(InsideExclusive(p, pixelBounds));
-        int width = pixelBounds.pMax.x - pixelBounds.pMin.x;
-        int offset =
-            (p.x - pixelBounds.pMin.x) + (p.y - pixelBounds.pMin.y) * width;
-        return pixels[offset];
-    }
-    Bounds2i GetPixelBounds() const { return pixelBounds; }
 
-  private:
     // FilmTile Private Data
     const Bounds2i pixelBounds;
     const Vector2f filterRadius, invFilterRadius;
@@ -183,6 +291,10 @@ class FilmTile {
     const int filterTableSize;
     std::vector<FilmTilePixel> pixels;
     const Float maxSampleLuminance;
+    // Per-pixel spectral bins followed by the pixel's sample count
+    static PBRT_CONSTEXPR int nSpectralChannels = Spectrum::nSamples + 1;
+    Bounds2i spectralBounds;
+    std::vector<Float> spectralBins;
     friend class Film;
 };
 
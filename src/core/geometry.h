@@ -433,6 +433,134 @@ typedef Vector3<int> Vector3i;
 typedef Vector4<Float> Vector4f;
 typedef Vector4<int> Vector4i;
 
+// Packet Declarations
+template <typename T, int nPacketSamples>
+class Packet {
+  public:
+    // Packet Public Methods
+    Packet() {
+        for (int i = 0; i < nPacketSamples; ++i) c[i] = 0;
+    }
+    Packet(T v) {
+        for (int i = 0; i < nPacketSamples; ++i) c[i] = v;
+        DCHECK(!HasNaNs());
+    }
+    bool HasNaNs() const {
+        for (int i = 0; i < nPacketSamples; ++i)
+            if (isNaN(c[i])) return true;
+        return false;
+    }
+    T operator[](int i) const {
+        DCHECK(i >= 0 && i < nPacketSamples);
+        return c[i];
+    }
+    T &operator[](int i) {
+        DCHECK(i >= 0 && i < nPacketSamples);
+        return c[i];
+    }
+    Packet operator+(const Packet &p) const {
+        DCHECK(!p.HasNaNs());
+        Packet ret = *this;
+        for (int i = 0; i < nPacketSamples; ++i) ret.c[i] += p.c[i];
+        return ret;
+    }
+    Packet &operator+=(const Packet &p) {
+        DCHECK(!p.HasNaNs());
+        for (int i = 0; i < nPacketSamples; ++i) c[i] += p.c[i];
+        return *this;
+    }
+    Packet operator-(const Packet &p) const {
+        DCHECK(!p.HasNaNs());
+        Packet ret = *this;
+        for (int i = 0; i < nPacketSamples; ++i) ret.c[i] -= p.c[i];
+        return ret;
+    }
+    Packet &operator-=(const Packet &p) {
+        DCHECK(!p.HasNaNs());
+        for (int i = 0; i < nPacketSamples; ++i) c[i] -= p.c[i];
+        return *this;
+    }
+    Packet operator*(const Packet &p) const {
+        DCHECK(!p.HasNaNs());
+        Packet ret = *this;
+        for (int i = 0; i < nPacketSamples; ++i) ret.c[i] *= p.c[i];
+        return ret;
+    }
+    Packet &operator*=(const Packet &p) {
+        DCHECK(!p.HasNaNs());
+        for (int i = 0; i < nPacketSamples; ++i) c[i] *= p.c[i];
+        return *this;
+    }
+    Packet operator/(const Packet &p) const {
+        DCHECK(!p.HasNaNs());
+        Packet ret = *this;
+        for (int i = 0; i < nPacketSamples; ++i) ret.c[i] /= p.c[i];
+        return ret;
+    }
+    Packet &operator/=(const Packet &p) {
+        DCHECK(!p.HasNaNs());
+        for (int i = 0; i < nPacketSamples; ++i) c[i] /= p.c[i];
+        return *this;
+    }
+    template <typename U>
+    Packet operator*(U s) const {
+        Packet ret = *this;
+        for (int i = 0; i < nPacketSamples; ++i) ret.c[i] *= s;
+        return ret;
+    }
+    template <typename U>
+    Packet &operator*=(U s) {
+        DCHECK(!isNaN(s));
+        for (int i = 0; i < nPacketSamples; ++i) c[i] *= s;
+        return *this;
+    }
+    template <typename U>
+    Packet operator/(U f) const {
+        CHECK_NE(f, 0);
+        Float inv = (Float)1 / f;
+        Packet ret = *this;
+        for (int i = 0; i < nPacketSamples; ++i) ret.c[i] *= inv;
+        return ret;
+    }
+    template <typename U>
+    Packet &operator/=(U f) {
+        CHECK_NE(f, 0);
+        Float inv = (Float)1 / f;
+        for (int i = 0; i < nPacketSamples; ++i) c[i] *= inv;
+        return *this;
+    }
+    Packet operator-() const {
+        Packet ret;
+        for (int i = 0; i < nPacketSamples; ++i) ret.c[i] = -c[i];
+        return ret;
+    }
+    bool operator==(const Packet &p) const {
+        for (int i = 0; i < nPacketSamples; ++i)
+            if (c[i] != p.c[i]) return false;
+        return true;
+    }
+    bool operator!=(const Packet &p) const { return !(*this == p); }
+
+    // Packet Public Data
+    static const int nSamples = nPacketSamples;
+
+  private:
+    // Packet Private Data
+    T c[nPacketSamples];
+};
+
+template <typename T, int nPacketSamples>
+inline std::ostream &operator<<(std::ostream &os,
+                                const Packet<T, nPacketSamples> &p) {
+    os << "[ ";
+    for (int i = 0; i < nPacketSamples; ++i) {
+        os << p[i];
+        if (i + 1 < nPacketSamples) os << ", ";
+    }
+    os << " ]";
+    return os;
+}
+
 // Point Declarations
 template <typename T>
 class Point2 {
@@ -1020,8 +1148,8 @@ class Bounds2iIterator : public std::forward_iterator_tag {
 class Ray {
   public:
     // Ray Public Methods
-    Ray() : tMax(Infinity), time(0.f), wvls(Vector4f(0.f)), medium(nullptr) {}
-    Ray(const Point3f &o, const Vector3f &d, const Vector4f &wvls, 
+    Ray() : tMax(Infinity), time(0.f), wvls(WvlPacketf(0.f)), medium(nullptr) {}
+    Ray(const Point3f &o, const Vector3f &d, const WvlPacketf &wvls, 
         Float tMax = Infinity, Float time = 0.f, 
         const Medium *medium = nullptr)
         : o(o), d(d), wvls(wvls), tMax(tMax), time(time), medium(medium) {}
@@ -1036,7 +1164,7 @@ class Ray {
     // Ray Public Data
     Point3f o;
     Vector3f d;
-    Vector4f wvls;
+    WvlPacketf wvls;
     mutable Float tMax;
     Float time;
     const Medium *medium;
@@ -1046,7 +1174,7 @@ class RayDifferential : public Ray {
   public:
     // RayDifferential Public Methods
     RayDifferential() { hasDifferentials = false; }
-    RayDifferential(const Point3f &o, const Vector3f &d, const Vector4f &wvls, 
+    RayDifferential(const Point3f &o, const Vector3f &d, const WvlPacketf &wvls, 
                     Float tMax = Infinity, Float time = 0.f, const Medium *medium = nullptr)
         : Ray(o, d, wvls, tMax, time, medium) {
         hasDifferentials = false;
@@ -1397,6 +1525,13 @@ inline Float Sum(const Vector4<T> &v) {
     return v[0] + v[1] + v[2] + v[3];
 }
 
+template <typename T, int nPacketSamples>
+inline Float Sum(const Packet<T, nPacketSamples> &p) {
+    Float sum = 0;
+    for (int i = 0; i < nPacketSamples; ++i) sum += p[i];
+    return sum;
+}
+
 template <typename T>
 Normal3<T> Abs(const Normal3<T> &v) {
     return Normal3<T>(std::abs(v.x), std::abs(v.y), std::abs(v.z));
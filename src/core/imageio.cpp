@@ -37,8 +37,13 @@
 #include "fileutil.h"
 #include "spectrum.h"
 
+#include <ImfChannelList.h>
+#include <ImfFrameBuffer.h>
+#include <ImfHeader.h>
 #include <ImfRgba.h>
 #include <ImfRgbaFile.h>
+#include <ImfTiledOutputFile.h>
+#include <half.h>
 
 namespace pbrt {
 
@@ -188,6 +193,117 @@ static void WriteImageEXR(const std::string &name, const Float *pixels,
     delete[] hrgba;
 }
 
+// SpectralImageWriter Method Definitions
+struct SpectralImageWriter::File {
+    File(const std::string &name, const Imf::Header &header)
+        : out(name.c_str(), header) {}
+    Imf::TiledOutputFile out;
+    std::vector<std::string> channels;
+};
+
+SpectralImageWriter::SpectralImageWriter(const std::string &name,
+                                         const Bounds2i &dataWindow,
+                                         const Point2i &totalResolution,
+                                         int tileSize,
+                                         const std::vector<Float> &wavelengths,
+                                         bool halfPrecision, Float scale)
+    : name(name),
+      dataWindow(dataWindow),
+      tileSize(tileSize),
+      nChannels(wavelengths.size()),
+      halfPrecision(halfPrecision),
+      scale(scale) {
+    using namespace Imf;
+    using namespace Imath;
+
+    // OpenEXR uses inclusive pixel bounds.
+    Box2i displayBox(V2i(0, 0),
+                     V2i(totalResolution.x - 1, totalResolution.y - 1));
+    Box2i dataBox(V2i(dataWindow.pMin.x, dataWindow.pMin.y),
+                  V2i(dataWindow.pMax.x - 1, dataWindow.pMax.y - 1));
+    Header header(displayBox, dataBox);
+    header.setTileDescription(TileDescription(tileSize, tileSize, ONE_LEVEL));
+    // Tiles are written in the order they finish rendering; any other line
+    // order would make OpenEXR buffer them until they could be written in
+    // sequence
+    header.lineOrder() = RANDOM_Y;
+
+    // Name channels after the emissive spectral EXR convention,
+    // e.g. "S0.402,50nm"
+    std::vector<std::string> channels;
+    for (Float lambda : wavelengths) {
+        int hundredths = (int)std::round(lambda * 100);
+        channels.push_back(StringPrintf("S0.%d,%02dnm", hundredths / 100,
+                                        hundredths % 100));
+        header.channels().insert(channels.back(),
+                                 Channel(halfPrecision ? HALF : FLOAT));
+    }
+
+    try {
+        file.reset(new File(name, header));
+        file->channels = std::move(channels);
+    } catch (const std::exception &exc) {
+        Error("Error writing \"%s\": %s", name.c_str(), exc.what());
+    }
+}
+
+SpectralImageWriter::~SpectralImageWriter() {
+    // Closing the file writes its tile offset table
+    if (file) {
+        file.reset();
+        LOG(INFO) << "Wrote spectral image " << name;
+    }
+}
+
+void SpectralImageWriter::WriteTile(const Bounds2i &tileBounds,
+                                    const Float *bins) {
+    using namespace Imf;
+    if (!file || tileBounds.Area() <= 0) return;
+    CHECK_EQ((tileBounds.pMin.x - dataWindow.pMin.x) % tileSize, 0);
+    CHECK_EQ((tileBounds.pMin.y - dataWindow.pMin.y) % tileSize, 0);
+
+    // Normalize the tile's bins by their sample counts
+    int width = tileBounds.pMax.x - tileBounds.pMin.x;
+    int nPixels = tileBounds.Area();
+    std::vector<float> floatPixels(halfPrecision ? 0 : nPixels * nChannels);
+    std::vector<half> halfPixels(halfPrecision ? nPixels * nChannels : 0);
+    for (int i = 0; i < nPixels; ++i) {
+        const Float *pixelBins = &bins[i * (nChannels + 1)];
+        Float count = pixelBins[nChannels];
+        Float invCount = count > 0 ? scale / count : 0;
+        for (int c = 0; c < nChannels; ++c) {
+            Float v = std::max((Float)0, pixelBins[c] * invCount);
+            if (halfPrecision)
+                halfPixels[i * nChannels + c] = half(v);
+            else
+                floatPixels[i * nChannels + c] = v;
+        }
+    }
+
+    // Describe the tile's interleaved channels relative to the data window
+    size_t channelSize = halfPrecision ? sizeof(half) : sizeof(float);
+    char *base = halfPrecision ? (char *)halfPixels.data()
+                               : (char *)floatPixels.data();
+    base -= (tileBounds.pMin.x + tileBounds.pMin.y * width) * nChannels *
+            channelSize;
+    FrameBuffer frameBuffer;
+    for (int c = 0; c < nChannels; ++c)
+        frameBuffer.insert(file->channels[c],
+                           Slice(halfPrecision ? HALF : FLOAT,
+                                 base + c * channelSize,
+                                 nChannels * channelSize,
+                                 width * nChannels * channelSize));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    try {
+        file->out.setFrameBuffer(frameBuffer);
+        file->out.writeTile((tileBounds.pMin.x - dataWindow.pMin.x) / tileSize,
+                            (tileBounds.pMin.y - dataWindow.pMin.y) / tileSize);
+    } catch (const std::exception &exc) {
+        Error("Error writing tile to \"%s\": %s", name.c_str(), exc.what());
+    }
+}
+
 // TGA Function Definitions
 void WriteImageTGA(const std::string &name, const uint8_t *pixels, int xRes,
                    int yRes, int totalXRes, int totalYRes, int xOffset,
@@ -42,6 +42,8 @@
 #include "pbrt.h"
 #include "geometry.h"
 #include <cctype>
+#include <mutex>
+#include <vector>
 
 namespace pbrt {
 
@@ -55,6 +57,33 @@ RGBSpectrum *ReadImageEXR(const std::string &name, int *width,
 void WriteImage(const std::string &name, const Float *rgb,
                 const Bounds2i &outputBounds, const Point2i &totalResolution);
 
+// SpectralImageWriter Declarations
+class SpectralImageWriter {
+  public:
+    // SpectralImageWriter Public Methods
+    SpectralImageWriter(const std::string &name, const Bounds2i &dataWindow,
+                        const Point2i &totalResolution, int tileSize,
+                        const std::vector<Float> &wavelengths,
+                        bool halfPrecision, Float scale);
+    ~SpectralImageWriter();
+    // Writes the tile starting at _tileBounds.pMin_; _bins_ holds, per pixel
+    // in scanline order, the summed value of every channel followed by the
+    // pixel's sample count
+    void WriteTile(const Bounds2i &tileBounds, const Float *bins);
+
+  private:
+    // SpectralImageWriter Private Data
+    struct File;
+    std::unique_ptr<File> file;
+    const std::string name;
+    const Bounds2i dataWindow;
+    const int tileSize;
+    const int nChannels;
+    const bool halfPrecision;
+    const Float scale;
+    std::mutex mutex;
+};
+
 }  // namespace pbrt
 
 #endif  // PBRT_CORE_IMAGEIO_H
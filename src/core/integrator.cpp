@@ -50,6 +50,8 @@
 namespace pbrt {
 
 STAT_COUNTER("Integrator/Camera rays traced", nCameraRays);
+STAT_RATIO("Integrator/Rays traced per thread-microsecond", nTileRays,
+           nTileMicroseconds);
 
 STAT_PERCENT("AAPortal/generic%", genericNum, genericDen);
 STAT_PERCENT("AAPortal/occluded Li samples", occludedNum, occludedDen);
@@ -530,13 +532,15 @@ void SamplerIntegrator::Render(const Scene &scene) {
     // Compute number of tiles, _nTiles_, to use for parallel rendering
     Bounds2i sampleBounds = camera->film->GetSampleBounds();
     Vector2i sampleExtent = sampleBounds.Diagonal();
-    const int tileSize = 16;
+    const int tileSize = Film::tileSize;
     Point2i nTiles((sampleExtent.x + tileSize - 1) / tileSize,
                    (sampleExtent.y + tileSize - 1) / tileSize);
     ProgressReporter reporter(nTiles.x * nTiles.y, "Rendering");
     {
         ParallelFor2D([&](Point2i tile) {
             // Render section of image corresponding to _tile_
+            auto tileStart = std::chrono::steady_clock::now();
+            int64_t tileRaysStart = Scene::ThreadRaysTraced();
 
             // Allocate _MemoryArena_ for tile
             MemoryArena arena;
@@ -624,6 +628,14 @@ void SamplerIntegrator::Render(const Scene &scene) {
             }
             LOG(INFO) << "Finished image tile " << tileBounds;
 
+            // Record the tile's ray throughput
+            nTileRays += std::max<int64_t>(
+                0, Scene::ThreadRaysTraced() - tileRaysStart);
+            nTileMicroseconds +=
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - tileStart)
+                    .count();
+
             // Merge image tile into _Film_
             camera->film->MergeFilmTile(std::move(filmTile));
             reporter.Update();
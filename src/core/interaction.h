@@ -52,7 +52,7 @@ struct Interaction {
     // Interaction Public Methods
     Interaction() : time(0), isWvlDependent(false) {}
     Interaction(const Point3f &p, const Normal3f &n, const Vector3f &pError,
-                const Vector3f &wo, const Vector4f &wvls, Float time,
+                const Vector3f &wo, const WvlPacketf &wvls, Float time,
                 const MediumInterface &mediumInterface)
         : p(p),
           time(time),
@@ -78,12 +78,21 @@ struct Interaction {
         Vector3f d = target - origin;
         return Ray(origin, d, wvls, 1 - ShadowEpsilon, time, GetMedium(d));
     }
-    Interaction(const Point3f &p, const Vector3f &wo, const Vector4f &wvls, Float time,
+    Interaction(const Point3f &p, const Vector3f &wo, const WvlPacketf &wvls, Float time,
                 const MediumInterface &mediumInterface)
-        : p(p), time(time), wo(wo), mediumInterface(mediumInterface) {}
-    Interaction(const Point3f &p, const Vector4f &wvls, Float time,
+        : p(p),
+          time(time),
+          wo(wo),
+          wvls(wvls),
+          mediumInterface(mediumInterface),
+          isWvlDependent(false) {}
+    Interaction(const Point3f &p, const WvlPacketf &wvls, Float time,
                 const MediumInterface &mediumInterface)
-        : p(p), time(time), mediumInterface(mediumInterface) {}
+        : p(p),
+          time(time),
+          wvls(wvls),
+          mediumInterface(mediumInterface),
+          isWvlDependent(false) {}
     bool IsMediumInteraction() const { return !IsSurfaceInteraction(); }
     bool IsWvlDependentInteraction() const { return isWvlDependent; }
     const Medium *GetMedium(const Vector3f &w) const {
@@ -99,7 +108,7 @@ struct Interaction {
     Float time;
     Vector3f pError;
     Vector3f wo;
-    Vector4f wvls;
+    WvlPacketf wvls;
     Normal3f n;
     MediumInterface mediumInterface;
     bool isWvlDependent;
@@ -109,7 +118,7 @@ class MediumInteraction : public Interaction {
   public:
     // MediumInteraction Public Methods
     MediumInteraction() : phase(nullptr) {}
-    MediumInteraction(const Point3f &p, const Vector3f &wo, const Vector4f &wvls, Float time,
+    MediumInteraction(const Point3f &p, const Vector3f &wo, const WvlPacketf &wvls, Float time,
                       const Medium *medium, const PhaseFunction *phase)
         : Interaction(p, wo, wvls, time, medium), phase(phase) {}
     bool IsValid() const { return phase != nullptr; }
@@ -127,7 +136,7 @@ class SurfaceInteraction : public Interaction {
                        const Point2f &uv, const Vector3f &wo,
                        const Vector3f &dpdu, const Vector3f &dpdv,
                        const Normal3f &dndu, const Normal3f &dndv, 
-                       const Vector4f &wvls, Float time,
+                       const WvlPacketf &wvls, Float time,
                        const Shape *sh,
                        int faceIndex = 0);
     void SetShadingGeometry(const Vector3f &dpdu, const Vector3f &dpdv,
@@ -80,6 +80,27 @@ Spectrum VisibilityTester::Tr(const Scene &scene, Sampler &sampler) const {
     return Tr;
 }
 
+WvlPacketf VisibilityTester::TrWvls(const Scene &scene,
+                                    Sampler &sampler) const {
+    Ray ray(p0.SpawnRayTo(p1));
+    WvlPacketf Tr(1.f);
+    while (true) {
+        SurfaceInteraction isect;
+        bool hitSurface = scene.Intersect(ray, &isect);
+        // Handle opaque surface along ray's path
+        if (hitSurface && isect.primitive->GetMaterial() != nullptr)
+            return WvlPacketf(0.f);
+
+        // Update transmittance of the packet wavelengths for current segment
+        if (ray.medium) Tr *= ray.medium->TrWvls(ray, sampler);
+
+        // Generate next ray segment or return final transmittance
+        if (!hitSurface) break;
+        ray = isect.SpawnRayTo(p1);
+    }
+    return Tr;
+}
+
 Spectrum Light::Le(const RayDifferential &ray) const { return Spectrum(0.f); }
 
 AreaLight::AreaLight(const Transform &LightToWorld, const MediumInterface &medium,
@@ -95,6 +95,8 @@ class Light {
     const int flags;
     const int nSamples;
     const MediumInterface mediumInterface;
+    // Index of the light in its _Scene_'s _lights_, assigned by the _Scene_
+    int sceneIndex = -1;
 
   protected:
     // Light Protected Data
@@ -111,6 +113,7 @@ class VisibilityTester {
     const Interaction &P1() const { return p1; }
     bool Unoccluded(const Scene &scene) const;
     Spectrum Tr(const Scene &scene, Sampler &sampler) const;
+    WvlPacketf TrWvls(const Scene &scene, Sampler &sampler) const;
 
   private:
     Interaction p0, p1;
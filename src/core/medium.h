@@ -71,6 +71,14 @@ inline Float PhaseHG(Float cosTheta, Float g) {
     return Inv4Pi * (1 - g * g) / (denom * std::sqrt(denom));
 }
 
+// Values of _s_ in the bins of a wavelength packet
+inline WvlPacketf SpectrumAtWvls(const Spectrum &s, const WvlPacketf &wvls) {
+    WvlPacketf v;
+    for (int i = 0; i < wvls.nSamples; ++i)
+        v[i] = s[Spectrum::indexFromWavelength(wvls[i])];
+    return v;
+}
+
 // Medium Declarations
 class Medium {
   public:
@@ -80,6 +88,16 @@ class Medium {
     virtual Spectrum Sample(const Ray &ray, Sampler &sampler,
                             MemoryArena &arena,
                             MediumInteraction *mi) const = 0;
+
+    // Hero wavelength variants, evaluated for the wavelengths of _ray_. A
+    // single distance sample, driven by the hero wavelength, is shared by
+    // the packet; _SampleWvls()_ returns the per-wavelength throughput and
+    // stores the density with which each wavelength would have generated
+    // the same sample in _wvlPdf_
+    virtual WvlPacketf TrWvls(const Ray &ray, Sampler &sampler) const = 0;
+    virtual WvlPacketf SampleWvls(const Ray &ray, Sampler &sampler,
+                                  MemoryArena &arena, MediumInteraction *mi,
+                                  WvlPacketf *wvlPdf) const = 0;
 };
 
 // HenyeyGreenstein Declarations
@@ -35,28 +35,22 @@
 #include "parallel.h"
 #include "memory.h"
 #include "stats.h"
+#include <fstream>
 #include <list>
+#include <sstream>
 #include <thread>
 #include <condition_variable>
+#ifdef PBRT_HAVE_PTHREAD_AFFINITY
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace pbrt {
 
+STAT_COUNTER("Parallel/Tasks stolen", nTasksStolen);
+
 // Parallel Local Definitions
 static std::vector<std::thread> threads;
-static bool shutdownThreads = false;
-class ParallelForLoop;
-static ParallelForLoop *workList = nullptr;
-static std::mutex workListMutex;
-
-// Bookkeeping variables to help with the implementation of
-// MergeWorkerThreadStats().
-static std::atomic<bool> reportWorkerStats{false};
-// Number of workers that still need to report their stats.
-static std::atomic<int> reporterCount;
-// After kicking the workers to report their stats, the main thread waits
-// on this condition variable until they've all done so.
-static std::condition_variable reportDoneCondition;
-static std::mutex reportDoneMutex;
 
 class ParallelForLoop {
   public:
@@ -66,13 +60,15 @@ class ParallelForLoop {
         : func1D(std::move(func1D)),
           maxIndex(maxIndex),
           chunkSize(chunkSize),
-          profilerState(profilerState) {}
+          profilerState(profilerState),
+          chunksRemaining((maxIndex + chunkSize - 1) / chunkSize) {}
     ParallelForLoop(const std::function<void(Point2i)> &f, const Point2i &count,
                     uint64_t profilerState)
         : func2D(f),
           maxIndex(count.x * count.y),
           chunkSize(1),
-          profilerState(profilerState) {
+          profilerState(profilerState),
+          chunksRemaining(maxIndex) {
         nX = count.x;
     }
 
@@ -83,17 +79,268 @@ class ParallelForLoop {
     const int64_t maxIndex;
     const int chunkSize;
     uint64_t profilerState;
-    int64_t nextIndex = 0;
-    int activeWorkers = 0;
-    ParallelForLoop *next = nullptr;
     int nX = -1;
+    // The loop is finished once this reaches zero; its owner may return
+    // and destroy it right after
+    std::atomic<int64_t> chunksRemaining;
+};
+
+// A range of chunks of a _ParallelForLoop_ still to be run
+struct ParallelTask {
+    ParallelForLoop *loop;
+    int64_t chunkStart, chunkEnd;
+};
 
-    // ParallelForLoop Private Methods
-    bool Finished() const {
-        return nextIndex >= maxIndex && activeWorkers == 0;
+// Fixed-capacity Chase-Lev deque: its owning thread pushes and pops tasks
+// at the bottom while other threads steal from the top, all without locks
+class WorkQueue {
+  public:
+    // WorkQueue Public Methods
+    bool Push(const ParallelTask &task) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        if (b - t >= Capacity) return false;
+        Slot &slot = slots[b & (Capacity - 1)];
+        slot.loop.store(task.loop, std::memory_order_relaxed);
+        slot.chunkStart.store(task.chunkStart, std::memory_order_relaxed);
+        slot.chunkEnd.store(task.chunkEnd, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_release);
+        return true;
+    }
+    bool Pop(ParallelTask *task) {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        Read(b, task);
+        if (t < b) return true;
+        // Race any thieves for the last task
+        bool won = top.compare_exchange_strong(
+            t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return won;
     }
+    bool HasTasks() const { return top.load() < bottom.load(); }
+    bool Steal(ParallelTask *task) {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) return false;
+        // A torn read is harmless: the task is discarded if the CAS fails
+        Read(t, task);
+        return top.compare_exchange_strong(
+            t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+  private:
+    // WorkQueue Private Methods
+    void Read(int64_t index, ParallelTask *task) const {
+        const Slot &slot = slots[index & (Capacity - 1)];
+        task->loop = slot.loop.load(std::memory_order_relaxed);
+        task->chunkStart = slot.chunkStart.load(std::memory_order_relaxed);
+        task->chunkEnd = slot.chunkEnd.load(std::memory_order_relaxed);
+    }
+
+    // WorkQueue Private Data
+    // Tasks are split in halves, so a thread's queue holds about log2 of
+    // its loops' chunk counts; a full queue runs the task inline instead
+    static PBRT_CONSTEXPR int64_t Capacity = 1024;
+    struct Slot {
+        std::atomic<ParallelForLoop *> loop;
+        std::atomic<int64_t> chunkStart, chunkEnd;
+    };
+    std::atomic<int64_t> top{0};
+    char topPadding[PBRT_L1_CACHE_LINE_SIZE];
+    std::atomic<int64_t> bottom{0};
+    char bottomPadding[PBRT_L1_CACHE_LINE_SIZE];
+    Slot slots[Capacity];
 };
 
+// One queue per thread, indexed by _ThreadIndex_; the main thread uses 0
+static std::unique_ptr<WorkQueue[]> workQueues;
+static int nWorkQueues = 0;
+static PBRT_THREAD_LOCAL int nextVictim = 0;
+
+// Idle workers sleep on _workerCondition_; pushing a task only takes
+// _workerMutex_ to wake them if one is asleep
+static std::atomic<int> nSleepingWorkers{0};
+static std::mutex workerMutex;
+static std::condition_variable workerCondition;
+static bool shutdownThreads = false;
+
+// CPU and NUMA node for each thread index when threads are pinned
+static std::vector<std::pair<int, int>> threadCpus;
+
+// Bookkeeping variables to help with the implementation of
+// MergeWorkerThreadStats(), guarded by _workerMutex_.
+// Incremented each time the main thread asks for stats.
+static int statsEpoch = 0;
+// Number of workers that still need to report their stats.
+static int reporterCount = 0;
+// After kicking the workers to report their stats, the main thread waits
+// on this condition variable until they've all done so.
+static std::condition_variable reportDoneCondition;
+
+// Parses a Linux CPU or node list such as "0-3,8-11"
+static std::vector<int> ParseIdList(const std::string &list) {
+    std::vector<int> ids;
+    std::istringstream in(list);
+    std::string range;
+    while (std::getline(in, range, ',')) {
+        if (range.empty()) continue;
+        size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos
+                       ? first
+                       : std::stoi(range.substr(dash + 1));
+        for (int id = first; id <= last; ++id) ids.push_back(id);
+    }
+    return ids;
+}
+
+// Returns the CPUs of each NUMA node that has any; systems where the
+// topology isn't available are treated as a single node
+static std::vector<std::vector<int>> ReadNumaTopology() {
+    std::vector<std::vector<int>> topology;
+#ifdef PBRT_HAVE_PTHREAD_AFFINITY
+    // Only use CPUs that the process may run on
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) CPU_SET(cpu, &allowed);
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string nodeList;
+    if (online && std::getline(online, nodeList)) {
+        for (int node : ParseIdList(nodeList)) {
+            std::ifstream in("/sys/devices/system/node/node" +
+                             std::to_string(node) + "/cpulist");
+            std::string cpuList;
+            if (!in || !std::getline(in, cpuList)) continue;
+            std::vector<int> cpus;
+            for (int cpu : ParseIdList(cpuList))
+                if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+                    cpus.push_back(cpu);
+            if (!cpus.empty()) topology.push_back(std::move(cpus));
+        }
+    }
+#endif
+    if (topology.empty()) {
+        topology.resize(1);
+        for (int cpu = 0; cpu < NumSystemCores(); ++cpu)
+            topology[0].push_back(cpu);
+    }
+    return topology;
+}
+
+static const std::vector<std::vector<int>> &NumaTopology() {
+    static const std::vector<std::vector<int>> topology = ReadNumaTopology();
+    return topology;
+}
+
+static void PinCurrentThread(const std::vector<int> &cpus) {
+#ifdef PBRT_HAVE_PTHREAD_AFFINITY
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+        if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        Warning("Unable to set thread affinity.");
+#endif
+}
+
+static void PinThread(int tIndex) {
+    const std::pair<int, int> &cpu = threadCpus[tIndex % threadCpus.size()];
+    PinCurrentThread({cpu.first});
+    ThreadNumaNode = cpu.second;
+}
+
+static void NotifyWorkers() {
+    // Either a worker going to sleep sees the task just pushed or this
+    // sees the worker and wakes it
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (nSleepingWorkers.load() > 0) {
+        std::lock_guard<std::mutex> lock(workerMutex);
+        workerCondition.notify_all();
+    }
+}
+
+static bool AnyTasks() {
+    for (int i = 0; i < nWorkQueues; ++i)
+        if (workQueues[i].HasTasks()) return true;
+    return false;
+}
+
+static bool FindTask(ParallelTask *task) {
+    if (workQueues[ThreadIndex].Pop(task)) return true;
+    // Steal the oldest, and so largest, task from another thread
+    for (int i = 0; i < nWorkQueues - 1; ++i) {
+        nextVictim = (nextVictim + 1) % nWorkQueues;
+        if (nextVictim == ThreadIndex)
+            nextVictim = (nextVictim + 1) % nWorkQueues;
+        if (workQueues[nextVictim].Steal(task)) {
+            ++nTasksStolen;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void RunTask(ParallelTask task) {
+    ParallelForLoop *loop = task.loop;
+    WorkQueue &queue = workQueues[ThreadIndex];
+    uint64_t oldState = ProfilerState;
+    ProfilerState = loop->profilerState;
+    int64_t nChunksRun = 0;
+    while (task.chunkStart < task.chunkEnd) {
+        // Split off the upper half of the range whenever this thread's
+        // queue runs dry, so that there is always something to steal but
+        // chunks aren't pushed one at a time when nobody is stealing
+        if (task.chunkEnd - task.chunkStart > 1 && !queue.HasTasks()) {
+            int64_t mid = (task.chunkStart + task.chunkEnd) / 2;
+            if (queue.Push({loop, mid, task.chunkEnd})) {
+                NotifyWorkers();
+                task.chunkEnd = mid;
+            }
+        }
+
+        // Run loop indices for the chunk at _chunkStart_
+        int64_t indexStart = task.chunkStart * loop->chunkSize;
+        int64_t indexEnd =
+            std::min(indexStart + loop->chunkSize, loop->maxIndex);
+        for (int64_t index = indexStart; index < indexEnd; ++index) {
+            if (loop->func1D) {
+                loop->func1D(index);
+            }
+            // Handle other types of loops
+            else {
+                CHECK(loop->func2D);
+                loop->func2D(Point2i(index % loop->nX, index / loop->nX));
+            }
+        }
+        ++task.chunkStart;
+        ++nChunksRun;
+    }
+    ProfilerState = oldState;
+    loop->chunksRemaining.fetch_sub(nChunksRun, std::memory_order_acq_rel);
+}
+
+static void RunLoop(ParallelForLoop &loop) {
+    RunTask({&loop, 0, loop.chunksRemaining.load()});
+    // Run other tasks, including ones from unrelated loops, until the
+    // threads that stole _loop_'s chunks are done with them
+    while (loop.chunksRemaining.load(std::memory_order_acquire) > 0) {
+        ParallelTask task;
+        if (FindTask(&task))
+            RunTask(task);
+        else
+            std::this_thread::yield();
+    }
+}
+
 void Barrier::Wait() {
     std::unique_lock<std::mutex> lock(mutex);
     CHECK_GT(count, 0);
@@ -107,8 +354,6 @@ void Barrier::Wait() {
         cv.wait(lock, [this] { return count == 0; });
 }
 
-static std::condition_variable workListCondition;
-
 static void workerThreadFunc(int tIndex, std::shared_ptr<Barrier> barrier) {
     LOG(INFO) << "Started execution in worker thread " << tIndex;
     ThreadIndex = tIndex;
@@ -126,56 +371,39 @@ static void workerThreadFunc(int tIndex, std::shared_ptr<Barrier> barrier) {
     // the threads have cleared it.
     barrier.reset();
 
-    std::unique_lock<std::mutex> lock(workListMutex);
-    while (!shutdownThreads) {
-        if (reportWorkerStats) {
+    if (!threadCpus.empty()) PinThread(tIndex);
+    int reportedStatsEpoch;
+    {
+        std::lock_guard<std::mutex> lock(workerMutex);
+        reportedStatsEpoch = statsEpoch;
+    }
+    while (true) {
+        // Run or steal a task if there is one
+        ParallelTask task;
+        if (FindTask(&task)) {
+            RunTask(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(workerMutex);
+        if (shutdownThreads) break;
+        if (reportedStatsEpoch != statsEpoch) {
             ReportThreadStats();
+            reportedStatsEpoch = statsEpoch;
             if (--reporterCount == 0)
                 // Once all worker threads have merged their stats, wake up
                 // the main thread.
                 reportDoneCondition.notify_one();
-            // Now sleep again.
-            workListCondition.wait(lock);
-        } else if (!workList) {
-            // Sleep until there are more tasks to run
-            workListCondition.wait(lock);
-        } else {
-            // Get work from _workList_ and run loop iterations
-            ParallelForLoop &loop = *workList;
-
-            // Run a chunk of loop iterations for _loop_
-
-            // Find the set of loop iterations to run next
-            int64_t indexStart = loop.nextIndex;
-            int64_t indexEnd =
-                std::min(indexStart + loop.chunkSize, loop.maxIndex);
-
-            // Update _loop_ to reflect iterations this thread will run
-            loop.nextIndex = indexEnd;
-            if (loop.nextIndex == loop.maxIndex) workList = loop.next;
-            loop.activeWorkers++;
-
-            // Run loop indices in _[indexStart, indexEnd)_
-            lock.unlock();
-            for (int64_t index = indexStart; index < indexEnd; ++index) {
-                uint64_t oldState = ProfilerState;
-                ProfilerState = loop.profilerState;
-                if (loop.func1D) {
-                    loop.func1D(index);
-                }
-                // Handle other types of loops
-                else {
-                    CHECK(loop.func2D);
-                    loop.func2D(Point2i(index % loop.nX, index / loop.nX));
-                }
-                ProfilerState = oldState;
-            }
-            lock.lock();
-
-            // Update _loop_ to reflect completion of iterations
-            loop.activeWorkers--;
-            if (loop.Finished()) workListCondition.notify_all();
+            continue;
         }
+
+        // Sleep until more tasks are pushed; see NotifyWorkers()
+        ++nSleepingWorkers;
+        workerCondition.wait(lock, [&]() {
+            return AnyTasks() || shutdownThreads ||
+                   reportedStatsEpoch != statsEpoch;
+        });
+        --nSleepingWorkers;
     }
     LOG(INFO) << "Exiting worker thread " << tIndex;
 }
@@ -184,6 +412,7 @@ static void workerThreadFunc(int tIndex, std::shared_ptr<Barrier> barrier) {
 void ParallelFor(std::function<void(int64_t)> func, int64_t count,
                  int chunkSize) {
     CHECK(threads.size() > 0 || MaxThreadIndex() == 1);
+    CHECK_GE(ThreadIndex, 0);
 
     // Run iterations immediately if not using threads or if _count_ is small
     if (threads.empty() || count < chunkSize) {
@@ -191,54 +420,15 @@ void ParallelFor(std::function<void(int64_t)> func, int64_t count,
         return;
     }
 
-    // Create and enqueue _ParallelForLoop_ for this loop
+    // Run _ParallelForLoop_ for this loop, sharing its chunks with the
+    // other threads
     ParallelForLoop loop(std::move(func), count, chunkSize,
                          CurrentProfilerState());
-    workListMutex.lock();
-    loop.next = workList;
-    workList = &loop;
-    workListMutex.unlock();
-
-    // Notify worker threads of work to be done
-    std::unique_lock<std::mutex> lock(workListMutex);
-    workListCondition.notify_all();
-
-    // Help out with parallel loop iterations in the current thread
-    while (!loop.Finished()) {
-        // Run a chunk of loop iterations for _loop_
-
-        // Find the set of loop iterations to run next
-        int64_t indexStart = loop.nextIndex;
-        int64_t indexEnd = std::min(indexStart + loop.chunkSize, loop.maxIndex);
-
-        // Update _loop_ to reflect iterations this thread will run
-        loop.nextIndex = indexEnd;
-        if (loop.nextIndex == loop.maxIndex) workList = loop.next;
-        loop.activeWorkers++;
-
-        // Run loop indices in _[indexStart, indexEnd)_
-        lock.unlock();
-        for (int64_t index = indexStart; index < indexEnd; ++index) {
-            uint64_t oldState = ProfilerState;
-            ProfilerState = loop.profilerState;
-            if (loop.func1D) {
-                loop.func1D(index);
-            }
-            // Handle other types of loops
-            else {
-                CHECK(loop.func2D);
-                loop.func2D(Point2i(index % loop.nX, index / loop.nX));
-            }
-            ProfilerState = oldState;
-        }
-        lock.lock();
-
-        // Update _loop_ to reflect completion of iterations
-        loop.activeWorkers--;
-    }
+    RunLoop(loop);
 }
 
 PBRT_THREAD_LOCAL int ThreadIndex;
+PBRT_THREAD_LOCAL int ThreadNumaNode;
 
 int MaxThreadIndex() {
     return PbrtOptions.nThreads == 0 ? NumSystemCores() : PbrtOptions.nThreads;
@@ -246,6 +436,7 @@ int MaxThreadIndex() {
 
 void ParallelFor2D(std::function<void(Point2i)> func, const Point2i &count) {
     CHECK(threads.size() > 0 || MaxThreadIndex() == 1);
+    CHECK_GE(ThreadIndex, 0);
 
     if (threads.empty() || count.x * count.y <= 1) {
         for (int y = 0; y < count.y; ++y)
@@ -254,58 +445,53 @@ void ParallelFor2D(std::function<void(Point2i)> func, const Point2i &count) {
     }
 
     ParallelForLoop loop(std::move(func), count, CurrentProfilerState());
-    {
-        std::lock_guard<std::mutex> lock(workListMutex);
-        loop.next = workList;
-        workList = &loop;
-    }
-
-    std::unique_lock<std::mutex> lock(workListMutex);
-    workListCondition.notify_all();
-
-    // Help out with parallel loop iterations in the current thread
-    while (!loop.Finished()) {
-        // Run a chunk of loop iterations for _loop_
-
-        // Find the set of loop iterations to run next
-        int64_t indexStart = loop.nextIndex;
-        int64_t indexEnd = std::min(indexStart + loop.chunkSize, loop.maxIndex);
-
-        // Update _loop_ to reflect iterations this thread will run
-        loop.nextIndex = indexEnd;
-        if (loop.nextIndex == loop.maxIndex) workList = loop.next;
-        loop.activeWorkers++;
-
-        // Run loop indices in _[indexStart, indexEnd)_
-        lock.unlock();
-        for (int64_t index = indexStart; index < indexEnd; ++index) {
-            uint64_t oldState = ProfilerState;
-            ProfilerState = loop.profilerState;
-            if (loop.func1D) {
-                loop.func1D(index);
-            }
-            // Handle other types of loops
-            else {
-                CHECK(loop.func2D);
-                loop.func2D(Point2i(index % loop.nX, index / loop.nX));
-            }
-            ProfilerState = oldState;
-        }
-        lock.lock();
-
-        // Update _loop_ to reflect completion of iterations
-        loop.activeWorkers--;
-    }
+    RunLoop(loop);
 }
 
 int NumSystemCores() {
     return std::max(1u, std::thread::hardware_concurrency());
 }
 
+int NumaNodeCount() { return NumaTopology().size(); }
+
+void RunOnNumaNode(int node, const std::function<void()> &func) {
+    // Memory is placed on the node of the thread that first touches it, so
+    // run _func_ on a thread restricted to the node's CPUs
+    CHECK_LT(node, NumaNodeCount());
+    std::thread thread([&]() {
+        PinCurrentThread(NumaTopology()[node]);
+        ThreadNumaNode = node;
+        // This thread has no work queue or per-thread buffers of its own;
+        // the negative index makes _ParallelFor()_ reject work issued from it
+        ThreadIndex = -1;
+        func();
+        ReportThreadStats();
+    });
+    thread.join();
+}
+
 void ParallelInit() {
     CHECK_EQ(threads.size(), 0);
     int nThreads = MaxThreadIndex();
     ThreadIndex = 0;
+    if (PbrtOptions.pinThreads) {
+        // Take one CPU from each NUMA node in turn, so that threads are
+        // spread evenly over the nodes whatever their number
+        const std::vector<std::vector<int>> &topology = NumaTopology();
+        size_t maxNodeCpus = 0;
+        for (const std::vector<int> &cpus : topology)
+            maxNodeCpus = std::max(maxNodeCpus, cpus.size());
+        for (size_t i = 0; i < maxNodeCpus; ++i)
+            for (size_t node = 0; node < topology.size(); ++node)
+                if (i < topology[node].size())
+                    threadCpus.push_back(
+                        std::make_pair(topology[node][i], int(node)));
+        PinThread(0);
+    }
+    if (nThreads > 1) {
+        workQueues.reset(new WorkQueue[nThreads]);
+        nWorkQueues = nThreads;
+    }
 
     // Create a barrier so that we can be sure all worker threads get past
     // their call to ProfilerWorkerThreadInit() before we return from this
@@ -322,34 +508,45 @@ void ParallelInit() {
 }
 
 void ParallelCleanup() {
-    if (threads.empty()) return;
+    if (!threadCpus.empty()) {
+        // Let the main thread run anywhere again
+        std::vector<int> cpus;
+        for (const std::vector<int> &nodeCpus : NumaTopology())
+            cpus.insert(cpus.end(), nodeCpus.begin(), nodeCpus.end());
+        PinCurrentThread(cpus);
+        ThreadNumaNode = 0;
+    }
+    if (threads.empty()) {
+        threadCpus.clear();
+        return;
+    }
 
     {
-        std::lock_guard<std::mutex> lock(workListMutex);
+        std::lock_guard<std::mutex> lock(workerMutex);
         shutdownThreads = true;
-        workListCondition.notify_all();
+        workerCondition.notify_all();
     }
 
     for (std::thread &thread : threads) thread.join();
     threads.erase(threads.begin(), threads.end());
     shutdownThreads = false;
+    workQueues.reset();
+    nWorkQueues = 0;
+    threadCpus.clear();
 }
 
 void MergeWorkerThreadStats() {
-    std::unique_lock<std::mutex> lock(workListMutex);
-    std::unique_lock<std::mutex> doneLock(reportDoneMutex);
+    std::unique_lock<std::mutex> lock(workerMutex);
     // Set up state so that the worker threads will know that we would like
     // them to report their thread-specific stats when they wake up.
-    reportWorkerStats = true;
+    ++statsEpoch;
     reporterCount = threads.size();
 
     // Wake up the worker threads.
-    workListCondition.notify_all();
+    workerCondition.notify_all();
 
     // Wait for all of them to merge their stats.
     reportDoneCondition.wait(lock, []() { return reporterCount == 0; });
-
-    reportWorkerStats = false;
 }
 
 }  // namespace pbrt
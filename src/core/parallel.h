@@ -104,6 +104,13 @@ extern PBRT_THREAD_LOCAL int ThreadIndex;
 void ParallelFor2D(std::function<void(Point2i)> func, const Point2i &count);
 int MaxThreadIndex();
 int NumSystemCores();
+// NUMA node of the core the calling thread is pinned to, or zero if
+// threads aren't pinned; see _Options::pinThreads_
+extern PBRT_THREAD_LOCAL int ThreadNumaNode;
+int NumaNodeCount();
+// Runs _func_ on a new thread pinned to the given node's CPUs; _func_ may
+// not issue _ParallelFor()_ loops
+void RunOnNumaNode(int node, const std::function<void()> &func);
 
 void ParallelInit();
 void ParallelCleanup();
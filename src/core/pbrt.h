@@ -102,6 +102,8 @@ template <typename T>
 class Vector3;
 template <typename T>
 class Vector4;
+template <typename T, int nPacketSamples>
+class Packet;
 template <typename T>
 class Point3;
 template <typename T>
@@ -140,6 +142,7 @@ class Sampler;
 class Filter;
 class Film;
 class FilmTile;
+class SpectralImageWriter;
 class BxDF;
 class BRDF;
 class BTDF;
@@ -164,6 +167,12 @@ class Distribution2D;
 #else
   typedef float Float;
 #endif  // PBRT_FLOAT_AS_DOUBLE
+#ifndef PBRT_WAVELENGTH_PACKET_SIZE
+  #define PBRT_WAVELENGTH_PACKET_SIZE 4
+#endif  // PBRT_WAVELENGTH_PACKET_SIZE
+static const int nPacketWavelengths = PBRT_WAVELENGTH_PACKET_SIZE;
+typedef Packet<Float, nPacketWavelengths> WvlPacketf;
+typedef Packet<int, nPacketWavelengths> WvlPacketi;
 class RNG;
 class ProgressReporter;
 class MemoryArena;
@@ -184,6 +193,8 @@ struct Options {
     bool quickRender = false;
     bool quiet = false;
     bool cat = false, toPly = false;
+    bool multiFrame = false;
+    bool pinThreads = false;
     std::string imageFile;
     // x0, x1, y0, y1
     Float cropWindow[2][2];
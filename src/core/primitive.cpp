@@ -43,6 +43,25 @@ STAT_MEMORY_COUNTER("Memory/Primitives", primitiveMemory);
 
 // Primitive Method Definitions
 Primitive::~Primitive() {}
+Bounds3f Primitive::ClippedWorldBound(const Bounds3f &clip) const {
+    return pbrt::Intersect(WorldBound(), clip);
+}
+
+Bounds3f Primitive::MotionWorldBound(Float time0, Float time1) const {
+    // Primitives that don't move occupy their full bound at all times
+    return WorldBound();
+}
+
+void Primitive::IntersectPacket(const Ray *rays, int nRays,
+                                SurfaceInteraction *isects, bool *hits) const {
+    for (int i = 0; i < nRays; ++i) hits[i] = Intersect(rays[i], &isects[i]);
+}
+
+void Primitive::IntersectPPacket(const Ray *rays, int nRays,
+                                 bool *occluded) const {
+    for (int i = 0; i < nRays; ++i) occluded[i] = IntersectP(rays[i]);
+}
+
 const AreaLight *Aggregate::GetAreaLight() const {
     LOG(FATAL) <<
         "Aggregate::GetAreaLight() method"
@@ -109,6 +128,14 @@ GeometricPrimitive::GeometricPrimitive(const std::shared_ptr<Shape> &shape,
 
 Bounds3f GeometricPrimitive::WorldBound() const { return shape->WorldBound(); }
 
+Bounds3f GeometricPrimitive::ClippedWorldBound(const Bounds3f &clip) const {
+    return shape->ClippedWorldBound(clip);
+}
+
+bool GeometricPrimitive::GetTriangleVertices(Point3f p[3]) const {
+    return shape->GetTriangleVertices(p);
+}
+
 bool GeometricPrimitive::IntersectP(const Ray &r) const {
     return shape->IntersectP(r);
 }
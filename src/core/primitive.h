@@ -53,8 +53,15 @@ class Primitive {
     // Primitive Interface
     virtual ~Primitive();
     virtual Bounds3f WorldBound() const = 0;
+    virtual Bounds3f ClippedWorldBound(const Bounds3f &clip) const;
+    virtual Bounds3f MotionWorldBound(Float time0, Float time1) const;
+    virtual bool GetTriangleVertices(Point3f p[3]) const { return false; }
     virtual bool Intersect(const Ray &r, SurfaceInteraction *) const = 0;
     virtual bool IntersectP(const Ray &r) const = 0;
+    virtual void IntersectPacket(const Ray *rays, int nRays,
+                                 SurfaceInteraction *isects, bool *hits) const;
+    virtual void IntersectPPacket(const Ray *rays, int nRays,
+                                  bool *occluded) const;
     virtual const AreaLight *GetAreaLight() const = 0;
     virtual const Material *GetMaterial() const = 0;
     virtual void ComputeScatteringFunctions(SurfaceInteraction *isect,
@@ -68,6 +75,8 @@ class GeometricPrimitive : public Primitive {
   public:
     // GeometricPrimitive Public Methods
     virtual Bounds3f WorldBound() const;
+    virtual Bounds3f ClippedWorldBound(const Bounds3f &clip) const;
+    virtual bool GetTriangleVertices(Point3f p[3]) const;
     virtual bool Intersect(const Ray &r, SurfaceInteraction *isect) const;
     virtual bool IntersectP(const Ray &r) const;
     GeometricPrimitive(const std::shared_ptr<Shape> &shape,
@@ -108,11 +117,20 @@ class TransformedPrimitive : public Primitive {
     Bounds3f WorldBound() const {
         return PrimitiveToWorld.MotionBounds(primitive->WorldBound());
     }
+    Bounds3f MotionWorldBound(Float time0, Float time1) const {
+        return PrimitiveToWorld.MotionBounds(
+            primitive->MotionWorldBound(time0, time1), time0, time1);
+    }
+    // Moves the instance; aggregates holding it must be refit or rebuilt
+    // before they're used again.
+    void SetPrimitiveToWorld(const AnimatedTransform &PrimitiveToWorld) {
+        this->PrimitiveToWorld = PrimitiveToWorld;
+    }
 
   private:
     // TransformedPrimitive Private Data
     std::shared_ptr<Primitive> primitive;
-    const AnimatedTransform PrimitiveToWorld;
+    AnimatedTransform PrimitiveToWorld;
 };
 
 // Aggregate Declarations
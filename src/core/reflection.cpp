@@ -147,34 +147,211 @@ std::string SpecularReflection::ToString() const {
            std::string(" fresnel: ") + fresnel->ToString() + std::string(" ]");
 }
 
-Spectrum DispersiveSpecularTransmission::Sample_f(const Vector3f &wo, Vector3f *wi,
-                                                  const Vector4f &wvls, const Point2f &sample,
-                                                  Float *pdf, BxDFType *sampledType) const {
-    // Figure out which $\eta$ is incident and which is transmitted
-    // and then compute actual $\eta$ based on the primary wavelength
-    bool entering = CosTheta(wo) > 0;
-    const Float _eta = eta(wvls[0]);
-    Float etaI = entering ? _eta : 1.0 / _eta;
-    Float etaT = entering ? 1.0 / _eta : _eta;
+Spectrum DispersiveDielectric::f(const Vector3f &wo, const Vector3f &wi,
+                                 int wvl) const {
+    if (!distribution) return Spectrum(0.f);
+    Float cosThetaO = CosTheta(wo), cosThetaI = CosTheta(wi);
+    if (cosThetaI == 0 || cosThetaO == 0) return Spectrum(0.f);
+    const Float eta = etas[wvl];
+
+    if (SameHemisphere(wo, wi)) {
+        // Evaluate microfacet reflection for the packet's _wvl_th $\eta$
+        if (!(type & BSDF_REFLECTION)) return Spectrum(0.f);
+        Vector3f wh = wi + wo;
+        if (wh.x == 0 && wh.y == 0 && wh.z == 0) return Spectrum(0.f);
+        wh = Normalize(wh);
+        Float F = FrDielectric(Dot(wi, Faceforward(wh, Vector3f(0, 0, 1))),
+                               1.f, eta);
+        return R * distribution->D(wh) * distribution->G(wo, wi) * F /
+               (4 * std::abs(cosThetaI * cosThetaO));
+    }
 
-    // Compute ray direction for specular transmission
-    if (!Refract(wo, Faceforward(Normal3f(0, 0, 1), wo), etaI / etaT, wi))
-        return 0;
+    // Evaluate microfacet transmission for the packet's _wvl_th $\eta$
+    if (!(type & BSDF_TRANSMISSION)) return Spectrum(0.f);
+    return T * Transmission(wo, wi, eta);
+}
 
-    // Note; doing this on the fly is probably murder?
-    const auto fresnel = FresnelDielectric(etaI, etaT);
+Float DispersiveDielectric::Transmission(const Vector3f &wo, const Vector3f &wi,
+                                         Float eta) const {
+    Float cosThetaO = CosTheta(wo), cosThetaI = CosTheta(wi);
+    Float etaRel = cosThetaO > 0 ? eta : 1 / eta;
+    Vector3f wh = Normalize(wo + wi * etaRel);
+    if (wh.z < 0) wh = -wh;
+    if (Dot(wo, wh) * Dot(wi, wh) > 0) return 0;
+    Float F = FrDielectric(Dot(wo, wh), 1.f, eta);
+    Float sqrtDenom = Dot(wo, wh) + etaRel * Dot(wi, wh);
+    Float factor = (mode == TransportMode::Radiance) ? (1 / etaRel) : 1;
+    return (1 - F) *
+           std::abs(distribution->D(wh) * distribution->G(wo, wi) * etaRel *
+                    etaRel * AbsDot(wi, wh) * AbsDot(wo, wh) * factor *
+                    factor /
+                    (cosThetaI * cosThetaO * sqrtDenom * sqrtDenom));
+}
 
-    *pdf = 1;
-    Spectrum ft = T * (Spectrum(1.) - fresnel.Evaluate(CosTheta(*wi)));
-    // Account for non-symmetry with transmission to different medium
-    if (mode == TransportMode::Radiance) ft *= (etaI * etaI) / (etaT * etaT);
-    return ft / AbsCosTheta(*wi);
+Spectrum DispersiveDielectric::Sample_f(const Vector3f &wo, Vector3f *wi,
+                                        const Point2f &uOrig, Float *pdf,
+                                        int wvl, BxDFType *sampledType) const {
+    // Sample a direction for the packet's _wvl_th $\eta$
+    const Float eta = etas[wvl];
+    bool hasR = type & BSDF_REFLECTION, hasT = type & BSDF_TRANSMISSION;
+    if (!distribution) {
+        // Choose specular reflection or transmission by Fresnel reflectance
+        Float F = FrDielectric(CosTheta(wo), 1.f, eta);
+        Float pr = hasR ? F : 0, pt = hasT ? 1 - F : 0;
+        if (pr == 0 && pt == 0) return Spectrum(0.f);
+        if (uOrig[0] < pr / (pr + pt)) {
+            *wi = Vector3f(-wo.x, -wo.y, wo.z);
+            if (sampledType)
+                *sampledType = BxDFType(BSDF_SPECULAR | BSDF_REFLECTION);
+            *pdf = pr / (pr + pt);
+            return F * R / AbsCosTheta(*wi);
+        }
+        bool entering = CosTheta(wo) > 0;
+        Float etaI = entering ? 1 : eta, etaT = entering ? eta : 1;
+        if (!Refract(wo, Faceforward(Normal3f(0, 0, 1), wo), etaI / etaT, wi))
+            return Spectrum(0.f);
+        Spectrum ft = T * (1 - F);
+        if (mode == TransportMode::Radiance)
+            ft *= (etaI * etaI) / (etaT * etaT);
+        if (sampledType)
+            *sampledType = BxDFType(BSDF_SPECULAR | BSDF_TRANSMISSION);
+        *pdf = pt / (pr + pt);
+        return ft / AbsCosTheta(*wi);
+    }
+
+    // Pick a microfacet lobe uniformly and sample its visible normals
+    if (wo.z == 0) return Spectrum(0.f);
+    Point2f u = uOrig;
+    bool sampleR = hasR;
+    if (hasR && hasT) {
+        sampleR = u[0] < .5f;
+        u[0] = std::min(2 * (sampleR ? u[0] : u[0] - .5f), OneMinusEpsilon);
+    }
+    Vector3f wh = distribution->Sample_wh(wo, u);
+    if (Dot(wo, wh) < 0) return Spectrum(0.f);
+    if (sampleR) {
+        *wi = Reflect(wo, wh);
+        if (!SameHemisphere(wo, *wi)) return Spectrum(0.f);
+    } else {
+        Float etaRel = CosTheta(wo) > 0 ? 1 / eta : eta;
+        if (!Refract(wo, (Normal3f)wh, etaRel, wi)) return Spectrum(0.f);
+    }
+    if (sampledType)
+        *sampledType = BxDFType((sampleR ? BSDF_REFLECTION : BSDF_TRANSMISSION) |
+                                BSDF_GLOSSY);
+    *pdf = Pdf(wo, *wi, wvl);
+    return f(wo, *wi, wvl);
 }
 
-std::string DispersiveSpecularTransmission::ToString() const {
-    return std::string("[ DispersiveSpecularTransmission: T: ") + T.ToString() +
-           StringPrintf(" cauchyB: %f cauchyC: %f ", cauchyB, cauchyC) +
-           std::string(" mode : ") +
+Float DispersiveDielectric::Pdf(const Vector3f &wo, const Vector3f &wi,
+                                int wvl) const {
+    if (!distribution) return 0;
+    bool hasR = type & BSDF_REFLECTION, hasT = type & BSDF_TRANSMISSION;
+    Float lobePdf = 0;
+    if (SameHemisphere(wo, wi)) {
+        if (!hasR) return 0;
+        Vector3f wh = Normalize(wo + wi);
+        lobePdf = distribution->Pdf(wo, wh) / (4 * Dot(wo, wh));
+    } else {
+        if (!hasT) return 0;
+        // Compute change of variables _dwh\_dwi_ for the _wvl_th $\eta$
+        Float etaRel = CosTheta(wo) > 0 ? etas[wvl] : 1 / etas[wvl];
+        Vector3f wh = Normalize(wo + wi * etaRel);
+        if (Dot(wo, wh) * Dot(wi, wh) > 0) return 0;
+        Float sqrtDenom = Dot(wo, wh) + etaRel * Dot(wi, wh);
+        Float dwh_dwi =
+            std::abs((etaRel * etaRel * Dot(wi, wh)) / (sqrtDenom * sqrtDenom));
+        lobePdf = distribution->Pdf(wo, wh) * dwh_dwi;
+    }
+    return (hasR && hasT) ? .5f * lobePdf : lobePdf;
+}
+
+WvlPacketf DispersiveDielectric::fWvls(const Vector3f &wo, const Vector3f &wi,
+                                       const WvlPacketi &wvlIdx) const {
+    WvlPacketf f(0.f);
+    if (!distribution) return f;
+    Float cosThetaO = CosTheta(wo), cosThetaI = CosTheta(wi);
+    if (cosThetaI == 0 || cosThetaO == 0) return f;
+
+    if (SameHemisphere(wo, wi)) {
+        // Share $D$, $G$ and the half vector; only Fresnel depends on $\eta$
+        if (!(type & BSDF_REFLECTION)) return f;
+        Vector3f wh = wi + wo;
+        if (wh.x == 0 && wh.y == 0 && wh.z == 0) return f;
+        wh = Normalize(wh);
+        Float cosThetaH = Dot(wi, Faceforward(wh, Vector3f(0, 0, 1)));
+        Float DG = distribution->D(wh) * distribution->G(wo, wi) /
+                   (4 * std::abs(cosThetaI * cosThetaO));
+        for (int i = 0; i < f.nSamples; ++i)
+            f[i] = R[wvlIdx[i]] * DG * FrDielectric(cosThetaH, 1.f, etas[i]);
+        return f;
+    }
+
+    // Refraction moves the half vector, so evaluate each wavelength
+    if (!(type & BSDF_TRANSMISSION)) return f;
+    for (int i = 0; i < f.nSamples; ++i)
+        f[i] = T[wvlIdx[i]] * Transmission(wo, wi, etas[i]);
+    return f;
+}
+
+WvlPacketf DispersiveDielectric::PdfWvls(const Vector3f &wo,
+                                         const Vector3f &wi) const {
+    // Only the transmission lobe's change of variables depends on $\eta$
+    if (SameHemisphere(wo, wi)) return WvlPacketf(Pdf(wo, wi, 0));
+    WvlPacketf pdf;
+    for (int i = 0; i < pdf.nSamples; ++i) pdf[i] = Pdf(wo, wi, i);
+    return pdf;
+}
+
+WvlPacketf DispersiveDielectric::Sample_fWvls(const Vector3f &wo, Vector3f *wi,
+                                              const Point2f &u,
+                                              const WvlPacketi &wvlIdx,
+                                              WvlPacketf *pdfs,
+                                              BxDFType *sampledType) const {
+    WvlPacketf f(0.f);
+    *pdfs = WvlPacketf(0.f);
+    BxDFType sampled;
+    Float heroPdf = 0;
+    if (Sample_f(wo, wi, u, &heroPdf, 0, &sampled).IsBlack() || heroPdf == 0)
+        return f;
+    if (sampledType) *sampledType = sampled;
+    if (distribution) {
+        *pdfs = PdfWvls(wo, *wi);
+        return fWvls(wo, *wi, wvlIdx);
+    }
+
+    bool hasR = type & BSDF_REFLECTION, hasT = type & BSDF_TRANSMISSION;
+    if (sampled & BSDF_REFLECTION) {
+        // Every wavelength reflects specularly into the hero's _wi_
+        for (int i = 0; i < f.nSamples; ++i) {
+            Float F = FrDielectric(CosTheta(wo), 1.f, etas[i]);
+            Float pr = hasR ? F : 0, pt = hasT ? 1 - F : 0;
+            if (pr == 0 && pt == 0) continue;
+            (*pdfs)[i] = pr / (pr + pt);
+            f[i] = F * R[wvlIdx[i]] / AbsCosTheta(*wi);
+        }
+        return f;
+    }
+
+    // Only wavelengths sharing the hero's $\eta$ refract into _wi_
+    Float Fh = FrDielectric(CosTheta(wo), 1.f, etas[0]);
+    bool entering = CosTheta(wo) > 0;
+    Float etaI = entering ? 1 : etas[0], etaT = entering ? etas[0] : 1;
+    Float scale = (1 - Fh) / AbsCosTheta(*wi);
+    if (mode == TransportMode::Radiance) scale *= (etaI * etaI) / (etaT * etaT);
+    for (int i = 0; i < f.nSamples; ++i) {
+        if (etas[i] != etas[0]) continue;
+        (*pdfs)[i] = heroPdf;
+        f[i] = T[wvlIdx[i]] * scale;
+    }
+    return f;
+}
+
+std::string DispersiveDielectric::ToString() const {
+    return std::string("[ DispersiveDielectric R: ") + R.ToString() +
+           std::string(" T: ") + T.ToString() + std::string(" distribution: ") +
+           (distribution ? distribution->ToString() : std::string("none")) +
+           StringPrintf(" hero eta: %f ", etas[0]) + std::string(" mode : ") +
            (mode == TransportMode::Radiance ? std::string("RADIANCE")
                                             : std::string("IMPORTANCE")) +
            std::string(" ]");
@@ -828,6 +1005,177 @@ Float BSDF::Pdf(const Vector3f &woWorld, const Vector3f &wiWorld,
     return v;
 }
 
+Spectrum BSDF::f(const Vector3f &woW, const Vector3f &wiW, int wvl,
+                 BxDFType flags) const {
+    ProfilePhase pp(Prof::BSDFEvaluation);
+    Vector3f wi = WorldToLocal(wiW), wo = WorldToLocal(woW);
+    if (wo.z == 0) return 0.;
+    bool reflect = Dot(wiW, ng) * Dot(woW, ng) > 0;
+    Spectrum f(0.f);
+    for (int i = 0; i < nBxDFs; ++i)
+        if (bxdfs[i]->MatchesFlags(flags) &&
+            ((reflect && (bxdfs[i]->type & BSDF_REFLECTION)) ||
+             (!reflect && (bxdfs[i]->type & BSDF_TRANSMISSION))))
+            f += bxdfs[i]->f(wo, wi, wvl);
+    return f;
+}
+
+Float BSDF::Pdf(const Vector3f &woWorld, const Vector3f &wiWorld, int wvl,
+                BxDFType flags) const {
+    ProfilePhase pp(Prof::BSDFPdf);
+    if (nBxDFs == 0.f) return 0.f;
+    Vector3f wo = WorldToLocal(woWorld), wi = WorldToLocal(wiWorld);
+    if (wo.z == 0) return 0.;
+    Float pdf = 0.f;
+    int matchingComps = 0;
+    for (int i = 0; i < nBxDFs; ++i)
+        if (bxdfs[i]->MatchesFlags(flags)) {
+            ++matchingComps;
+            pdf += bxdfs[i]->Pdf(wo, wi, wvl);
+        }
+    return matchingComps > 0 ? pdf / matchingComps : 0.f;
+}
+
+Spectrum BSDF::Sample_f(const Vector3f &woWorld, Vector3f *wiWorld,
+                        const Point2f &u, Float *pdf, int wvl, BxDFType type,
+                        BxDFType *sampledType) const {
+    ProfilePhase pp(Prof::BSDFSampling);
+    // Choose which _BxDF_ to sample
+    int matchingComps = NumComponents(type);
+    if (matchingComps == 0) {
+        *pdf = 0;
+        if (sampledType) *sampledType = BxDFType(0);
+        return Spectrum(0);
+    }
+    int comp =
+        std::min((int)std::floor(u[0] * matchingComps), matchingComps - 1);
+    BxDF *bxdf = nullptr;
+    int count = comp;
+    for (int i = 0; i < nBxDFs; ++i)
+        if (bxdfs[i]->MatchesFlags(type) && count-- == 0) {
+            bxdf = bxdfs[i];
+            break;
+        }
+    CHECK(bxdf != nullptr);
+    Point2f uRemapped(std::min(u[0] * matchingComps - comp, OneMinusEpsilon),
+                      u[1]);
+
+    // Sample chosen _BxDF_ for the _wvl_th wavelength of the packet
+    Vector3f wi, wo = WorldToLocal(woWorld);
+    if (wo.z == 0) return 0.;
+    *pdf = 0;
+    if (sampledType) *sampledType = bxdf->type;
+    Spectrum f = bxdf->Sample_f(wo, &wi, uRemapped, pdf, wvl, sampledType);
+    if (*pdf == 0) {
+        if (sampledType) *sampledType = BxDFType(0);
+        return 0;
+    }
+    *wiWorld = LocalToWorld(wi);
+
+    // Compute overall PDF and BSDF value with all matching _BxDF_s
+    if (!(bxdf->type & BSDF_SPECULAR) && matchingComps > 1)
+        for (int i = 0; i < nBxDFs; ++i)
+            if (bxdfs[i] != bxdf && bxdfs[i]->MatchesFlags(type))
+                *pdf += bxdfs[i]->Pdf(wo, wi, wvl);
+    if (matchingComps > 1) *pdf /= matchingComps;
+    if (!(bxdf->type & BSDF_SPECULAR)) {
+        bool reflect = Dot(*wiWorld, ng) * Dot(woWorld, ng) > 0;
+        f = 0.;
+        for (int i = 0; i < nBxDFs; ++i)
+            if (bxdfs[i]->MatchesFlags(type) &&
+                ((reflect && (bxdfs[i]->type & BSDF_REFLECTION)) ||
+                 (!reflect && (bxdfs[i]->type & BSDF_TRANSMISSION))))
+                f += bxdfs[i]->f(wo, wi, wvl);
+    }
+    return f;
+}
+
+WvlPacketf BSDF::fWvls(const Vector3f &woW, const Vector3f &wiW,
+                       const WvlPacketi &wvlIdx, BxDFType flags) const {
+    ProfilePhase pp(Prof::BSDFEvaluation);
+    Vector3f wi = WorldToLocal(wiW), wo = WorldToLocal(woW);
+    WvlPacketf f(0.f);
+    if (wo.z == 0) return f;
+    bool reflect = Dot(wiW, ng) * Dot(woW, ng) > 0;
+    for (int i = 0; i < nBxDFs; ++i)
+        if (bxdfs[i]->MatchesFlags(flags) &&
+            ((reflect && (bxdfs[i]->type & BSDF_REFLECTION)) ||
+             (!reflect && (bxdfs[i]->type & BSDF_TRANSMISSION))))
+            f += bxdfs[i]->fWvls(wo, wi, wvlIdx);
+    return f;
+}
+
+WvlPacketf BSDF::PdfWvls(const Vector3f &woWorld, const Vector3f &wiWorld,
+                         BxDFType flags) const {
+    ProfilePhase pp(Prof::BSDFPdf);
+    WvlPacketf pdf(0.f);
+    if (nBxDFs == 0.f) return pdf;
+    Vector3f wo = WorldToLocal(woWorld), wi = WorldToLocal(wiWorld);
+    if (wo.z == 0) return pdf;
+    int matchingComps = 0;
+    for (int i = 0; i < nBxDFs; ++i)
+        if (bxdfs[i]->MatchesFlags(flags)) {
+            ++matchingComps;
+            pdf += bxdfs[i]->PdfWvls(wo, wi);
+        }
+    return matchingComps > 0 ? pdf / matchingComps : pdf;
+}
+
+WvlPacketf BSDF::Sample_fWvls(const Vector3f &woWorld, Vector3f *wiWorld,
+                              const Point2f &u, const WvlPacketi &wvlIdx,
+                              WvlPacketf *pdfs, BxDFType type,
+                              BxDFType *sampledType) const {
+    ProfilePhase pp(Prof::BSDFSampling);
+    // Choose which _BxDF_ to sample
+    WvlPacketf f(0.f);
+    *pdfs = WvlPacketf(0.f);
+    int matchingComps = NumComponents(type);
+    if (matchingComps == 0) {
+        if (sampledType) *sampledType = BxDFType(0);
+        return f;
+    }
+    int comp =
+        std::min((int)std::floor(u[0] * matchingComps), matchingComps - 1);
+    BxDF *bxdf = nullptr;
+    int count = comp;
+    for (int i = 0; i < nBxDFs; ++i)
+        if (bxdfs[i]->MatchesFlags(type) && count-- == 0) {
+            bxdf = bxdfs[i];
+            break;
+        }
+    CHECK(bxdf != nullptr);
+    Point2f uRemapped(std::min(u[0] * matchingComps - comp, OneMinusEpsilon),
+                      u[1]);
+
+    // Sample chosen _BxDF_ for the hero wavelength, scoring the whole packet
+    Vector3f wi, wo = WorldToLocal(woWorld);
+    if (wo.z == 0) return f;
+    if (sampledType) *sampledType = bxdf->type;
+    f = bxdf->Sample_fWvls(wo, &wi, uRemapped, wvlIdx, pdfs, sampledType);
+    if ((*pdfs)[0] == 0) {
+        if (sampledType) *sampledType = BxDFType(0);
+        return WvlPacketf(0.f);
+    }
+    *wiWorld = LocalToWorld(wi);
+
+    // Compute overall PDFs and BSDF values with all matching _BxDF_s
+    if (!(bxdf->type & BSDF_SPECULAR) && matchingComps > 1)
+        for (int i = 0; i < nBxDFs; ++i)
+            if (bxdfs[i] != bxdf && bxdfs[i]->MatchesFlags(type))
+                *pdfs += bxdfs[i]->PdfWvls(wo, wi);
+    if (matchingComps > 1) *pdfs /= matchingComps;
+    if (!(bxdf->type & BSDF_SPECULAR)) {
+        bool reflect = Dot(*wiWorld, ng) * Dot(woWorld, ng) > 0;
+        f = WvlPacketf(0.f);
+        for (int i = 0; i < nBxDFs; ++i)
+            if (bxdfs[i]->MatchesFlags(type) &&
+                ((reflect && (bxdfs[i]->type & BSDF_REFLECTION)) ||
+                 (!reflect && (bxdfs[i]->type & BSDF_TRANSMISSION))))
+                f += bxdfs[i]->fWvls(wo, wi, wvlIdx);
+    }
+    return f;
+}
+
 std::string BSDF::ToString() const {
     std::string s = StringPrintf("[ BSDF eta: %f nBxDFs: %d", eta, nBxDFs);
     for (int i = 0; i < nBxDFs; ++i)
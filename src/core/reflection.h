@@ -116,6 +116,14 @@ inline bool SameHemisphere(const Vector3f &w, const Normal3f &wp) {
     return w.z * wp.z > 0;
 }
 
+// Values of _s_ in the spectrum bins _wvlIdx_ of a wavelength packet
+inline WvlPacketf SpectrumAtBins(const Spectrum &s,
+                                 const WvlPacketi &wvlIdx) {
+    WvlPacketf v;
+    for (int i = 0; i < wvlIdx.nSamples; ++i) v[i] = s[wvlIdx[i]];
+    return v;
+}
+
 // BSDF Declarations
 enum BxDFType {
     BSDF_REFLECTION = 1 << 0,
@@ -194,6 +202,22 @@ class BSDF {
                       BxDFType *sampledType = nullptr) const;
     Float Pdf(const Vector3f &wo, const Vector3f &wi,
               BxDFType flags = BSDF_ALL) const;
+    Spectrum f(const Vector3f &woW, const Vector3f &wiW, int wvl,
+               BxDFType flags = BSDF_ALL) const;
+    Float Pdf(const Vector3f &woW, const Vector3f &wiW, int wvl,
+              BxDFType flags = BSDF_ALL) const;
+    Spectrum Sample_f(const Vector3f &wo, Vector3f *wi, const Point2f &u,
+                      Float *pdf, int wvl, BxDFType type = BSDF_ALL,
+                      BxDFType *sampledType = nullptr) const;
+    WvlPacketf fWvls(const Vector3f &woW, const Vector3f &wiW,
+                     const WvlPacketi &wvlIdx,
+                     BxDFType flags = BSDF_ALL) const;
+    WvlPacketf PdfWvls(const Vector3f &woW, const Vector3f &wiW,
+                       BxDFType flags = BSDF_ALL) const;
+    WvlPacketf Sample_fWvls(const Vector3f &woW, Vector3f *wiW,
+                            const Point2f &u, const WvlPacketi &wvlIdx,
+                            WvlPacketf *pdfs, BxDFType type = BSDF_ALL,
+                            BxDFType *sampledType = nullptr) const;
     std::string ToString() const;
 
     // BSDF Public Data
@@ -245,6 +269,43 @@ class BxDF {
     virtual Float Pdf(const Vector3f &wo, const Vector3f &wi) const;
     virtual std::string ToString() const = 0;
 
+    // Evaluate for the _wvl_th wavelength of the ray's packet; only
+    // wavelength-dependent BxDFs need to override these
+    virtual Spectrum f(const Vector3f &wo, const Vector3f &wi, int wvl) const {
+        return f(wo, wi);
+    }
+    virtual Float Pdf(const Vector3f &wo, const Vector3f &wi, int wvl) const {
+        return Pdf(wo, wi);
+    }
+    virtual Spectrum Sample_f(const Vector3f &wo, Vector3f *wi,
+                              const Point2f &sample, Float *pdf, int wvl,
+                              BxDFType *sampledType) const {
+        return Sample_f(wo, wi, sample, pdf, sampledType);
+    }
+
+    // Evaluate all wavelengths of the ray's packet at once, with _wvlIdx_
+    // their spectrum bins. Wavelength-independent BxDFs evaluate once and
+    // broadcast; only dispersive BxDFs do per-wavelength work.
+    virtual WvlPacketf fWvls(const Vector3f &wo, const Vector3f &wi,
+                             const WvlPacketi &wvlIdx) const {
+        return SpectrumAtBins(f(wo, wi), wvlIdx);
+    }
+    virtual WvlPacketf PdfWvls(const Vector3f &wo, const Vector3f &wi) const {
+        return WvlPacketf(Pdf(wo, wi));
+    }
+    // Sample _wi_ for the hero wavelength; _pdfs_ receives the probability
+    // with which each wavelength samples _wi_, which is zero for wavelengths
+    // that a delta lobe sends elsewhere
+    virtual WvlPacketf Sample_fWvls(const Vector3f &wo, Vector3f *wi,
+                                    const Point2f &sample,
+                                    const WvlPacketi &wvlIdx, WvlPacketf *pdfs,
+                                    BxDFType *sampledType = nullptr) const {
+        Float pdf = 0;
+        Spectrum f = Sample_f(wo, wi, sample, &pdf, sampledType);
+        *pdfs = WvlPacketf(pdf);
+        return SpectrumAtBins(f, wvlIdx);
+    }
+
     // BxDF Public Data
     const BxDFType type;
 };
@@ -342,41 +403,51 @@ class SpecularReflection : public BxDF {
     const Fresnel *fresnel;
 };
 
-class DispersiveSpecularTransmission : public BxDF {
-public:
-  // DispersiveSpecularTransmission constructors
-  DispersiveSpecularTransmission(const Spectrum &T, 
-    Float etaAMin, Float etaAMax,
-    Float etaBMin, Float etaBMax,
-    TransportMode mode)
-  : BxDF(BxDFType(BSDF_TRANSMISSION | BSDF_SPECULAR)),
-    T(T), mode(mode) {
-    const Float lambdaMinSq = sampledLambdaStart * sampledLambdaStart;
-    const Float lambdaMaxSq = sampledLambdaEnd * sampledLambdaEnd;
-    const Float etaMin = etaBMin / etaAMin;
-    const Float etaMax = etaBMax / etaAMax;
-    cauchyB = (lambdaMinSq * etaMax - lambdaMaxSq * etaMin)
-            / (lambdaMinSq - lambdaMaxSq);
-    cauchyC = lambdaMinSq * (etaMax - cauchyB);
-  }
-
-  // DispersiveSpecularTransmission public methods
-  Spectrum f(const Vector3f &wo, const Vector3f &wi) const {  return Spectrum(0.f); }
-  Spectrum Sample_f(const Vector3f &wo, Vector3f *wi, const Vector4f &wvls,
-                    const Point2f &sample, Float *pdf, BxDFType *sampledType) const;
-  Float Pdf(const Vector3f &wo, const Vector3f &wi) const { return 0; }
-  std::string ToString() const;
-
-private:
-  // DispersiveSpecularTransmission private methods
-  Float eta(Float wvl) const { 
-    return cauchyB + cauchyC / (wvl * wvl);
-  }
-
-  // DispersiveSpecularTransmission private data
-  const Spectrum T;
-  const TransportMode mode;
-  Float cauchyB, cauchyC;
+class DispersiveDielectric : public BxDF {
+  public:
+    // DispersiveDielectric Public Methods
+    DispersiveDielectric(const Spectrum &R, const Spectrum &T,
+                         const MicrofacetDistribution *distribution,
+                         const WvlPacketf &etas, TransportMode mode)
+        : BxDF(BxDFType((R.IsBlack() ? 0 : BSDF_REFLECTION) |
+                        (T.IsBlack() ? 0 : BSDF_TRANSMISSION) |
+                        (distribution ? BSDF_GLOSSY : BSDF_SPECULAR))),
+          R(R),
+          T(T),
+          distribution(distribution),
+          etas(etas),
+          mode(mode) {}
+    Spectrum f(const Vector3f &wo, const Vector3f &wi) const {
+        return f(wo, wi, 0);
+    }
+    Spectrum f(const Vector3f &wo, const Vector3f &wi, int wvl) const;
+    Spectrum Sample_f(const Vector3f &wo, Vector3f *wi, const Point2f &u,
+                      Float *pdf, BxDFType *sampledType) const {
+        return Sample_f(wo, wi, u, pdf, 0, sampledType);
+    }
+    Spectrum Sample_f(const Vector3f &wo, Vector3f *wi, const Point2f &u,
+                      Float *pdf, int wvl, BxDFType *sampledType) const;
+    Float Pdf(const Vector3f &wo, const Vector3f &wi) const {
+        return Pdf(wo, wi, 0);
+    }
+    Float Pdf(const Vector3f &wo, const Vector3f &wi, int wvl) const;
+    WvlPacketf fWvls(const Vector3f &wo, const Vector3f &wi,
+                     const WvlPacketi &wvlIdx) const;
+    WvlPacketf PdfWvls(const Vector3f &wo, const Vector3f &wi) const;
+    WvlPacketf Sample_fWvls(const Vector3f &wo, Vector3f *wi,
+                            const Point2f &sample, const WvlPacketi &wvlIdx,
+                            WvlPacketf *pdfs, BxDFType *sampledType) const;
+    std::string ToString() const;
+
+  private:
+    // DispersiveDielectric Private Methods
+    Float Transmission(const Vector3f &wo, const Vector3f &wi, Float eta) const;
+
+    // DispersiveDielectric Private Data
+    const Spectrum R, T;
+    const MicrofacetDistribution *distribution;
+    const WvlPacketf etas;
+    const TransportMode mode;
 };
 
 class SpecularTransmission : public BxDF {
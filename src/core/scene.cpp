@@ -33,6 +33,7 @@
 
 // core/scene.cpp*
 #include "scene.h"
+#include "sampling.h"
 #include "stats.h"
 
 namespace pbrt {
@@ -54,6 +55,32 @@ bool Scene::IntersectP(const Ray &ray) const {
     return aggregate->IntersectP(ray);
 }
 
+void Scene::IntersectPPacket(const Ray *rays, int nRays,
+                             bool *occluded) const {
+    // Test a bundle of shadow rays together so that coherent ones (e.g.,
+    // many samples of one light from a single shading point) can share
+    // acceleration structure traversal
+    nShadowTests += nRays;
+    aggregate->IntersectPPacket(rays, nRays, occluded);
+}
+
+int64_t Scene::ThreadRaysTraced() {
+    // Rays traced by the calling thread since its statistics were last
+    // reported; lets integrators measure their ray throughput
+    return nIntersectionTests + nShadowTests;
+}
+
+Float Scene::LightPdf(const Light *light,
+                      const Distribution1D *lightDistr) const {
+    // Look up the probability of choosing _light_ by its scene index
+    if (!light || lights.empty()) return 0;
+    int index = light->sceneIndex;
+    DCHECK(index >= 0 && index < (int)lights.size() &&
+           lights[index].get() == light);
+    if (!lightDistr) return 1.f / lights.size();
+    return lightDistr->DiscretePDF(index);
+}
+
 bool Scene::IntersectTr(Ray ray, Sampler &sampler, SurfaceInteraction *isect,
                         Spectrum *Tr) const {
     *Tr = Spectrum(1.f);
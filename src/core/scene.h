@@ -55,6 +55,7 @@ class Scene {
         : lights(lights), aggregate(aggregate) {
         // Scene Constructor Implementation
         worldBound = aggregate->WorldBound();
+        for (size_t i = 0; i < lights.size(); ++i) lights[i]->sceneIndex = i;
         for (const auto &light : lights) {
             light->Preprocess(*this);
             if (light->flags & (int)LightFlags::Infinite)
@@ -64,8 +65,11 @@ class Scene {
     const Bounds3f &WorldBound() const { return worldBound; }
     bool Intersect(const Ray &ray, SurfaceInteraction *isect) const;
     bool IntersectP(const Ray &ray) const;
+    void IntersectPPacket(const Ray *rays, int nRays, bool *occluded) const;
     bool IntersectTr(Ray ray, Sampler &sampler, SurfaceInteraction *isect,
                      Spectrum *transmittance) const;
+    Float LightPdf(const Light *light, const Distribution1D *lightDistr) const;
+    static int64_t ThreadRaysTraced();
 
     // Scene Public Data
     std::vector<std::shared_ptr<Light>> lights;
@@ -53,6 +53,10 @@ Shape::Shape(const Transform *ObjectToWorld, const Transform *WorldToObject,
 
 Bounds3f Shape::WorldBound() const { return (*ObjectToWorld)(ObjectBound()); }
 
+Bounds3f Shape::ClippedWorldBound(const Bounds3f &clip) const {
+    return pbrt::Intersect(WorldBound(), clip);
+}
+
 Interaction Shape::Sample(const Interaction &ref, const Point2f &u,
                           Float *pdf) const {
 
@@ -91,7 +95,7 @@ Float Shape::Pdf(const Interaction &ref, const Vector3f &wi) const {
 }
 
 Float Shape::SolidAngle(const Point3f &p, int nSamples) const {
-    Interaction ref(p, Normal3f(), Vector3f(), Vector3f(0, 0, 1), Vector4f(), 0,
+    Interaction ref(p, Normal3f(), Vector3f(), Vector3f(0, 0, 1), WvlPacketf(), 0,
                     MediumInterface{});
     double solidAngle = 0;
     for (int i = 0; i < nSamples; ++i) {
@@ -56,6 +56,12 @@ class Shape {
     virtual ~Shape();
     virtual Bounds3f ObjectBound() const = 0;
     virtual Bounds3f WorldBound() const;
+    // Returns a bound of the part of the shape that lies inside |clip|;
+    // the result is empty if the shape doesn't overlap it.
+    virtual Bounds3f ClippedWorldBound(const Bounds3f &clip) const;
+    // Returns true and the world-space vertices in |p| if the shape is a
+    // single triangle.
+    virtual bool GetTriangleVertices(Point3f p[3]) const { return false; }
     virtual bool Intersect(const Ray &ray, Float *tHit,
                            SurfaceInteraction *isect,
                            bool testAlphaTexture = true) const = 0;
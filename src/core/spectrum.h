@@ -81,22 +81,70 @@ extern const Float CIE_Y[nCIESamples];
 extern const Float CIE_Z[nCIESamples];
 extern const Float CIE_lambda[nCIESamples];
 static const Float CIE_Y_integral = 106.856895;
+
+// Tabulated CIE matching functions at _lambda_, interpolated between the 1nm
+// table entries; zero outside of the tabulated range
+inline void CIEMatchingFunctions(Float lambda, Float xyz[3]) {
+    Float offset = lambda - CIE_lambda[0];
+    if (!(offset >= 0 && offset < nCIESamples - 1)) {
+        xyz[0] = xyz[1] = xyz[2] = 0;
+        return;
+    }
+    int i = (int)offset;
+    Float t = offset - i;
+    xyz[0] = Lerp(t, CIE_X[i], CIE_X[i + 1]);
+    xyz[1] = Lerp(t, CIE_Y[i], CIE_Y[i + 1]);
+    xyz[2] = Lerp(t, CIE_Z[i], CIE_Z[i + 1]);
+}
 static const int nRGB2SpectSamples = 32;
 extern const Float RGB2SpectLambda[nRGB2SpectSamples];
-extern const Float RGBRefl2SpectWhite[nRGB2SpectSamples];
-extern const Float RGBRefl2SpectCyan[nRGB2SpectSamples];
-extern const Float RGBRefl2SpectMagenta[nRGB2SpectSamples];
-extern const Float RGBRefl2SpectYellow[nRGB2SpectSamples];
-extern const Float RGBRefl2SpectRed[nRGB2SpectSamples];
-extern const Float RGBRefl2SpectGreen[nRGB2SpectSamples];
-extern const Float RGBRefl2SpectBlue[nRGB2SpectSamples];
 extern const Float RGBIllum2SpectWhite[nRGB2SpectSamples];
-extern const Float RGBIllum2SpectCyan[nRGB2SpectSamples];
-extern const Float RGBIllum2SpectMagenta[nRGB2SpectSamples];
-extern const Float RGBIllum2SpectYellow[nRGB2SpectSamples];
-extern const Float RGBIllum2SpectRed[nRGB2SpectSamples];
-extern const Float RGBIllum2SpectGreen[nRGB2SpectSamples];
-extern const Float RGBIllum2SpectBlue[nRGB2SpectSamples];
+
+// RGBSigmoidPolynomial Declarations
+class RGBSigmoidPolynomial {
+  public:
+    // RGBSigmoidPolynomial Public Methods
+    RGBSigmoidPolynomial() : c0(0), c1(0), c2(0) {}
+    RGBSigmoidPolynomial(Float c0, Float c1, Float c2)
+        : c0(c0), c1(c1), c2(c2) {}
+    Float operator()(Float lambda) const {
+        // Polynomial is defined over wavelengths remapped to $[0,1]$
+        Float x = (lambda - sampledLambdaStart) / sampledLambdaRange;
+        return Sigmoid((c0 * x + c1) * x + c2);
+    }
+    static Float Sigmoid(Float t) {
+        if (std::isinf(t)) return t > 0 ? 1 : 0;
+        return .5f + t / (2 * std::sqrt(1 + t * t));
+    }
+
+    // RGBSigmoidPolynomial Public Data
+    Float c0, c1, c2;
+};
+
+// RGBToSpectrumTable Declarations
+class RGBToSpectrumTable {
+  public:
+    // RGBToSpectrumTable Public Methods
+    RGBToSpectrumTable(const float *zNodes, const float *coeffs)
+        : zNodes(zNodes), coeffs(coeffs) {}
+    RGBSigmoidPolynomial operator()(const Float rgb[3]) const;
+    static void Fit(const Float rgbResponse[3][nSpectralSamples],
+                    Float zNodes[], Float coeffs[]);
+
+    // RGBToSpectrumTable Public Data
+    static const int res = 24;
+    static const int nCoeffs = 3 * res * res * res * 3;
+
+  private:
+    // RGBToSpectrumTable Private Data
+    const float *zNodes, *coeffs;
+};
+
+// Sigmoid polynomial coefficients for _SampledSpectrum_'s RGB response under
+// the white illuminant, fitted offline by the rgb2spec tool; see
+// core/rgbspectrumtable.cpp
+extern const float RGBToSpectrumZNodes[RGBToSpectrumTable::res];
+extern const float RGBToSpectrumCoeffs[RGBToSpectrumTable::nCoeffs];
 
 // Spectrum Declarations
 template <int nSpectrumSamples>
@@ -342,54 +390,27 @@ class SampledSpectrum : public CoefficientSpectrum<nSpectralSamples> {
                                             wl1);
         }
 
-        // Compute RGB to spectrum functions for _SampledSpectrum_
+        // Compute white illuminant spectrum, normalized to unit luminance
         for (int i = 0; i < nSpectralSamples; ++i) {
             Float wl0 = Lerp(Float(i) / Float(nSpectralSamples),
                              sampledLambdaStart, sampledLambdaEnd);
             Float wl1 = Lerp(Float(i + 1) / Float(nSpectralSamples),
                              sampledLambdaStart, sampledLambdaEnd);
-            rgbRefl2SpectWhite.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBRefl2SpectWhite,
-                                       nRGB2SpectSamples, wl0, wl1);
-            rgbRefl2SpectCyan.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBRefl2SpectCyan,
-                                       nRGB2SpectSamples, wl0, wl1);
-            rgbRefl2SpectMagenta.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBRefl2SpectMagenta,
-                                       nRGB2SpectSamples, wl0, wl1);
-            rgbRefl2SpectYellow.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBRefl2SpectYellow,
-                                       nRGB2SpectSamples, wl0, wl1);
-            rgbRefl2SpectRed.c[i] = AverageSpectrumSamples(
-                RGB2SpectLambda, RGBRefl2SpectRed, nRGB2SpectSamples, wl0, wl1);
-            rgbRefl2SpectGreen.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBRefl2SpectGreen,
-                                       nRGB2SpectSamples, wl0, wl1);
-            rgbRefl2SpectBlue.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBRefl2SpectBlue,
-                                       nRGB2SpectSamples, wl0, wl1);
-
             rgbIllum2SpectWhite.c[i] =
                 AverageSpectrumSamples(RGB2SpectLambda, RGBIllum2SpectWhite,
                                        nRGB2SpectSamples, wl0, wl1);
-            rgbIllum2SpectCyan.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBIllum2SpectCyan,
-                                       nRGB2SpectSamples, wl0, wl1);
-            rgbIllum2SpectMagenta.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBIllum2SpectMagenta,
-                                       nRGB2SpectSamples, wl0, wl1);
-            rgbIllum2SpectYellow.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBIllum2SpectYellow,
-                                       nRGB2SpectSamples, wl0, wl1);
-            rgbIllum2SpectRed.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBIllum2SpectRed,
-                                       nRGB2SpectSamples, wl0, wl1);
-            rgbIllum2SpectGreen.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBIllum2SpectGreen,
-                                       nRGB2SpectSamples, wl0, wl1);
-            rgbIllum2SpectBlue.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBIllum2SpectBlue,
-                                       nRGB2SpectSamples, wl0, wl1);
+        }
+        rgbIllum2SpectWhite /= rgbIllum2SpectWhite.y();
+    }
+    // RGB of each bin of the white illuminant, which the RGB to spectrum
+    // coefficient table is fitted against
+    static void RGBResponse(Float rgbResponse[3][nSpectralSamples]) {
+        for (int i = 0; i < nSpectralSamples; ++i) {
+            SampledSpectrum s(0.f);
+            s.c[i] = rgbIllum2SpectWhite.c[i];
+            Float rgb[3];
+            s.ToRGB(rgb);
+            for (int ch = 0; ch < 3; ++ch) rgbResponse[ch][i] = rgb[ch];
         }
     }
     void ToXYZ(Float xyz[3]) const {
@@ -419,6 +440,8 @@ class SampledSpectrum : public CoefficientSpectrum<nSpectralSamples> {
     RGBSpectrum ToRGBSpectrum() const;
     static SampledSpectrum FromRGB(
         const Float rgb[3], SpectrumType type = SpectrumType::Illuminant);
+    static Float FromRGB(const Float rgb[3], Float lambda,
+                         SpectrumType type = SpectrumType::Illuminant);
     static SampledSpectrum FromXYZ(
         const Float xyz[3], SpectrumType type = SpectrumType::Reflectance) {
         Float rgb[3];
@@ -431,14 +454,8 @@ class SampledSpectrum : public CoefficientSpectrum<nSpectralSamples> {
   private:
     // SampledSpectrum Private Data
     static SampledSpectrum X, Y, Z;
-    static SampledSpectrum rgbRefl2SpectWhite, rgbRefl2SpectCyan;
-    static SampledSpectrum rgbRefl2SpectMagenta, rgbRefl2SpectYellow;
-    static SampledSpectrum rgbRefl2SpectRed, rgbRefl2SpectGreen;
-    static SampledSpectrum rgbRefl2SpectBlue;
-    static SampledSpectrum rgbIllum2SpectWhite, rgbIllum2SpectCyan;
-    static SampledSpectrum rgbIllum2SpectMagenta, rgbIllum2SpectYellow;
-    static SampledSpectrum rgbIllum2SpectRed, rgbIllum2SpectGreen;
-    static SampledSpectrum rgbIllum2SpectBlue;
+    static SampledSpectrum rgbIllum2SpectWhite;
+    static RGBToSpectrumTable rgbToSpectrum;
 };
 
 class RGBSpectrum : public CoefficientSpectrum<3> {
@@ -461,6 +478,10 @@ class RGBSpectrum : public CoefficientSpectrum<3> {
         DCHECK(!s.HasNaNs());
         return s;
     }
+    static Float FromRGB(const Float rgb[3], Float lambda,
+                         SpectrumType type = SpectrumType::Reflectance) {
+        return FromRGB(rgb, type)[indexFromWavelength(lambda)];
+    }
     void ToRGB(Float *rgb) const {
         rgb[0] = c[0];
         rgb[1] = c[1];
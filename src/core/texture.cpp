@@ -34,6 +34,7 @@
 // core/texture.cpp*
 #include "texture.h"
 #include "shape.h"
+#include "medium.h"
 
 namespace pbrt {
 
@@ -251,6 +252,19 @@ Float Turbulence(const Point3f &p, const Vector3f &dpdx, const Vector3f &dpdy,
 }
 
 // Texture Function Definitions
+WvlPacketf EvaluateWvls(const Texture<Spectrum> &tex,
+                        const SurfaceInteraction &si) {
+    // Convert RGB textures at the packet wavelengths only, instead of over
+    // all of the spectrum's samples
+    Float rgb[3];
+    if (!tex.EvaluateRGB(si, rgb))
+        return SpectrumAtWvls(tex.Evaluate(si), si.wvls);
+    WvlPacketf v;
+    for (int i = 0; i < v.nSamples; ++i)
+        v[i] = Spectrum::FromRGB(rgb, si.wvls[i]);
+    return v;
+}
+
 Float Lanczos(Float x, Float tau) {
     x = std::abs(x);
     if (x < 1e-5f) return 1;
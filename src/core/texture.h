@@ -136,9 +136,18 @@ class Texture {
   public:
     // Texture Interface
     virtual T Evaluate(const SurfaceInteraction &) const = 0;
+    // Textures that convert an RGB value to a spectrum can return the RGB
+    // value instead, so that callers needing only a few wavelengths convert
+    // just those; see _EvaluateWvls()_
+    virtual bool EvaluateRGB(const SurfaceInteraction &, Float rgb[3]) const {
+        return false;
+    }
     virtual ~Texture() {}
 };
 
+WvlPacketf EvaluateWvls(const Texture<Spectrum> &tex,
+                        const SurfaceInteraction &si);
+
 Float Lanczos(Float, Float tau = 2);
 Float Noise(Float x, Float y = .5f, Float z = .5f);
 Float Noise(const Point3f &p);
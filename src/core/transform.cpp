@@ -1246,4 +1246,55 @@ Bounds3f AnimatedTransform::BoundPointMotion(const Point3f &p) const {
     return bounds;
 }
 
+Bounds3f AnimatedTransform::MotionBounds(const Bounds3f &b, Float time0,
+                                         Float time1) const {
+    // Bound the motion over the part of $[time0, time1]$ inside the
+    // transform's time range; outside of it the transform is constant
+    if (!actuallyAnimated) return (*startTransform)(b);
+    time0 = Clamp(time0, startTime, endTime);
+    time1 = Clamp(time1, startTime, endTime);
+    if (hasRotation == false) {
+        // Translation and scale are linear in time, so the ends suffice
+        Transform t0, t1;
+        Interpolate(time0, &t0);
+        Interpolate(time1, &t1);
+        return Union(t0(b), t1(b));
+    }
+    Bounds3f bounds;
+    for (int corner = 0; corner < 8; ++corner)
+        bounds =
+            Union(bounds, BoundPointMotion(b.Corner(corner), time0, time1));
+    return bounds;
+}
+
+Bounds3f AnimatedTransform::BoundPointMotion(const Point3f &p, Float time0,
+                                             Float time1) const {
+    if (!actuallyAnimated) return Bounds3f((*startTransform)(p));
+    Transform t0, t1;
+    Interpolate(time0, &t0);
+    Interpolate(time1, &t1);
+    Bounds3f bounds(t0(p), t1(p));
+    Float dt0 = (time0 - startTime) / (endTime - startTime);
+    Float dt1 = (time1 - startTime) / (endTime - startTime);
+    Float cosTheta = Dot(R[0], R[1]);
+    Float theta = std::acos(Clamp(cosTheta, -1, 1));
+    for (int c = 0; c < 3; ++c) {
+        // Find any motion derivative zeros for the component _c_ between
+        // _dt0_ and _dt1_
+        Float zeros[8];
+        int nZeros = 0;
+        IntervalFindZeros(c1[c].Eval(p), c2[c].Eval(p), c3[c].Eval(p),
+                          c4[c].Eval(p), c5[c].Eval(p), theta,
+                          Interval(dt0, dt1), zeros, &nZeros);
+        CHECK_LE(nZeros, sizeof(zeros) / sizeof(zeros[0]));
+
+        // Expand bounding box for any motion derivative zeros found
+        for (int i = 0; i < nZeros; ++i) {
+            Point3f pz = (*this)(Lerp(zeros[i], startTime, endTime), p);
+            bounds = Union(bounds, pz);
+        }
+    }
+    return bounds;
+}
+
 }  // namespace pbrt
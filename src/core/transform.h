@@ -425,13 +425,16 @@ class AnimatedTransform {
         return startTransform->HasScale() || endTransform->HasScale();
     }
     Bounds3f MotionBounds(const Bounds3f &b) const;
+    Bounds3f MotionBounds(const Bounds3f &b, Float time0, Float time1) const;
     Bounds3f BoundPointMotion(const Point3f &p) const;
+    Bounds3f BoundPointMotion(const Point3f &p, Float time0,
+                              Float time1) const;
 
   private:
     // AnimatedTransform Private Data
     const Transform *startTransform, *endTransform;
-    const Float startTime, endTime;
-    const bool actuallyAnimated;
+    Float startTime, endTime;
+    bool actuallyAnimated;
     Vector3f T[2];
     Quaternion R[2];
     Matrix4x4 S[2];
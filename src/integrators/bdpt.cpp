@@ -95,7 +95,6 @@ int GenerateCameraSubpath(const Scene &scene, Sampler &sampler,
 int GenerateLightSubpath(
     const Scene &scene, Sampler &sampler, MemoryArena &arena, int maxDepth,
     Float time, const Distribution1D &lightDistr,
-    const std::unordered_map<const Light *, size_t> &lightToIndex,
     Vertex *path) {
     if (maxDepth == 0) return 0;
     ProfilePhase _(Prof::BDPTGenerateSubpath);
@@ -131,7 +130,7 @@ int GenerateLightSubpath(
 
         // Set spatial density of _path[0]_ for infinite area light
         path[0].pdfFwd =
-            InfiniteLightDensity(scene, lightDistr, lightToIndex, ray.d);
+            InfiniteLightDensity(scene, lightDistr, ray.d);
     }
     return nVertices + 1;
 }
@@ -227,8 +226,7 @@ Spectrum G(const Scene &scene, Sampler &sampler, const Vertex &v0,
 
 Float MISWeight(const Scene &scene, Vertex *lightVertices,
                 Vertex *cameraVertices, Vertex &sampled, int s, int t,
-                const Distribution1D &lightPdf,
-                const std::unordered_map<const Light *, size_t> &lightToIndex) {
+                const Distribution1D &lightPdf) {
     if (s + t == 2) return 1;
     Float sumRi = 0;
     // Define helper function _remap0_ that deals with Dirac delta functions
@@ -257,9 +255,9 @@ Float MISWeight(const Scene &scene, Vertex *lightVertices,
     // Update reverse density of vertex $\pt{}_{t-1}$
     ScopedAssignment<Float> a4;
     if (pt)
-        a4 = {&pt->pdfRev, s > 0 ? qs->Pdf(scene, qsMinus, *pt)
-                                 : pt->PdfLightOrigin(scene, *ptMinus, lightPdf,
-                                                      lightToIndex)};
+        a4 = {&pt->pdfRev,
+              s > 0 ? qs->Pdf(scene, qsMinus, *pt)
+                    : pt->PdfLightOrigin(scene, *ptMinus, lightPdf)};
 
     // Update reverse density of vertex $\pt{}_{t-2}$
     ScopedAssignment<Float> a5;
@@ -303,19 +301,12 @@ void BDPTIntegrator::Render(const Scene &scene) {
     std::unique_ptr<LightDistribution> lightDistribution =
         CreateLightSampleDistribution(lightSampleStrategy, scene);
 
-    // Compute a reverse mapping from light pointers to offsets into the
-    // scene lights vector (and, equivalently, offsets into
-    // lightDistr). Added after book text was finalized; this is critical
-    // to reasonable performance with 100s+ of light sources.
-    std::unordered_map<const Light *, size_t> lightToIndex;
-    for (size_t i = 0; i < scene.lights.size(); ++i)
-        lightToIndex[scene.lights[i].get()] = i;
-
     // Partition the image into tiles
     Film *film = camera->film;
+    film->BufferSpectralImage();
     const Bounds2i sampleBounds = film->GetSampleBounds();
     const Vector2i sampleExtent = sampleBounds.Diagonal();
-    const int tileSize = 16;
+    const int tileSize = Film::tileSize;
     const int nXTiles = (sampleExtent.x + tileSize - 1) / tileSize;
     const int nYTiles = (sampleExtent.y + tileSize - 1) / tileSize;
     ProgressReporter reporter(nXTiles * nYTiles, "Rendering");
@@ -383,8 +374,7 @@ void BDPTIntegrator::Render(const Scene &scene) {
                     // Now trace the light subpath
                     int nLight = GenerateLightSubpath(
                         scene, *tileSampler, arena, maxDepth + 1,
-                        cameraVertices[0].time(), *lightDistr, lightToIndex,
-                        lightVertices);
+                        cameraVertices[0].time(), *lightDistr, lightVertices);
 
                     // Execute all BDPT connection strategies
                     Spectrum L(0.f);
@@ -400,7 +390,7 @@ void BDPTIntegrator::Render(const Scene &scene) {
                             Float misWeight = 0.f;
                             Spectrum Lpath = ConnectBDPT(
                                 scene, lightVertices, cameraVertices, s, t,
-                                *lightDistr, lightToIndex, *camera, *tileSampler,
+                                *lightDistr, *camera, *tileSampler,
                                 &pFilmNew, &misWeight);
                             VLOG(2) << "Connect bdpt s: " << s <<", t: " << t <<
                                 ", Lpath: " << Lpath << ", misWeight: " << misWeight;
@@ -444,7 +434,6 @@ void BDPTIntegrator::Render(const Scene &scene) {
 Spectrum ConnectBDPT(
     const Scene &scene, Vertex *lightVertices, Vertex *cameraVertices, int s,
     int t, const Distribution1D &lightDistr,
-    const std::unordered_map<const Light *, size_t> &lightToIndex,
     const Camera &camera, Sampler &sampler, Point2f *pRaster,
     Float *misWeightPtr) {
     ProfilePhase _(Prof::BDPTConnectSubpaths);
@@ -498,7 +487,7 @@ Spectrum ConnectBDPT(
                 sampled =
                     Vertex::CreateLight(ei, lightWeight / (pdf * lightPdf), 0);
                 sampled.pdfFwd =
-                    sampled.PdfLightOrigin(scene, pt, lightDistr, lightToIndex);
+                    sampled.PdfLightOrigin(scene, pt, lightDistr);
                 L = pt.beta * pt.f(sampled, TransportMode::Radiance) * sampled.beta;
                 if (pt.IsOnSurface()) L *= AbsDot(wi, pt.ns());
                 // Only check visibility if the path would carry radiance.
@@ -525,7 +514,7 @@ Spectrum ConnectBDPT(
     // Compute MIS weight for connection strategy
     Float misWeight =
         L.IsBlack() ? 0.f : MISWeight(scene, lightVertices, cameraVertices,
-                                      sampled, s, t, lightDistr, lightToIndex);
+                                      sampled, s, t, lightDistr);
     VLOG(2) << "MIS weight for (s,t) = (" << s << ", " << t << ") connection: "
             << misWeight;
     DCHECK(!std::isnan(misWeight));
@@ -113,13 +113,11 @@ class ScopedAssignment {
 
 inline Float InfiniteLightDensity(
     const Scene &scene, const Distribution1D &lightDistr,
-    const std::unordered_map<const Light *, size_t> &lightToDistrIndex,
     const Vector3f &w) {
     Float pdf = 0;
     for (const auto &light : scene.infiniteLights) {
-        CHECK(lightToDistrIndex.find(light.get()) != lightToDistrIndex.end());
-        size_t index = lightToDistrIndex.find(light.get())->second;
-        pdf += light->Pdf_Li(Interaction(), -w) * lightDistr.func[index];
+        pdf += light->Pdf_Li(Interaction(), -w) *
+               lightDistr.func[light->sceneIndex];
     }
     return pdf / (lightDistr.funcInt * lightDistr.Count());
 }
@@ -222,13 +220,13 @@ struct Vertex {
             return GetInteraction().n;
     }
     bool IsOnSurface() const { return ng() != Normal3f(); }
-    Spectrum f(const Vertex &next, TransportMode mode) const {
+    Spectrum f(const Vertex &next, TransportMode mode, int wvl = 0) const {
         Vector3f wi = next.p() - p();
         if (wi.LengthSquared() == 0) return 0.;
         wi = Normalize(wi);
         switch (type) {
         case VertexType::Surface:
-            return si.bsdf->f(si.wo, wi) *
+            return si.bsdf->f(si.wo, wi, wvl) *
                 CorrectShadingNormal(si, si.wo, wi, mode);
         case VertexType::Medium:
             return mi.phase->p(mi.wo, wi);
@@ -275,7 +273,7 @@ struct Vertex {
             // Return emitted radiance for infinite light sources
             Spectrum Le(0.f);
             for (const auto &light : scene.infiniteLights)
-                Le += light->Le(Ray(p(), -w, Vector4f(0))); // TODO invalid wvl packet
+                Le += light->Le(Ray(p(), -w, ei.wvls));
             return Le;
         } else {
             const AreaLight *light = si.primitive->GetAreaLight();
@@ -336,7 +334,7 @@ struct Vertex {
         return pdf * invDist2;
     }
     Float Pdf(const Scene &scene, const Vertex *prev,
-              const Vertex &next) const {
+              const Vertex &next, int wvl = 0) const {
         if (type == VertexType::Light) return PdfLight(scene, next);
         // Compute directions to preceding and next vertex
         Vector3f wn = next.p() - p();
@@ -355,7 +353,7 @@ struct Vertex {
         if (type == VertexType::Camera)
             ei.camera->Pdf_We(ei.SpawnRay(wn), &unused, &pdf);
         else if (type == VertexType::Surface)
-            pdf = si.bsdf->Pdf(wp, wn);
+            pdf = si.bsdf->Pdf(wp, wn, wvl);
         else if (type == VertexType::Medium)
             pdf = mi.phase->p(wp, wn);
         else
@@ -392,16 +390,13 @@ struct Vertex {
         return pdf;
     }
     Float PdfLightOrigin(const Scene &scene, const Vertex &v,
-                         const Distribution1D &lightDistr,
-                         const std::unordered_map<const Light *, size_t>
-                             &lightToDistrIndex) const {
+                         const Distribution1D &lightDistr) const {
         Vector3f w = v.p() - p();
         if (w.LengthSquared() == 0) return 0.;
         w = Normalize(w);
         if (IsInfiniteLight()) {
             // Return solid angle density for infinite light sources
-            return InfiniteLightDensity(scene, lightDistr, lightToDistrIndex,
-                                        w);
+            return InfiniteLightDensity(scene, lightDistr, w);
         } else {
             // Return solid angle density for non-infinite light sources
             Float pdfPos, pdfDir, pdfChoice = 0;
@@ -414,9 +409,7 @@ struct Vertex {
             CHECK(light != nullptr);
 
             // Compute the discrete probability of sampling _light_, _pdfChoice_
-            CHECK(lightToDistrIndex.find(light) != lightToDistrIndex.end());
-            size_t index = lightToDistrIndex.find(light)->second;
-            pdfChoice = lightDistr.DiscretePDF(index);
+            pdfChoice = scene.LightPdf(light, &lightDistr);
 
             light->Pdf_Le(Ray(p(), w, Infinity, time()), ng(), &pdfPos, &pdfDir);
             return pdfPos * pdfChoice;
@@ -432,12 +425,10 @@ extern int GenerateCameraSubpath(const Scene &scene, Sampler &sampler,
 extern int GenerateLightSubpath(
     const Scene &scene, Sampler &sampler, MemoryArena &arena, int maxDepth,
     Float time, const Distribution1D &lightDistr,
-    const std::unordered_map<const Light *, size_t> &lightToIndex,
     Vertex *path);
 Spectrum ConnectBDPT(
     const Scene &scene, Vertex *lightVertices, Vertex *cameraVertices, int s,
     int t, const Distribution1D &lightDistr,
-    const std::unordered_map<const Light *, size_t> &lightToIndex,
     const Camera &camera, Sampler &sampler, Point2f *pRaster,
     Float *misWeight = nullptr);
 BDPTIntegrator *CreateBDPTIntegrator(const ParamSet &params,
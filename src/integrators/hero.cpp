@@ -38,6 +38,9 @@
 #include "stats.h"
 #include "parallel.h"
 #include "sampling.h"
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
 
 namespace pbrt {
 
@@ -47,31 +50,242 @@ inline Float rotateValue(Float sample, Float idx, Float nWvl) {
   return fmod(sample + (idx / nWvl), 1.0);
 }
 
+// Sensor response used to weight the wavelength sampling distribution; the
+// sum of the CIE matching functions keeps every visible bin reachable
+static Spectrum SensorResponse(const std::string &strategy) {
+  if (strategy == "y")
+    return Spectrum::FromSampled(CIE_lambda, CIE_Y, nCIESamples);
+  if (strategy == "xyz" || strategy == "lights")
+    return Spectrum::FromSampled(CIE_lambda, CIE_X, nCIESamples)
+         + Spectrum::FromSampled(CIE_lambda, CIE_Y, nCIESamples)
+         + Spectrum::FromSampled(CIE_lambda, CIE_Z, nCIESamples);
+  if (strategy != "power")
+    Warning("Wavelength sample strategy \"%s\" unknown. Using \"xyz\".",
+            strategy.c_str());
+  return strategy == "power" ? Spectrum(1.f) : SensorResponse("xyz");
+}
+
+// Scale a spectrum's bins so they sum to one
+static Spectrum NormalizeBins(const Spectrum &s) {
+  Float sum = 0.f;
+  for (int i = 0; i < Spectrum::nSamples; ++i) sum += s[i];
+  return sum > 0.f ? s / sum : Spectrum(0.f);
+}
+
 HeroSamplerIntegrator::HeroSamplerIntegrator(std::shared_ptr<const Camera> camera,
                                              std::shared_ptr<Sampler> sampler,
-                                             const Bounds2i &pixelBounds)
-: SamplerIntegrator(camera, sampler, pixelBounds) { }
+                                             const Bounds2i &pixelBounds,
+                                             const std::string &wvlSampleStrategy,
+                                             int spectralTrainingSpp)
+: SamplerIntegrator(camera, sampler, pixelBounds),
+  wvlSampleStrategy(wvlSampleStrategy),
+  spectralTrainingSpp(spectralTrainingSpp) { }
+
+// Whether two spectra normalized with _NormalizeBins()_ agree up to
+// round-off
+static bool SameBins(const Spectrum &a, const Spectrum &b) {
+  for (int i = 0; i < Spectrum::nSamples; ++i)
+    if (std::abs(a[i] - b[i]) > 1e-4f * (a[i] + b[i])) return false;
+  return true;
+}
+
+// Hash of normalized bins rounded to a grid much coarser than round-off, so
+// that spectra for which _SameBins()_ holds almost always share a key
+static uint64_t BinsKey(const Spectrum &s) {
+  uint64_t key = 14695981039346656037ull;
+  for (int i = 0; i < Spectrum::nSamples; ++i)
+    key = (key ^ (uint64_t)std::llround(s[i] * (1 << 16))) * 1099511628211ull;
+  return key;
+}
 
-void HeroSamplerIntegrator::Preprocess(const Scene &scene, 
+void HeroSamplerIntegrator::Preprocess(const Scene &scene,
                                        Sampler &sampler) {
   SamplerIntegrator::Preprocess(scene, sampler);
 
-  // An extremely simple distribution is just the mean of light spectral emissions
+  const Spectrum response = SensorResponse(wvlSampleStrategy);
+  if (wvlSampleStrategy == "lights") {
+    /* Emitter-conditioned sampling: each camera sample picks one of the
+       distinct spectra emitted by the lights, weighted by the sensor
+       response, and draws its whole packet from that spectrum's CDF. Lights
+       with the same spectrum, such as the shapes of an area-lit mesh, share
+       one CDF, and the response alone serves as a defensive technique. All
+       techniques are equally likely to be picked, so that a dim but peaky
+       emitter still has its lines sampled; the choice doesn't otherwise
+       depend on power, so a very bright broadband light gets no more
+       samples than a faint one. Each wavelength is weighted with the
+       balance heuristic over the emitter choice, whose density is that of
+       the mixture of all techniques. */
+    std::vector<Spectrum> spectra;
+    std::unordered_multimap<uint64_t, int> spectrumIndices;
+    auto addSpectrum = [&](const Spectrum &s) {
+      uint64_t key = BinsKey(s);
+      auto range = spectrumIndices.equal_range(key);
+      for (auto it = range.first; it != range.second; ++it)
+        if (SameBins(s, spectra[it->second])) return;
+      spectrumIndices.insert(std::make_pair(key, (int)spectra.size()));
+      spectra.push_back(s);
+    };
+    addSpectrum(NormalizeBins(response));
+    for (const auto &light : scene.lights) {
+      Spectrum s = NormalizeBins(light->Power().Clamp() * response);
+      if (!s.IsBlack()) addSpectrum(s);
+    }
+    Spectrum mixture(0.f);
+    emitterDistributions.clear();
+    for (const Spectrum &s : spectra) {
+      mixture += s / Float(spectra.size());
+      emitterDistributions.push_back(SpectralDistribution(s));
+    }
+    spectralDistribution = SpectralDistribution(mixture);
+    return;
+  }
+
+  // Weigh the summed spectral emission of all lights by the sensor response
   Spectrum s(0.f);
   for (const auto &light : scene.lights) {
     s += light->Power();
   }
-  spectralDistribution = SpectralDistribution(s); // TODO use built-in Distribution1D class
+  s *= response;
+  spectralDistribution = SpectralDistribution(s.Clamp());
+}
+
+void HeroSamplerIntegrator::TrainSpectralDistribution(const Scene &scene) {
+  // Render the first _spectralTrainingSpp_ samples of every pixel with the
+  // prior distribution, and accumulate response-weighted contributions per bin
+  const Spectrum response = SensorResponse(wvlSampleStrategy == "power" ? 
+                                           "xyz" : wvlSampleStrategy);
+  Bounds2i sampleBounds = camera->film->GetSampleBounds();
+  Vector2i sampleExtent = sampleBounds.Diagonal();
+  const int tileSize = Film::tileSize;
+  Point2i nTiles((sampleExtent.x + tileSize - 1) / tileSize,
+                  (sampleExtent.y + tileSize - 1) / tileSize);
+  std::mutex contribMutex;
+  Spectrum contrib(0.f);
+  ProgressReporter reporter(nTiles.x * nTiles.y, "Training spectra");
+  ParallelFor2D([&](Point2i tile) {
+    MemoryArena arena;
+    int seed = nTiles.x * nTiles.y + tile.y * nTiles.x + tile.x;
+    std::unique_ptr<Sampler> tileSampler = sampler->Clone(seed);
+    int x0 = sampleBounds.pMin.x + tile.x * tileSize;
+    int x1 = std::min(x0 + tileSize, sampleBounds.pMax.x);
+    int y0 = sampleBounds.pMin.y + tile.y * tileSize;
+    int y1 = std::min(y0 + tileSize, sampleBounds.pMax.y);
+    Bounds2i tileBounds(Point2i(x0, y0), Point2i(x1, y1));
+
+    Spectrum tileContrib(0.f);
+    for (Point2i pixel : tileBounds) {
+      tileSampler->StartPixel(pixel);
+      if (!InsideExclusive(pixel, pixelBounds)) continue;
+      int n = 0;
+      do {
+        CameraSample cameraSample = tileSampler->GetCameraSample(pixel);
+        RayDifferential ray;
+        Float rayWeight = camera->GenerateRayDifferential(cameraSample, &ray);
+        ray.wvls = SampleWvls(cameraSample.wvl);
+        Spectrum L(0.f);
+        if (rayWeight > 0) L = Li(ray, scene, *tileSampler, arena);
+        if (!L.HasNaNs() && !std::isinf(L.y()))
+          tileContrib += L.Clamp() * rayWeight;
+        arena.Reset();
+      } while (++n < spectralTrainingSpp && tileSampler->StartNextSample());
+    }
+
+    std::lock_guard<std::mutex> lock(contribMutex);
+    contrib += tileContrib;
+    reporter.Update();
+  }, nTiles);
+  reporter.Done();
+
+  // Blend the learned distribution with the prior, so that bins which happened
+  // to receive no energy during training remain reachable
+  Spectrum prior(0.f);
+  for (int i = 0; i < Spectrum::nSamples; ++i)
+    prior[i] = spectralDistribution.Pdf(i);
+  Spectrum learned = NormalizeBins(contrib * response);
+  if (learned.IsBlack()) return;
+  spectralDistribution = SpectralDistribution(learned * .75f + prior * .25f);
+  // Every packet is drawn from the trained distribution from now on
+  emitterDistributions.clear();
+  VLOG(1) << "Trained spectral distribution: " << spectralDistribution;
+}
+
+WvlPacketf HeroSamplerIntegrator::SampleWvls(Float u) {
+  // Pick the emitter CDF for the whole packet, if any, and remap _u_
+  const SpectralDistribution *distrib = &spectralDistribution;
+  if (!emitterDistributions.empty()) {
+    const int n = emitterDistributions.size();
+    const int k = std::min(int(u * n), n - 1);
+    u = std::min(u * n - k, OneMinusEpsilon);
+    distrib = &emitterDistributions[k];
+  }
+  WvlPacketf wvls;
+  for (int i = 0; i < nWvls; ++i) {
+    /* 
+      This trick showed up first in:
+      *West et al., 2020. Continuous Multiple Importance Sampling.*
+      Much better sampling performance by rotating uniform samples and mapping 
+      those to a spectral distribution, than rotating wavelengths. 
+    */
+    const Float sample = rotateValue(u, i, nWvls);
+    wvls[i] = distrib->sampleWavelength(sample);
+  }
+  return wvls;
+}
+
+WvlPacketf HeroSamplerIntegrator::WvlDensities(const WvlPacketf &wvls) const {
+  // Convert the discrete bin probabilities to densities over wavelength
+  const Float invBinWidth = Spectrum::nSamples 
+                          / (sampledLambdaEnd - sampledLambdaStart);
+  WvlPacketf pdfs;
+  for (int i = 0; i < nWvls; ++i)
+    pdfs[i] = spectralDistribution.Pdf(Spectrum::indexFromWavelength(wvls[i]))
+            * invBinWidth;
+  return pdfs;
+}
+
+void HeroSamplerIntegrator::AddToPacket(WvlPacketf &Lo, Spectrum *Lfull,
+                                        const Spectrum &L,
+                                        const WvlPacketi &wvlIdx,
+                                        bool isWvlDependent) {
+  /* A full-spectrum contribution is known in every bin, so it goes to the
+     film as is instead of being estimated at the packet wavelengths */
+  if (!isWvlDependent) {
+    *Lfull += L;
+    return;
+  }
+  for (int i = 0; i < nWvls; ++i) {
+    // Contribution is nonzero only in the packet bins, summed over the
+    // wavelengths sharing a bin; split it evenly between them
+    int nShared = 0;
+    for (int j = 0; j < nWvls; ++j) nShared += wvlIdx[j] == wvlIdx[i];
+    Lo[i] += L[wvlIdx[i]] / nShared;
+  }
+}
+
+Spectrum HeroSamplerIntegrator::Li(const RayDifferential &ray,
+                                   const Scene &scene, Sampler &sampler,
+                                   MemoryArena &arena, int depth) const {
+  // Scatter the packet estimate into the bins of its wavelengths, on top of
+  // the full-spectrum contributions
+  Spectrum s(0.f);
+  WvlPacketf L = LiWvls(ray, scene, sampler, arena, &s, depth);
+  for (int i = 0; i < nWvls; ++i) {
+    const int idx = Spectrum::indexFromWavelength(ray.wvls[i]);
+    const Float pdf = spectralDistribution.Pdf(idx);
+    if (pdf > 0) s[idx] += L[i] / pdf;
+  }
+  return s;
 }
 
 void HeroSamplerIntegrator::Render(const Scene &scene) {
   Preprocess(scene, *sampler);
+  if (spectralTrainingSpp > 0) TrainSpectralDistribution(scene);
 
   // Render image tiles in parallel
   // Compute number of tiles, _nTiles_, to use for parallel rendering
   Bounds2i sampleBounds = camera->film->GetSampleBounds();
   Vector2i sampleExtent = sampleBounds.Diagonal();
-  const int tileSize = 16;
+  const int tileSize = Film::tileSize;
   Point2i nTiles((sampleExtent.x + tileSize - 1) / tileSize,
                   (sampleExtent.y + tileSize - 1) / tileSize);
   ProgressReporter reporter(nTiles.x * nTiles.y, "Rendering");
@@ -122,49 +336,51 @@ void HeroSamplerIntegrator::Render(const Scene &scene) {
 
 
           // Sample wavelengths from a prior spectral distribution
-          for (int i = 0; i < 4; ++i) {
-            /* 
-              This trick showed up first in:
-              *West et al., 2020. Continuous Multiple Importance Sampling.*
-              Much better sampling performance by rotating uniform samples and mapping 
-              those to a spectral distribution, than rotating wavelengths. 
-            */
-            const Float sample = rotateValue(cameraSample.wvl, i, 4);
-            ray.wvls[i] = spectralDistribution.sampleWavelength(sample);
-          }
+          ray.wvls = SampleWvls(cameraSample.wvl);
 
-          // Evaluate radiance along camera ray
-          Spectrum L(0.f);
-          if (rayWeight > 0) L = Li(ray, scene, *tileSampler, arena);
+          // Evaluate radiance along camera ray for the packet wavelengths
+          WvlPacketf L(0.f);
+          Spectrum Lfull(0.f);
+          if (rayWeight > 0)
+            L = LiWvls(ray, scene, *tileSampler, arena, &Lfull);
 
           // Issue warning if unexpected radiance value returned
-          if (L.HasNaNs()) {
+          Float Lmin = L[0], Lmax = L[0];
+          for (int i = 1; i < nWvls; ++i) {
+            Lmin = std::min(Lmin, L[i]);
+            Lmax = std::max(Lmax, L[i]);
+          }
+          if (L.HasNaNs() || Lfull.HasNaNs()) {
             LOG(ERROR) << StringPrintf(
               "Not-a-number radiance value returned "
               "for pixel (%d, %d), sample %d. Setting to black.",
               pixel.x, pixel.y,
               (int)tileSampler->CurrentSampleNumber());
-            L = Spectrum(0.f);
-          } else if (L.y() < -1e-5) {
+            L = WvlPacketf(0.f);
+            Lfull = Spectrum(0.f);
+          } else if (Lmin < -1e-5 || Lfull.y() < -1e-5) {
             LOG(ERROR) << StringPrintf(
-              "Negative luminance value, %f, returned "
+              "Negative radiance value, %f, returned "
               "for pixel (%d, %d), sample %d. Setting to black.",
-              L.y(), pixel.x, pixel.y,
+              std::min(Lmin, Lfull.y()), pixel.x, pixel.y,
               (int)tileSampler->CurrentSampleNumber());
-            L = Spectrum(0.f);
-          } else if (std::isinf(L.y())) {
+            L = WvlPacketf(0.f);
+            Lfull = Spectrum(0.f);
+          } else if (std::isinf(Lmax) || std::isinf(Lfull.y())) {
               LOG(ERROR) << StringPrintf(
-              "Infinite luminance value returned "
+              "Infinite radiance value returned "
               "for pixel (%d, %d), sample %d. Setting to black.",
               pixel.x, pixel.y,
               (int)tileSampler->CurrentSampleNumber());
-            L = Spectrum(0.f);
+            L = WvlPacketf(0.f);
+            Lfull = Spectrum(0.f);
           }
           VLOG(1) << "Camera sample: " << cameraSample << " -> ray: " <<
-              ray << " -> L = " << L;
+              ray << " -> L = " << L << ", Lfull = " << Lfull;
 
-          // Add camera ray's contribution to image
-          filmTile->AddSample(cameraSample.pFilm, L, rayWeight);
+          // Add camera ray's contribution to image, directly in $XYZ$
+          filmTile->AddSample(cameraSample.pFilm, ray.wvls, L,
+                              WvlDensities(ray.wvls), Lfull, rayWeight);
 
           // Free _MemoryArena_ memory from computing image sample value
           arena.Reset();
@@ -49,15 +49,39 @@ public:
   // HeroSamplerIntegrator public methods
   HeroSamplerIntegrator(std::shared_ptr<const Camera> camera,
                         std::shared_ptr<Sampler> sampler,
-                        const Bounds2i &pixelBounds);
+                        const Bounds2i &pixelBounds,
+                        const std::string &wvlSampleStrategy = "xyz",
+                        int spectralTrainingSpp = 0);
   void Preprocess(const Scene &scene, 
                   Sampler &sampler);
   void Render(const Scene &scene);
+  Spectrum Li(const RayDifferential &ray, const Scene &scene,
+              Sampler &sampler, MemoryArena &arena, int depth = 0) const final;
 
-  const static int nWvls = 4; // set to 4 to enable HWSS; 1 otherwise
+  // Radiance carried along _ray_ for each of its packet wavelengths, not yet
+  // divided by the wavelengths' sampling densities; contributions that don't
+  // depend on the wavelengths are added to _Lfull_ over the whole spectrum
+  virtual WvlPacketf LiWvls(const RayDifferential &ray, const Scene &scene,
+                            Sampler &sampler, MemoryArena &arena,
+                            Spectrum *Lfull, int depth = 0) const = 0;
+
+  // Wavelengths carried per camera ray; set through PBRT_WAVELENGTH_PACKET_SIZE
+  const static int nWvls = nPacketWavelengths;
 protected:
+  // HeroSamplerIntegrator protected methods
+  void TrainSpectralDistribution(const Scene &scene);
+  WvlPacketf SampleWvls(Float u);
+  WvlPacketf WvlDensities(const WvlPacketf &wvls) const;
+  static void AddToPacket(WvlPacketf &Lo, Spectrum *Lfull, const Spectrum &L,
+                          const WvlPacketi &wvlIdx, bool isWvlDependent);
+
   // HeroSamplerIntegrator protected components
+  // Marginal density of every sampled wavelength
   SpectralDistribution spectralDistribution;
+  // Per-emitter CDFs that "lights" sampling draws whole packets from
+  std::vector<SpectralDistribution> emitterDistributions;
+  const std::string wvlSampleStrategy;
+  const int spectralTrainingSpp;
 };
 
 } // namespace pbrt
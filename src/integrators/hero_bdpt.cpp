@@ -0,0 +1,607 @@
+/*
+    pbrt source code is Copyright(c) 1998-2016
+                        Matt Pharr, Greg Humphreys, and Wenzel Jakob.
+
+    This file is part of pbrt.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are
+    met:
+
+    - Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    - Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+    IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+    TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+    PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include "integrators/hero_bdpt.h"
+#include "integrators/bdpt.h"
+#include "camera.h"
+#include "film.h"
+#include "interaction.h"
+#include "light.h"
+#include "medium.h"
+#include "paramset.h"
+#include "parallel.h"
+#include "progressreporter.h"
+#include "sampler.h"
+#include "scene.h"
+#include "stats.h"
+
+namespace pbrt {
+
+STAT_PERCENT("Integrator/Zero-radiance paths", zeroRadiancePaths, totalPaths);
+STAT_INT_DISTRIBUTION("Integrator/Path length", pathLength);
+
+/* Subpath vertex for a wavelength packet. The wrapped _Vertex_ holds the 
+   geometry and the hero wavelength's scattering functions; the packets hold the
+   throughput of every wavelength divided by the hero's sampling densities, and
+   the densities with which each wavelength would have generated the vertex. */
+struct HeroVertex {
+  HeroVertex() : beta(0.f), pdfFwd(0.f), pdfRev(0.f), wvlRatio(1.f) {}
+
+  Vertex v;
+  WvlPacketf beta;
+  WvlPacketf pdfFwd, pdfRev;
+  // Density of the subpath up to this vertex for each wavelength, relative
+  // to the density of the hero wavelength
+  WvlPacketf wvlRatio;
+};
+
+static HeroVertex CreateHeroVertex(const Vertex &v, const WvlPacketf &beta,
+                                   const WvlPacketf &pdfFwd,
+                                   const WvlPacketf &wvlRatio) {
+  HeroVertex hv;
+  hv.v = v;
+  hv.beta = beta;
+  hv.pdfFwd = pdfFwd;
+  hv.wvlRatio = wvlRatio;
+  return hv;
+}
+
+// Convert the solid angle densities _pdf_ at _from_ to area densities at _to_
+static WvlPacketf ConvertDensities(const Vertex &from, const WvlPacketf &pdf,
+                                   const Vertex &to) {
+  WvlPacketf area;
+  for (int i = 0; i < nPacketWavelengths; ++i)
+    area[i] = from.ConvertDensity(pdf[i], to);
+  return area;
+}
+
+// Scattering at _vertex_ towards _next_ for each wavelength; dispersive 
+// surfaces are evaluated with every wavelength's own index of refraction
+static WvlPacketf FWvls(const HeroVertex &vertex, const HeroVertex &next,
+                        TransportMode mode, const WvlPacketf &wvls) {
+  if (vertex.v.type != VertexType::Surface)
+    return SpectrumAtWvls(vertex.v.f(next.v, mode), wvls);
+  const SurfaceInteraction &si = vertex.v.si;
+  Vector3f wi = next.v.p() - vertex.v.p();
+  if (wi.LengthSquared() == 0) return WvlPacketf(0.f);
+  wi = Normalize(wi);
+  WvlPacketi wvlIdx;
+  for (int i = 0; i < nPacketWavelengths; ++i)
+    wvlIdx[i] = Spectrum::indexFromWavelength(wvls[i]);
+  return si.bsdf->fWvls(si.wo, wi, wvlIdx) * 
+         CorrectShadingNormal(si, si.wo, wi, mode);
+}
+
+static WvlPacketf HeroG(const Scene &scene, Sampler &sampler,
+                        const HeroVertex &v0, const HeroVertex &v1) {
+  Vector3f d = v0.v.p() - v1.v.p();
+  Float g = 1 / d.LengthSquared();
+  d *= std::sqrt(g);
+  if (v0.v.IsOnSurface()) g *= AbsDot(v0.v.ns(), d);
+  if (v1.v.IsOnSurface()) g *= AbsDot(v1.v.ns(), d);
+  VisibilityTester vis(v0.v.GetInteraction(), v1.v.GetInteraction());
+  return vis.TrWvls(scene, sampler) * g;
+}
+
+static int HeroRandomWalk(const Scene &scene, RayDifferential ray, 
+                          Sampler &sampler, MemoryArena &arena, 
+                          WvlPacketf beta, Float pdf, int maxDepth,
+                          TransportMode mode, HeroVertex *path) {
+  if (maxDepth == 0) return 0;
+  int bounces = 0;
+  WvlPacketi wvlIdx;
+  for (int i = 0; i < nPacketWavelengths; ++i)
+    wvlIdx[i] = Spectrum::indexFromWavelength(ray.wvls[i]);
+  // Declare variables for forward and reverse probability densities
+  WvlPacketf pdfFwd(pdf), pdfRev(0.f), wvlRatio(1.f);
+  while (true) {
+    // Trace a ray and sample the medium, if any, with the hero wavelength
+    MediumInteraction mi;
+    SurfaceInteraction isect;
+    bool foundIntersection = scene.Intersect(ray, &isect);
+    if (ray.medium) {
+      /* Like the BSDF below, divide by the hero's distance density and keep
+         every wavelength's density relative to it. As in _BDPTIntegrator_,
+         the area densities leave out the distance densities, which the
+         forward and reverse directions share. */
+      WvlPacketf mediumPdf;
+      WvlPacketf f = ray.medium->SampleWvls(ray, sampler, arena, &mi, &mediumPdf);
+      const Float heroPdf = mediumPdf[0];
+      if (heroPdf == 0.f) break;
+      beta *= f / heroPdf;
+      wvlRatio *= mediumPdf / heroPdf;
+    }
+    if (beta == WvlPacketf(0.f)) break;
+    HeroVertex &vertex = path[bounces], &prev = path[bounces - 1];
+    if (mi.IsValid()) {
+      // Record medium interaction in _path_ and compute forward density
+      Vertex v = Vertex::CreateMedium(mi, Spectrum(beta[0]), pdfFwd[0], prev.v);
+      vertex = CreateHeroVertex(v, beta, ConvertDensities(prev.v, pdfFwd, v), 
+                                wvlRatio);
+      if (++bounces >= maxDepth) break;
+
+      // Sample direction and compute reverse density at preceding vertex
+      Vector3f wi;
+      pdfFwd = pdfRev = WvlPacketf(mi.phase->Sample_p(-ray.d, &wi, 
+                                                      sampler.Get2D()));
+      ray = mi.SpawnRay(wi);
+    } else {
+      // Handle surface interaction for path generation
+      if (!foundIntersection) {
+        // Capture escaped rays when tracing from the camera
+        if (mode == TransportMode::Radiance) {
+          vertex = CreateHeroVertex(
+            Vertex::CreateLight(EndpointInteraction(ray), Spectrum(beta[0]),
+                                pdfFwd[0]),
+            beta, pdfFwd, wvlRatio);
+          ++bounces;
+        }
+        break;
+      }
+
+      // Compute scattering functions for _mode_ and skip over medium
+      // boundaries
+      isect.ComputeScatteringFunctions(ray, arena, true, mode);
+      if (!isect.bsdf) {
+        ray = isect.SpawnRay(ray.d);
+        continue;
+      }
+
+      // Initialize _vertex_ with surface intersection information
+      Vertex v = Vertex::CreateSurface(isect, Spectrum(beta[0]), pdfFwd[0], 
+                                       prev.v);
+      vertex = CreateHeroVertex(v, beta, ConvertDensities(prev.v, pdfFwd, v),
+                                wvlRatio);
+      if (++bounces >= maxDepth) break;
+
+      /* Sample BSDF with the hero wavelength; the packet query evaluates the
+         other wavelengths along the hero's direction. Lanes that a dispersive
+         refraction sends elsewhere come back with zero density. */
+      Vector3f wi, wo = isect.wo;
+      BxDFType type;
+      WvlPacketf f = isect.bsdf->Sample_fWvls(wo, &wi, sampler.Get2D(), wvlIdx,
+                                              &pdfFwd, BSDF_ALL, &type);
+      const Float heroPdf = pdfFwd[0];
+      if (f == WvlPacketf(0.f) || heroPdf == 0.f) break;
+      const Float cosTheta = AbsDot(wi, isect.shading.n) * 
+                             CorrectShadingNormal(isect, wo, wi, mode);
+      beta *= f * (cosTheta / heroPdf);
+      wvlRatio *= pdfFwd / heroPdf;
+      pdfRev = isect.bsdf->PdfWvls(wi, wo);
+      if (type & BSDF_SPECULAR) {
+        vertex.v.delta = true;
+        pdfFwd = pdfRev = WvlPacketf(0.f);
+      }
+      ray = isect.SpawnRay(wi);
+    }
+
+    // Compute reverse area density at preceding vertex
+    prev.pdfRev = ConvertDensities(vertex.v, pdfRev, prev.v);
+    prev.v.pdfRev = prev.pdfRev[0];
+  }
+  return bounces;
+}
+
+static int GenerateHeroCameraSubpath(const Scene &scene, Sampler &sampler,
+                                     MemoryArena &arena, int maxDepth,
+                                     const Camera &camera, 
+                                     const RayDifferential &ray,
+                                     Float rayWeight, HeroVertex *path) {
+  if (maxDepth == 0) return 0;
+  ProfilePhase _(Prof::BDPTGenerateSubpath);
+  // Generate first vertex on camera subpath and start random walk
+  Float pdfPos, pdfDir;
+  path[0] = CreateHeroVertex(
+    Vertex::CreateCamera(&camera, ray, Spectrum(rayWeight)),
+    WvlPacketf(rayWeight), WvlPacketf(0.f), WvlPacketf(1.f));
+  camera.Pdf_We(ray, &pdfPos, &pdfDir);
+  return HeroRandomWalk(scene, ray, sampler, arena, WvlPacketf(rayWeight), 
+                        pdfDir, maxDepth - 1, TransportMode::Radiance, 
+                        path + 1) + 1;
+}
+
+static int GenerateHeroLightSubpath(
+  const Scene &scene, Sampler &sampler, MemoryArena &arena, int maxDepth,
+  Float time, const WvlPacketf &wvls, const Distribution1D &lightDistr,
+  HeroVertex *path) {
+  if (maxDepth == 0) return 0;
+  ProfilePhase _(Prof::BDPTGenerateSubpath);
+  // Sample initial ray for light subpath
+  Float lightPdf;
+  int lightNum = lightDistr.SampleDiscrete(sampler.Get1D(), &lightPdf);
+  const std::shared_ptr<Light> &light = scene.lights[lightNum];
+  RayDifferential ray;
+  Normal3f nLight;
+  Float pdfPos, pdfDir;
+  Spectrum Le = light->Sample_Le(sampler.Get2D(), sampler.Get2D(), time, &ray,
+                                 &nLight, &pdfPos, &pdfDir);
+  if (pdfPos == 0 || pdfDir == 0 || Le.IsBlack()) return 0;
+
+  // Emit the wavelengths of the camera subpath
+  ray.wvls = wvls;
+  const WvlPacketf LeWvls = SpectrumAtWvls(Le, wvls);
+
+  // Generate first vertex on light subpath and start random walk
+  path[0] = CreateHeroVertex(
+    Vertex::CreateLight(light.get(), ray, nLight, Le, pdfPos * lightPdf),
+    LeWvls, WvlPacketf(pdfPos * lightPdf), WvlPacketf(1.f));
+  WvlPacketf beta = LeWvls * (AbsDot(nLight, ray.d) / 
+                              (lightPdf * pdfPos * pdfDir));
+  int nVertices = HeroRandomWalk(scene, ray, sampler, arena, beta, pdfDir, 
+                                 maxDepth - 1, TransportMode::Importance, 
+                                 path + 1);
+
+  // Correct subpath sampling densities for infinite area lights
+  if (path[0].v.IsInfiniteLight()) {
+    // Set spatial density of _path[1]_ for infinite area light
+    if (nVertices > 0) {
+      path[1].v.pdfFwd = pdfPos;
+      if (path[1].v.IsOnSurface())
+        path[1].v.pdfFwd *= AbsDot(ray.d, path[1].v.ng());
+      path[1].pdfFwd = WvlPacketf(path[1].v.pdfFwd);
+    }
+
+    // Set spatial density of _path[0]_ for infinite area light
+    path[0].v.pdfFwd = 
+      InfiniteLightDensity(scene, lightDistr, ray.d);
+    path[0].pdfFwd = WvlPacketf(path[0].v.pdfFwd);
+  }
+  return nVertices + 1;
+}
+
+/* Balance heuristic over all strategies and all wavelengths of the packet. For
+   every wavelength, the densities of the other strategies follow from the ratio
+   chains of _MISWeight()_ evaluated with that wavelength's vertex densities;
+   the wavelength's density of the current strategy, relative to the hero's,
+   is the product of the two subpaths' _wvlRatio_. */
+static Float HeroMISWeight(
+  const Scene &scene, HeroVertex *lightVertices, HeroVertex *cameraVertices,
+  HeroVertex &sampled, int s, int t, const Distribution1D &lightPdf) {
+  // Define helper function _remap0_ that deals with Dirac delta functions
+  auto remap0 = [](Float f) -> Float { return f != 0 ? f : 1; };
+
+  // Look up connection vertices and their predecessors
+  HeroVertex *qs = s > 0 ? &lightVertices[s - 1] : nullptr,
+             *pt = t > 0 ? &cameraVertices[t - 1] : nullptr,
+             *qsMinus = s > 1 ? &lightVertices[s - 2] : nullptr,
+             *ptMinus = t > 1 ? &cameraVertices[t - 2] : nullptr;
+
+  // Update sampled vertex for $s=1$ or $t=1$ strategy
+  ScopedAssignment<HeroVertex> a1;
+  if (s == 1)
+    a1 = {qs, sampled};
+  else if (t == 1)
+    a1 = {pt, sampled};
+
+  // Mark connection vertices as non-degenerate
+  ScopedAssignment<bool> a2, a3;
+  if (pt) a2 = {&pt->v.delta, false};
+  if (qs) a3 = {&qs->v.delta, false};
+
+  Float sumPdf = 0;
+  for (int j = 0; j < nPacketWavelengths; ++j) {
+    const Float wvlRatio = (qs ? qs->wvlRatio[j] : 1) * pt->wvlRatio[j];
+    if (wvlRatio == 0) continue;
+    Float sumRi = 0;
+    if (s + t > 2) {
+      // Update reverse densities of the connection vertices and their
+      // predecessors for wavelength _j_
+      ScopedAssignment<Float> a4, a5, a6, a7;
+      a4 = {&pt->pdfRev[j], 
+            s > 0 ? qs->v.Pdf(scene, qsMinus ? &qsMinus->v : nullptr, pt->v, j)
+                  : pt->v.PdfLightOrigin(scene, ptMinus->v, lightPdf)};
+      if (ptMinus)
+        a5 = {&ptMinus->pdfRev[j], s > 0 ? pt->v.Pdf(scene, &qs->v, 
+                                                     ptMinus->v, j)
+                                         : pt->v.PdfLight(scene, ptMinus->v)};
+      if (qs) 
+        a6 = {&qs->pdfRev[j], pt->v.Pdf(scene, ptMinus ? &ptMinus->v : nullptr,
+                                        qs->v, j)};
+      if (qsMinus) 
+        a7 = {&qsMinus->pdfRev[j], qs->v.Pdf(scene, &pt->v, qsMinus->v, j)};
+
+      // Consider hypothetical connection strategies along the camera subpath
+      Float ri = 1;
+      for (int i = t - 1; i > 0; --i) {
+        ri *= remap0(cameraVertices[i].pdfRev[j]) / 
+              remap0(cameraVertices[i].pdfFwd[j]);
+        if (!cameraVertices[i].v.delta && !cameraVertices[i - 1].v.delta)
+          sumRi += ri;
+      }
+
+      // Consider hypothetical connection strategies along the light subpath
+      ri = 1;
+      for (int i = s - 1; i >= 0; --i) {
+        ri *= remap0(lightVertices[i].pdfRev[j]) / 
+              remap0(lightVertices[i].pdfFwd[j]);
+        bool deltaLightvertex = i > 0 ? lightVertices[i - 1].v.delta
+                                      : lightVertices[0].v.IsDeltaLight();
+        if (!lightVertices[i].v.delta && !deltaLightvertex) sumRi += ri;
+      }
+    }
+    sumPdf += wvlRatio * (1 + sumRi);
+  }
+  return sumPdf > 0 ? 1 / sumPdf : 0;
+}
+
+static WvlPacketf ConnectHeroBDPT(
+  const Scene &scene, HeroVertex *lightVertices, HeroVertex *cameraVertices,
+  int s, int t, const Distribution1D &lightDistr,
+  const Camera &camera, Sampler &sampler, const WvlPacketf &wvls,
+  Point2f *pRaster) {
+  ProfilePhase _(Prof::BDPTConnectSubpaths);
+  WvlPacketf L(0.f);
+  // Ignore invalid connections related to infinite area lights
+  if (t > 1 && s != 0 && cameraVertices[t - 1].v.type == VertexType::Light)
+    return L;
+
+  // Perform connection and write contribution to _L_
+  HeroVertex sampled;
+  if (s == 0) {
+    // Interpret the camera subpath as a complete path
+    const HeroVertex &pt = cameraVertices[t - 1];
+    if (pt.v.IsLight())
+      L = pt.beta * SpectrumAtWvls(pt.v.Le(scene, cameraVertices[t - 2].v), 
+                                   wvls);
+  } else if (t == 1) {
+    // Sample a point on the camera and connect it to the light subpath
+    const HeroVertex &qs = lightVertices[s - 1];
+    if (qs.v.IsConnectible()) {
+      VisibilityTester vis;
+      Vector3f wi;
+      Float pdf;
+      Spectrum Wi = camera.Sample_Wi(qs.v.GetInteraction(), sampler.Get2D(),
+                                     &wi, &pdf, pRaster, &vis);
+      if (pdf > 0 && !Wi.IsBlack()) {
+        sampled = CreateHeroVertex(
+          Vertex::CreateCamera(&camera, vis.P1(), Wi / pdf),
+          SpectrumAtWvls(Wi / pdf, wvls), WvlPacketf(0.f), WvlPacketf(1.f));
+        L = qs.beta * FWvls(qs, sampled, TransportMode::Importance, wvls) * 
+            sampled.beta;
+        if (qs.v.IsOnSurface()) L *= AbsDot(wi, qs.v.ns());
+        if (L != WvlPacketf(0.f)) L *= vis.TrWvls(scene, sampler);
+      }
+    }
+  } else if (s == 1) {
+    // Sample a point on a light and connect it to the camera subpath
+    const HeroVertex &pt = cameraVertices[t - 1];
+    if (pt.v.IsConnectible()) {
+      Float lightPdf;
+      VisibilityTester vis;
+      Vector3f wi;
+      Float pdf;
+      int lightNum = lightDistr.SampleDiscrete(sampler.Get1D(), &lightPdf);
+      const std::shared_ptr<Light> &light = scene.lights[lightNum];
+      Spectrum lightWeight = light->Sample_Li(
+        pt.v.GetInteraction(), sampler.Get2D(), &wi, &pdf, &vis);
+      if (pdf > 0 && !lightWeight.IsBlack()) {
+        EndpointInteraction ei(vis.P1(), light.get());
+        sampled.v = Vertex::CreateLight(ei, lightWeight / (pdf * lightPdf), 0);
+        sampled.v.pdfFwd = 
+          sampled.v.PdfLightOrigin(scene, pt.v, lightDistr);
+        sampled.beta = SpectrumAtWvls(lightWeight, wvls) / (pdf * lightPdf);
+        sampled.pdfFwd = WvlPacketf(sampled.v.pdfFwd);
+        L = pt.beta * FWvls(pt, sampled, TransportMode::Radiance, wvls) * 
+            sampled.beta;
+        if (pt.v.IsOnSurface()) L *= AbsDot(wi, pt.v.ns());
+        // Only check visibility if the path would carry radiance.
+        if (L != WvlPacketf(0.f)) L *= vis.TrWvls(scene, sampler);
+      }
+    }
+  } else {
+    // Handle all other bidirectional connection cases
+    const HeroVertex &qs = lightVertices[s - 1], &pt = cameraVertices[t - 1];
+    if (qs.v.IsConnectible() && pt.v.IsConnectible()) {
+      L = qs.beta * FWvls(qs, pt, TransportMode::Importance, wvls) * 
+          FWvls(pt, qs, TransportMode::Radiance, wvls) * pt.beta;
+      if (L != WvlPacketf(0.f)) L *= HeroG(scene, sampler, qs, pt);
+    }
+  }
+
+  ++totalPaths;
+  if (L == WvlPacketf(0.f)) {
+    ++zeroRadiancePaths;
+    return L;
+  }
+  ReportValue(pathLength, s + t - 2);
+
+  // Compute MIS weight for connection strategy
+  Float misWeight = HeroMISWeight(scene, lightVertices, cameraVertices, 
+                                  sampled, s, t, lightDistr);
+  DCHECK(!std::isnan(misWeight));
+  return L * misWeight;
+}
+
+HeroBDPTIntegrator::HeroBDPTIntegrator(std::shared_ptr<Sampler> sampler,
+                                       std::shared_ptr<const Camera> camera,
+                                       int maxDepth,
+                                       const Bounds2i &pixelBounds,
+                                       const std::string &lightSampleStrategy,
+                                       const std::string &wvlSampleStrategy,
+                                       int spectralTrainingSpp)
+: HeroSamplerIntegrator(camera, sampler, pixelBounds, wvlSampleStrategy,
+                        spectralTrainingSpp),
+  maxDepth(maxDepth),
+  lightSampleStrategy(lightSampleStrategy) {}
+
+void HeroBDPTIntegrator::Preprocess(const Scene &scene, 
+                                    Sampler &sampler) {
+  HeroSamplerIntegrator::Preprocess(scene, sampler);
+  lightDistribution = 
+    CreateLightSampleDistribution(lightSampleStrategy, scene);
+}
+
+WvlPacketf HeroBDPTIntegrator::TracePaths(const RayDifferential &ray,
+                                          Float rayWeight,
+                                          const Scene &scene,
+                                          Sampler &sampler,
+                                          MemoryArena &arena,
+                                          Film *splatFilm) const {
+  if (scene.lights.empty()) return WvlPacketf(0.f);
+
+  // Trace the camera subpath, and a light subpath with the same wavelengths
+  HeroVertex *cameraVertices = arena.Alloc<HeroVertex>(maxDepth + 2);
+  HeroVertex *lightVertices = arena.Alloc<HeroVertex>(maxDepth + 1);
+  int nCamera = GenerateHeroCameraSubpath(scene, sampler, arena, maxDepth + 2,
+                                          *camera, ray, rayWeight, 
+                                          cameraVertices);
+  const Distribution1D *lightDistr = 
+    lightDistribution->Lookup(cameraVertices[0].v.p());
+  int nLight = GenerateHeroLightSubpath(scene, sampler, arena, maxDepth + 1,
+                                        ray.time, ray.wvls, *lightDistr,
+                                        lightVertices);
+
+  // Execute all connection strategies; light tracing strategies ($t=1$) are
+  // only taken when their contributions can be splatted
+  const WvlPacketf pdfs = splatFilm ? WvlDensities(ray.wvls) : WvlPacketf(0.f);
+  WvlPacketf L(0.f);
+  for (int t = splatFilm ? 1 : 2; t <= nCamera; ++t) {
+    for (int s = 0; s <= nLight; ++s) {
+      int depth = t + s - 2;
+      if ((s == 1 && t == 1) || depth < 0 || depth > maxDepth) continue;
+      Point2f pFilmNew;
+      WvlPacketf Lpath = ConnectHeroBDPT(scene, lightVertices, cameraVertices,
+                                         s, t, *lightDistr, *camera, sampler,
+                                         ray.wvls, &pFilmNew);
+      if (t != 1)
+        L += Lpath;
+      else if (Lpath != WvlPacketf(0.f))
+        splatFilm->AddSplat(pFilmNew, ray.wvls, Lpath, pdfs);
+    }
+  }
+  return L;
+}
+
+WvlPacketf HeroBDPTIntegrator::LiWvls(const RayDifferential &ray, 
+                                      const Scene &scene,
+                                      Sampler &sampler,
+                                      MemoryArena &arena, 
+                                      Spectrum *Lfull,
+                                      int depth) const {
+  return TracePaths(ray, 1, scene, sampler, arena, nullptr);
+}
+
+void HeroBDPTIntegrator::Render(const Scene &scene) {
+  Preprocess(scene, *sampler);
+  if (spectralTrainingSpp > 0) TrainSpectralDistribution(scene);
+
+  // Partition the image into tiles
+  Film *film = camera->film;
+  film->BufferSpectralImage();
+  const Bounds2i sampleBounds = film->GetSampleBounds();
+  const Vector2i sampleExtent = sampleBounds.Diagonal();
+  const int tileSize = Film::tileSize;
+  const int nXTiles = (sampleExtent.x + tileSize - 1) / tileSize;
+  const int nYTiles = (sampleExtent.y + tileSize - 1) / tileSize;
+  ProgressReporter reporter(nXTiles * nYTiles, "Rendering");
+
+  // Render and write the output image to disk
+  if (scene.lights.size() > 0) {
+    ParallelFor2D([&](const Point2i tile) {
+      // Render a single tile using hero wavelength BDPT
+      MemoryArena arena;
+      int seed = tile.y * nXTiles + tile.x;
+      std::unique_ptr<Sampler> tileSampler = sampler->Clone(seed);
+      int x0 = sampleBounds.pMin.x + tile.x * tileSize;
+      int x1 = std::min(x0 + tileSize, sampleBounds.pMax.x);
+      int y0 = sampleBounds.pMin.y + tile.y * tileSize;
+      int y1 = std::min(y0 + tileSize, sampleBounds.pMax.y);
+      Bounds2i tileBounds(Point2i(x0, y0), Point2i(x1, y1));
+      LOG(INFO) << "Starting image tile " << tileBounds;
+
+      std::unique_ptr<FilmTile> filmTile = film->GetFilmTile(tileBounds);
+      for (Point2i pPixel : tileBounds) {
+        tileSampler->StartPixel(pPixel);
+        if (!InsideExclusive(pPixel, pixelBounds))
+          continue;
+        do {
+          // Generate the camera ray and the wavelengths shared by both subpaths
+          CameraSample cameraSample = tileSampler->GetCameraSample(pPixel);
+          RayDifferential ray;
+          Float rayWeight = camera->GenerateRayDifferential(cameraSample, &ray);
+          ray.ScaleDifferentials(1 / std::sqrt((Float)tileSampler->samplesPerPixel));
+          ray.wvls = SampleWvls(cameraSample.wvl);
+
+          WvlPacketf L(0.f);
+          if (rayWeight > 0)
+            L = TracePaths(ray, rayWeight, scene, *tileSampler, arena, film);
+          if (L.HasNaNs()) {
+            LOG(ERROR) << StringPrintf(
+              "Not-a-number radiance value returned "
+              "for pixel (%d, %d), sample %d. Setting to black.",
+              pPixel.x, pPixel.y,
+              (int)tileSampler->CurrentSampleNumber());
+            L = WvlPacketf(0.f);
+          }
+          VLOG(2) << "Add film sample pFilm: " << cameraSample.pFilm << 
+            ", L: " << L;
+          filmTile->AddSample(cameraSample.pFilm, ray.wvls, L, 
+                              WvlDensities(ray.wvls));
+          arena.Reset();
+        } while (tileSampler->StartNextSample());
+      }
+      film->MergeFilmTile(std::move(filmTile));
+      reporter.Update();
+      LOG(INFO) << "Finished image tile " << tileBounds;
+    }, Point2i(nXTiles, nYTiles));
+  }
+  reporter.Done();
+  film->WriteImage(1.0f / sampler->samplesPerPixel);
+}
+
+HeroBDPTIntegrator *CreateHeroBDPTIntegrator(const ParamSet &params,
+                                             std::shared_ptr<Sampler> sampler,
+                                             std::shared_ptr<const Camera> camera) {
+    int maxDepth = params.FindOneInt("maxdepth", 5);
+    int np;
+    const int *pb = params.FindInt("pixelbounds", &np);
+    Bounds2i pixelBounds = camera->film->GetSampleBounds();
+    if (pb) {
+        if (np != 4)
+            Error("Expected four values for \"pixelbounds\" parameter. Got %d.",
+                  np);
+        else {
+            pixelBounds = Intersect(pixelBounds,
+                                    Bounds2i{{pb[0], pb[2]}, {pb[1], pb[3]}});
+            if (pixelBounds.Area() == 0)
+                Error("Degenerate \"pixelbounds\" specified.");
+        }
+    }
+    std::string lightStrategy = 
+        params.FindOneString("lightsamplestrategy", "power");
+    std::string wvlStrategy =
+        params.FindOneString("wavelengthsamplestrategy", "xyz");
+    int trainingSpp = params.FindOneInt("spectraltrainingspp", 0);
+    return new HeroBDPTIntegrator(sampler, camera, maxDepth, pixelBounds,
+                                  lightStrategy, wvlStrategy, trainingSpp);
+}
+
+} // namespace pbrt
@@ -0,0 +1,93 @@
+/*
+    pbrt source code is Copyright(c) 1998-2016
+                        Matt Pharr, Greg Humphreys, and Wenzel Jakob.
+
+    This file is part of pbrt.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are
+    met:
+
+    - Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    - Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+    IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+    TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+    PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#if defined(_MSC_VER)
+#define NOMINMAX
+#pragma once
+#endif
+
+#ifndef PBRT_INTEGRATORS_HERO_BDPT_H
+#define PBRT_INTEGRATORS_HERO_BDPT_H
+
+#include "pbrt.h"
+#include "hero.h"
+#include "lightdistrib.h"
+
+namespace pbrt {
+
+/* Bidirectional path tracer for hero wavelength packets. Camera and light
+   subpaths are traced with the same packet, so that a light subpath refracted
+   by a dispersive interface can still be connected to the camera for each of 
+   its wavelengths. Every connection is weighted by the balance heuristic over
+   all strategies and all wavelengths in the packet. */
+class HeroBDPTIntegrator : public HeroSamplerIntegrator {
+public:
+  // HeroBDPTIntegrator public methods
+  HeroBDPTIntegrator(std::shared_ptr<Sampler> sampler,
+                     std::shared_ptr<const Camera> camera, 
+                     int maxDepth,
+                     const Bounds2i &pixelBounds,
+                     const std::string &lightSampleStrategy = "power",
+                     const std::string &wvlSampleStrategy = "xyz",
+                     int spectralTrainingSpp = 0);
+  void Preprocess(const Scene &scene, 
+                  Sampler &sampler);
+  void Render(const Scene &scene);
+  // Contributions of all strategies with at least two camera subpath vertices;
+  // light tracing contributions are only splatted by _Render()_
+  WvlPacketf LiWvls(const RayDifferential &ray, 
+                    const Scene &scene,
+                    Sampler &sampler,
+                    MemoryArena &arena, 
+                    Spectrum *Lfull,
+                    int depth) const;
+
+private:
+  // HeroBDPTIntegrator private methods
+  WvlPacketf TracePaths(const RayDifferential &ray, 
+                        Float rayWeight,
+                        const Scene &scene,
+                        Sampler &sampler, 
+                        MemoryArena &arena,
+                        Film *splatFilm) const;
+
+  // HeroBDPTIntegrator private components
+  const int maxDepth;
+  const std::string lightSampleStrategy;
+  std::unique_ptr<LightDistribution> lightDistribution;
+};
+
+HeroBDPTIntegrator *CreateHeroBDPTIntegrator(const ParamSet &params,
+                                             std::shared_ptr<Sampler> sampler,
+                                             std::shared_ptr<const Camera> camera);
+} // namespace pbrt
+
+#endif  // PBRT_INTEGRATORS_HERO_BDPT_H
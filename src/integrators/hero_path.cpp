@@ -47,21 +47,25 @@ HeroPathIntegrator::HeroPathIntegrator(int maxDepth,
                                        std::shared_ptr<const Camera> camera,
                                        std::shared_ptr<Sampler> sampler,
                                        const Bounds2i &pixelBounds, 
-                                       Float rrThreshold)
-: HeroSamplerIntegrator(camera, sampler, pixelBounds),
+                                       Float rrThreshold,
+                                       const std::string &wvlSampleStrategy,
+                                       int spectralTrainingSpp)
+: HeroSamplerIntegrator(camera, sampler, pixelBounds, wvlSampleStrategy,
+                        spectralTrainingSpp),
   maxDepth(maxDepth),
   rrThreshold(rrThreshold) {}
 
-Spectrum HeroPathIntegrator::Li(const RayDifferential &r, 
-                                const Scene &scene,
-                                Sampler &sampler,
-                                MemoryArena &arena,
-                                int depth) const {
+WvlPacketf HeroPathIntegrator::LiWvls(const RayDifferential &r, 
+                                      const Scene &scene,
+                                      Sampler &sampler,
+                                      MemoryArena &arena,
+                                      Spectrum *Lfull,
+                                      int depth) const {
   ProfilePhase p(Prof::SamplerIntegratorLi);
   RayDifferential ray(r);
 
   /* Tracking values for path computation */
-  Spectrum Lo(0.f);             // Exitant radiance along path
+  WvlPacketf Lo(0.f);           // Exitant radiance along path per wvl
   Spectrum beta(1.f);           // Throughput along path
   Float etaScale = 1.f;         // Relative refractive index scaling along path
 
@@ -69,14 +73,12 @@ Spectrum HeroPathIntegrator::Li(const RayDifferential &r,
   bool isWvlDependent = false;  // Is the path wvl. dependent from some vertex onward?
   
   /* Tracking values for HWSS */
-  Vector4f pathWvlPdf(1.f);     // Product of bsdf pdfs along path per wvl
-  Vector4i wvlIdx;              // Bin index of the four wavelengths
-  Spectrum wvlPdf(1.f);         // Sampling density of the four wavelengths
+  WvlPacketf pathWvlPdf(1.f);   // Product of bsdf pdfs along path per wvl
+  WvlPacketi wvlIdx;            // Bin index of the packet wavelengths
 
   /* Initialize HWSS tracking values */
   for (int i = 0; i < nWvls; ++i) {
     wvlIdx[i] = Spectrum::indexFromWavelength(ray.wvls[i]);
-    wvlPdf[wvlIdx[i]] = spectralDistribution.Pdf(wvlIdx[i]);
   }
 
   int bounces;  
@@ -93,9 +95,9 @@ Spectrum HeroPathIntegrator::Li(const RayDifferential &r,
 
         // Compute energy; wavelength dependency introduces a special case with HWSS
         if (isWvlDependent) {
-          Lo += beta * Le / (wvlPdf * Sum(pathWvlPdf));
+          AddToPacket(Lo, Lfull, beta * Le / Sum(pathWvlPdf), wvlIdx, true);
         } else {
-          Lo += beta * Le;
+          AddToPacket(Lo, Lfull, beta * Le, wvlIdx, false);
         }
       }
 
@@ -107,9 +109,9 @@ Spectrum HeroPathIntegrator::Li(const RayDifferential &r,
     if (!Le.IsBlack()) {
       // Compute energy; wavelength dependency introduces a special case with HWSS
       if (isWvlDependent) {
-        Lo += beta * Le / (wvlPdf * Sum(pathWvlPdf));
+        AddToPacket(Lo, Lfull, beta * Le / Sum(pathWvlPdf), wvlIdx, true);
       } else {
-        Lo += beta * Le;
+        AddToPacket(Lo, Lfull, beta * Le, wvlIdx, false);
       } 
 
       /* TODO: mitsuba returns here instead of adding, but PBRT's path tracer continues bouncing 
@@ -148,11 +150,12 @@ Spectrum HeroPathIntegrator::Li(const RayDifferential &r,
       f.zeroAllBinsBut(wvlIdx[0]);
       pathWvlPdf[0] *= bsdfPdf;
 
-      // Evaluate bsdf, pdf for rotated wavelengths
+      // Evaluate bsdf, pdf for rotated wavelengths in one packet query
+      const WvlPacketf fWvls = bsdf->fWvls(wo, wi, wvlIdx);
+      const WvlPacketf pdfWvls = bsdf->PdfWvls(wo, wi);
       for (int i = 1; i < nWvls; ++i) {
-        const BSDF *_bsdf = &isect.bsdf[isCurrentWvlDependent ? i : 0];
-        f[wvlIdx[i]] += _bsdf->f(wo, wi, BSDF_ALL)[wvlIdx[i]];
-        pathWvlPdf[i] *= _bsdf->Pdf(wo, wi, BSDF_ALL);
+        f[wvlIdx[i]] += fWvls[i];
+        pathWvlPdf[i] *= pdfWvls[i];
       }
       
       beta *= f * AbsDot(wi, isect.shading.n); // No PDF divide, canceled out by HWSS' MIS weight
@@ -208,6 +211,10 @@ HeroPathIntegrator *CreateHeroPathIntegrator(const ParamSet &params,
         }
     }
     Float rrThreshold = params.FindOneFloat("rrthreshold", 1.);
-    return new HeroPathIntegrator(maxDepth, camera, sampler, pixelBounds, rrThreshold);
+    std::string wvlStrategy =
+        params.FindOneString("wavelengthsamplestrategy", "xyz");
+    int trainingSpp = params.FindOneInt("spectraltrainingspp", 0);
+    return new HeroPathIntegrator(maxDepth, camera, sampler, pixelBounds, rrThreshold,
+                                  wvlStrategy, trainingSpp);
 }
 } // namespace pbrt
\ No newline at end of file
@@ -49,12 +49,15 @@ public:
                      std::shared_ptr<const Camera> camera,
                      std::shared_ptr<Sampler> sampler,
                      const Bounds2i &pixelBounds, 
-                     Float rrThreshold = 1);
-  Spectrum Li(const RayDifferential &ray, 
-              const Scene &scene,
-              Sampler &sampler,
-              MemoryArena &arena, 
-              int depth) const;
+                     Float rrThreshold = 1,
+                     const std::string &wvlSampleStrategy = "xyz",
+                     int spectralTrainingSpp = 0);
+  WvlPacketf LiWvls(const RayDifferential &ray, 
+                    const Scene &scene,
+                    Sampler &sampler,
+                    MemoryArena &arena, 
+                    Spectrum *Lfull,
+                    int depth) const;
 
 private:
   // HeroPathIntegrator private components
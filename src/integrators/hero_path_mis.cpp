@@ -42,17 +42,12 @@ namespace pbrt {
 
 STAT_PERCENT("Integrator/Zero-radiance paths", zeroRadiancePaths, totalPaths);
 STAT_INT_DISTRIBUTION("Integrator/Path length", pathLength);
+STAT_COUNTER("Integrator/Wavelength splits", nWvlSplits);
 
 Float PdfEmitterHero(const SurfaceInteraction &it,
                      const Ray &ray,
                      const Scene &scene,
                      const Distribution1D *distr) {
-  /* Check if there's even (non-infinite) emitters */
-  int nLights = scene.lights.size();
-  if (nLights == 0) {
-    return 0.f;
-  }
-
   /* Check if there's even a light */
   const Light *light = it.primitive->GetAreaLight();
   if (!light) {
@@ -64,18 +59,7 @@ Float PdfEmitterHero(const SurfaceInteraction &it,
               / (AbsDot(it.n, it.wo) * it.shape->Area());
 
   /* Multiply by the distr. with which the light may have been picked */
-  if (distr) {
-    // TODO: this is hardly efficient
-    for (int i = 0; i < scene.lights.size(); ++i) {
-      if (light == scene.lights[i].get()) {
-        return emPdf * distr->DiscretePDF(i);
-      }
-    }
-  } else {
-    return emPdf / (Float) nLights;
-  }
-
-  return 0.f;
+  return emPdf * scene.LightPdf(light, distr);
 }
 
 Spectrum SampleEmitterHero(const SurfaceInteraction &it,
@@ -115,32 +99,48 @@ Spectrum SampleEmitterHero(const SurfaceInteraction &it,
   return Li / pdf;
 }
 
+// Continuation of a path for a single wavelength of the packet, split off at
+// a dispersive refraction
+struct SplitPath {
+  RayDifferential ray;
+  Spectrum beta;
+  Float etaScale, bsdfPdf;
+  int bounces, wvl;
+  bool isLastSpecular;
+};
+
 HeroPathMISIntegrator::HeroPathMISIntegrator(int maxDepth,
                                        std::shared_ptr<const Camera> camera,
                                        std::shared_ptr<Sampler> sampler,
                                        const Bounds2i &pixelBounds, 
                                        Float rrThreshold,
-                                       const std::string &lightSampleStrategy)
-: HeroSamplerIntegrator(camera, sampler, pixelBounds),
+                                       const std::string &lightSampleStrategy,
+                                       const std::string &wvlSampleStrategy,
+                                       int spectralTrainingSpp,
+                                       int maxWvlSplits)
+: HeroSamplerIntegrator(camera, sampler, pixelBounds, wvlSampleStrategy,
+                        spectralTrainingSpp),
   maxDepth(maxDepth),
   rrThreshold(rrThreshold),
-  lightSampleStrategy(lightSampleStrategy) {}
+  lightSampleStrategy(lightSampleStrategy),
+  maxWvlSplits(maxWvlSplits) {}
 
 void HeroPathMISIntegrator::Preprocess(const Scene &scene, Sampler &sampler) {
   HeroSamplerIntegrator::Preprocess(scene, sampler);
   lightDistribution = CreateLightSampleDistribution(lightSampleStrategy, scene);
 }
 
-Spectrum HeroPathMISIntegrator::Li(const RayDifferential &r,
-                                   const Scene &scene,
-                                   Sampler &sampler, 
-                                   MemoryArena &arena, 
-                                   int depth) const {
+WvlPacketf HeroPathMISIntegrator::LiWvls(const RayDifferential &r,
+                                         const Scene &scene,
+                                         Sampler &sampler, 
+                                         MemoryArena &arena, 
+                                         Spectrum *Lfull,
+                                         int depth) const {
   ProfilePhase p(Prof::SamplerIntegratorLi);
   RayDifferential ray(r);
 
   /* Tracking values for path computation */
-  Spectrum Lo(0.f);             // Exitant radiance along path
+  WvlPacketf Lo(0.f);           // Exitant radiance along path per wvl
   Spectrum beta(1.f);           // Throughput along path
   Float etaScale = 1.f;         // Relative refractive index scaling along path
   Float bsdfPdf = 0.f;          // PDF of BSDF sampling at last path vertex (for non-HWSS MIS)
@@ -150,186 +150,255 @@ Spectrum HeroPathMISIntegrator::Li(const RayDifferential &r,
   bool isLastSpecular = false;  // Was the last path vertex specular or some dirac delta?
   
   /* Tracking values for HWSS */
-  Vector4f pathWvlPdf(1.f);     // Product of bsdf pdfs along path per wvl
-  Vector4f prevPathWvlPdf(1.f); // Product of bsdf pdfs along path per wvl, excl. the last vertex
-  Vector4i wvlIdx;              // Bin index of the four wavelengths
-  Spectrum wvlPdf(1.f);         // Sampling density of the four wavelengths
+  WvlPacketf pathWvlPdf(1.f);   // Product of bsdf pdfs along path per wvl
+  WvlPacketf prevPathWvlPdf(1.f); // Product of bsdf pdfs along path per wvl, excl. the last vertex
+  WvlPacketi wvlIdx;            // Bin index of the packet wavelengths
+
+  /* Tracking values for wavelength splitting */
+  int splitWvl = -1;            // Wavelength carried after a split, or -1 for the full packet
+  int nPending = 0;             // Split continuations that remain to be traced
+  SplitPath pending[nWvls];
 
   /* Initialize HWSS tracking values */
   for (int i = 0; i < nWvls; ++i) {
     wvlIdx[i] = Spectrum::indexFromWavelength(ray.wvls[i]);
-    wvlPdf[wvlIdx[i]] = spectralDistribution.Pdf(wvlIdx[i]);
   }
 
-  int bounces;  
-  for (bounces = 0;; ++bounces) {
-    /* Find next path vertex by raytracing, and store details in _isect_ */
-    SurfaceInteraction isect;
-    bool foundIntersection = scene.Intersect(ray, &isect);
+  /* Add radiance to the packet; a split path only carries its own wavelength */
+  auto addToPath = [&](const Spectrum &L, bool isWvlDependent) {
+    if (splitWvl < 0) {
+      AddToPacket(Lo, Lfull, L, wvlIdx, isWvlDependent);
+    } else {
+      Lo[splitWvl] += L[wvlIdx[splitWvl]];
+    }
+  };
+
+  int bounces = 0;
+  while (true) {
+    for (;; ++bounces) {
+      /* Find next path vertex by raytracing, and store details in _isect_ */
+      SurfaceInteraction isect;
+      bool foundIntersection = scene.Intersect(ray, &isect);
+
+      /* If no intersection could be found, return radiance from environment emitters */
+      if (!foundIntersection) {
+        for (const auto &light : scene.infiniteLights) {
+          Spectrum Le = light->Le(ray);
+          if (Le.IsBlack()) { continue; }
+
+          if (bounces == 0) { /* Direct case */
+            addToPath(beta * Le, false);
+          } else {            /* Indirect case */
+            // Compute infinite light sampling density
+            Interaction it(ray.o, isect.wvls, ray.time, isect.mediumInterface);
+            Float emPdf = isLastSpecular ? 0.f : light->Pdf_Li(it, ray.d);
+
+            // Compute MIS weights; wavelength dependency introduces a special case with HWSS
+            Float misWeight;
+            if (isWvlDependent) {
+              misWeight = 1.f / Sum(pathWvlPdf + prevPathWvlPdf * emPdf);
+            } else {
+              misWeight = bsdfPdf / (bsdfPdf + emPdf);
+            }
+
+            // Add energy. Note that pdf divide was previously canceled out
+            addToPath(beta * Le * misWeight, isWvlDependent);
+          }
+        }
 
-    /* If no intersection could be found, return radiance from environment emitters */
-    if (!foundIntersection) {
-      for (const auto &light : scene.infiniteLights) {
-        Spectrum Le = light->Le(ray);
-        if (Le.IsBlack()) { continue; }
+        break; // Terminate path
+      }
 
+      /* If an emitter was encountered, add the contributed radiance */
+      Spectrum Le = isect.Le(-ray.d);
+      if (!Le.IsBlack()) {
         if (bounces == 0) { /* Direct case */
-          Lo += beta * Le;
+          addToPath(beta * Le, false);
         } else {            /* Indirect case */
-          // Compute infinite light sampling density
-          Interaction it(ray.o, isect.wvls, ray.time, isect.mediumInterface);
-          Float emPdf = isLastSpecular ? 0.f : light->Pdf_Li(it, ray.d);
+          // Compute emitter sampling density
+          const Distribution1D *distrib = lightDistribution->Lookup(ray.o);
+          Float emPdf = isLastSpecular ? 0.f : PdfEmitterHero(isect, ray, scene, distrib);
 
           // Compute MIS weights; wavelength dependency introduces a special case with HWSS
-          Spectrum misWeight;
+          Float misWeight;
           if (isWvlDependent) {
-            misWeight = Spectrum(1.0) / (wvlPdf * Sum(pathWvlPdf + prevPathWvlPdf * emPdf));
+            misWeight = 1.f / Sum(pathWvlPdf + prevPathWvlPdf * emPdf);
           } else {
-            misWeight = Spectrum(bsdfPdf / (bsdfPdf + emPdf));
+            misWeight = bsdfPdf / (bsdfPdf + emPdf);
           }
 
           // Add energy. Note that pdf divide was previously canceled out
-          Lo += beta * Le * misWeight; 
+          addToPath(beta * Le * misWeight, isWvlDependent);
         }
+        
+        /* TODO: mitsuba returns here instead of adding, but PBRT's path tracer continues bouncing 
+           from the emitter onward. Probably a weighting difference somewhere? Blergh. Keeping
+           disabled for now. Should compare converged outputs of both renderers. */
+        // break; // Terminate path
       }
 
-      break; // Terminate path
-    }
+      /* Terminate path if maximum path depth has been reached */
+      if (bounces >= maxDepth) { break; }
 
-    /* If an emitter was encountered, add the contributed radiance */
-    Spectrum Le = isect.Le(-ray.d);
-    if (!Le.IsBlack()) {
-      if (bounces == 0) { /* Direct case */
-        Lo += beta * Le;
-      } else {            /* Indirect case */
-        // Compute emitter sampling density
-        const Distribution1D *distrib = lightDistribution->Lookup(ray.o);
-        Float emPdf = isLastSpecular ? 0.f : PdfEmitterHero(isect, ray, scene, distrib);
-
-        // Compute MIS weights; wavelength dependency introduces a special case with HWSS
-        Spectrum misWeight;
-        if (isWvlDependent) {
-          misWeight = Spectrum(1.0) / (wvlPdf * Sum(pathWvlPdf + prevPathWvlPdf * emPdf));
-        } else {
-          misWeight = Spectrum(bsdfPdf / (bsdfPdf + emPdf));
-        }
+      /* Compute scattering function and obtain the BSDF at the current intersection */
+      isect.ComputeScatteringFunctions(ray, arena, true);
+      const BSDF *bsdf = isect.bsdf;
 
-        // Add energy. Note that pdf divide was previously canceled out
-        Lo += beta * Le * misWeight;
+      /* Skip medium boundaries and null objects by just continuing the path along the ray */
+      if (!bsdf) {
+        ray = isect.SpawnRay(ray.d);
+        bounces--;
+        continue;
       }
-      
-      /* TODO: mitsuba returns here instead of adding, but PBRT's path tracer continues bouncing 
-         from the emitter onward. Probably a weighting difference somewhere? Blergh. Keeping
-         disabled for now. Should compare converged outputs of both renderers. */
-      // break; // Terminate path
-    }
-
-    /* Terminate path if maximum path depth has been reached */
-    if (bounces >= maxDepth) { break; }
-
-    /* Compute scattering function and obtain the BSDF at the current intersection */
-    isect.ComputeScatteringFunctions(ray, arena, true);
-    const BSDF *bsdf = isect.bsdf;
-
-    /* Skip medium boundaries and null objects by just continuing the path along the ray */
-    if (!bsdf) {
-      ray = isect.SpawnRay(ray.d);
-      bounces--;
-      continue;
-    }
 
-    /* Sample an emitter for direct illumination; skip for specular BRDFs */
-    if (bsdf->NumComponents(BxDFType(BSDF_ALL & ~BSDF_SPECULAR))) {
-      ++totalPaths;
-
-      // Sample a random emitter and collect accompanying information
-      const Distribution1D *distrib = lightDistribution->Lookup(isect.p);
-      Float emPdf;
-      Vector3f wo = isect.wo, wi;
-      Spectrum Li = SampleEmitterHero(isect, scene, sampler, distrib, emPdf, wi);
-
-      if (!Li.IsBlack() && emPdf > 0.f) {
-        Spectrum misWeight(1.f);
-        Spectrum f = bsdf->f(wo, wi, BSDF_ALL);
-
-        if (!f.IsBlack()) {
-          // Compute MIS weights; different behavior for wvl dependent and regular paths
-          if (isWvlDependent || isect.isWvlDependent) {
-            f = Spectrum(0.0);
-            Vector4f _bsdfPdf(0.f);
-            for (int i = 0; i < nWvls; ++i) {
-              const BSDF *_bsdf = &isect.bsdf[isect.isWvlDependent ? i : 0];
-              f[wvlIdx[i]] += _bsdf->f(wo, wi, BSDF_ALL)[wvlIdx[i]];
-              _bsdfPdf[i] = _bsdf->Pdf(wo, wi, BSDF_ALL);
+      /* A split path evaluates dispersive surfaces for its own wavelength */
+      const int evalWvl = (splitWvl > 0 && isect.isWvlDependent) ? splitWvl : 0;
+
+      /* Sample an emitter for direct illumination; skip for specular BRDFs */
+      if (bsdf->NumComponents(BxDFType(BSDF_ALL & ~BSDF_SPECULAR))) {
+        ++totalPaths;
+
+        // Sample a random emitter and collect accompanying information
+        const Distribution1D *distrib = lightDistribution->Lookup(isect.p);
+        Float emPdf;
+        Vector3f wo = isect.wo, wi;
+        Spectrum Li = SampleEmitterHero(isect, scene, sampler, distrib, emPdf, wi);
+
+        if (!Li.IsBlack() && emPdf > 0.f) {
+          Float misWeight = 1.f;
+          Spectrum f = bsdf->f(wo, wi, evalWvl, BSDF_ALL);
+
+          if (!f.IsBlack()) {
+            // Compute MIS weights; different behavior for wvl dependent and regular paths
+            const bool isNeeWvlDependent = 
+              splitWvl < 0 && (isWvlDependent || isect.isWvlDependent);
+            if (isNeeWvlDependent) {
+              f = Spectrum(0.0);
+              const WvlPacketf fWvls = bsdf->fWvls(wo, wi, wvlIdx);
+              const WvlPacketf _bsdfPdf = bsdf->PdfWvls(wo, wi);
+              for (int i = 0; i < nWvls; ++i) { f[wvlIdx[i]] += fWvls[i]; }
+              misWeight = emPdf / Sum(pathWvlPdf * emPdf + pathWvlPdf * _bsdfPdf);
+            } else {
+              const Float _bsdfPdf = bsdf->Pdf(wo, wi, evalWvl, BSDF_ALL);
+              misWeight = emPdf / (emPdf + _bsdfPdf);
             }
-            misWeight = Spectrum(emPdf) 
-                      / (wvlPdf * Sum(pathWvlPdf * emPdf + pathWvlPdf * _bsdfPdf));
-          } else {
-            const Float _bsdfPdf = bsdf->Pdf(wo, wi, BSDF_ALL);
-            misWeight = Spectrum(emPdf / (emPdf + _bsdfPdf));
+            f *= AbsDot(wi, isect.shading.n); // apply cosine foreshortening factor
+            // pdf divide was previously canceled out
+            addToPath(beta * Li * f * misWeight, isNeeWvlDependent);
+          }
+        }      
+      }
+
+      /* Sample a new direction and obtain (non-wavelength-dependent) throughput from the BSDF */
+      Vector3f wo = -ray.d, wi;
+      BxDFType flags;
+      Spectrum f = bsdf->Sample_f(wo, &wi, sampler.Get2D(), &bsdfPdf, evalWvl, BSDF_ALL, &flags);
+      if (f.IsBlack() || bsdfPdf == 0.f) { break; }
+
+      /* Wavelength dependency currently occurs only on transmission through dispersive glass */    
+      bool isCurrentWvlDependent = splitWvl < 0 && isect.isWvlDependent && 
+                                   (flags & BSDF_TRANSMISSION); 
+
+      /* A dispersive refraction only transmits the hero wavelength in its sampled direction. 
+         If the path did not depend on wavelength before, split off independent continuations 
+         for up to _maxWvlSplits_ secondary wavelengths instead; these sample their own 
+         directions, and each of the wavelengths that are carried on is weighted equally. */
+      if (isCurrentWvlDependent && !isWvlDependent && (flags & BSDF_SPECULAR) && 
+          maxWvlSplits > 0) {
+        const int nSplits = std::min(nWvls - 1, maxWvlSplits);
+        const Float splitWeight = 1.f / (nSplits + 1);
+        for (int i = 1; i <= nSplits; ++i) {
+          Vector3f wiSplit;
+          Float pdfSplit;
+          BxDFType flagsSplit;
+          Spectrum fSplit = bsdf->Sample_f(wo, &wiSplit, sampler.Get2D(), &pdfSplit, i, 
+                                           BSDF_ALL, &flagsSplit);
+          if (fSplit.IsBlack() || pdfSplit == 0.f) { continue; }
+          fSplit.zeroAllBinsBut(wvlIdx[i]);
+
+          SplitPath &split = pending[nPending++];
+          split.ray = isect.SpawnRay(wiSplit);
+          split.beta = beta * fSplit * (AbsDot(wiSplit, isect.shading.n) * splitWeight / pdfSplit);
+          split.etaScale = etaScale;
+          if ((flagsSplit & BSDF_SPECULAR) && (flagsSplit & BSDF_TRANSMISSION)) {
+            Float eta = isect.bsdf->eta;
+            split.etaScale *= (Dot(wo, isect.n) > 0) ? (eta * eta) : 1 / (eta * eta);
           }
-          f *= AbsDot(wi, isect.shading.n); // apply cosine foreshortening factor
-          Lo += beta * Li * f * misWeight; // pdf divide was previously canceled out
+          split.bsdfPdf = pdfSplit;
+          split.bounces = bounces + 1;
+          split.wvl = i;
+          split.isLastSpecular = (flagsSplit & BSDF_SPECULAR) != 0;
+          ++nWvlSplits;
         }
-      }      
-    }
 
-    /* Sample a new direction and obtain (non-wavelength-dependent) throughput from the BSDF */
-    Vector3f wo = -ray.d, wi;
-    BxDFType flags;
-    Spectrum f = bsdf->Sample_f(wo, &wi, sampler.Get2D(), &bsdfPdf, BSDF_ALL, &flags);
-    if (f.IsBlack() || bsdfPdf == 0.f) { break; }
-
-    /* Wavelength dependency currently occurs only on transmission through dispersive glass */    
-    const bool isCurrentWvlDependent = isect.isWvlDependent && (flags & BSDF_TRANSMISSION); 
-    
-    /* Evaluate the BSDF; wavelength dependency introduces a special case with HWSS */
-    if (isWvlDependent || isCurrentWvlDependent) {
-      // Cache previous wavelength path probabilities so we can compute emitter sampling densities
-      prevPathWvlPdf = pathWvlPdf;
-
-      // Zero out all energy except the hero wavelength
-      f.zeroAllBinsBut(wvlIdx[0]);
-      pathWvlPdf[0] *= bsdfPdf;
-
-      // Evaluate bsdf, pdf for rotated wavelengths
-      for (int i = 1; i < nWvls; ++i) {
-        const BSDF *_bsdf = &isect.bsdf[isCurrentWvlDependent ? i : 0];
-        f[wvlIdx[i]] += _bsdf->f(wo, wi, BSDF_ALL)[wvlIdx[i]];
-        pathWvlPdf[i] *= _bsdf->Pdf(wo, wi, BSDF_ALL);
+        // Carry on with the hero wavelength only
+        splitWvl = 0;
+        isCurrentWvlDependent = false;
+        f.zeroAllBinsBut(wvlIdx[0]);
+        beta *= splitWeight;
       }
       
-      beta *= f * AbsDot(wi, isect.shading.n); // No PDF divide, canceled out by HWSS' MIS weights
-    } else {
-      beta *= f * AbsDot(wi, isect.shading.n) / bsdfPdf;
-    }
-    if (beta.IsBlack()) { break; } // Terminate path
+      /* Evaluate the BSDF; wavelength dependency introduces a special case with HWSS */
+      if (isWvlDependent || isCurrentWvlDependent) {
+        // Cache previous wavelength path probabilities so we can compute emitter sampling densities
+        prevPathWvlPdf = pathWvlPdf;
+
+        // Zero out all energy except the hero wavelength
+        f.zeroAllBinsBut(wvlIdx[0]);
+        pathWvlPdf[0] *= bsdfPdf;
+
+        // Evaluate bsdf, pdf for rotated wavelengths in one packet query
+        const WvlPacketf fWvls = bsdf->fWvls(wo, wi, wvlIdx);
+        const WvlPacketf pdfWvls = bsdf->PdfWvls(wo, wi);
+        for (int i = 1; i < nWvls; ++i) {
+          f[wvlIdx[i]] += fWvls[i];
+          pathWvlPdf[i] *= pdfWvls[i];
+        }
+        
+        beta *= f * AbsDot(wi, isect.shading.n); // No PDF divide, canceled out by HWSS' MIS weights
+      } else {
+        beta *= f * AbsDot(wi, isect.shading.n) / bsdfPdf;
+      }
+      if (beta.IsBlack()) { break; } // Terminate path
 
-    /* Spawn a new ray leading to the next path vertex */
-    ray = isect.SpawnRay(wi);
+      /* Spawn a new ray leading to the next path vertex */
+      ray = isect.SpawnRay(wi);
 
-    /* Update ETA scaling for russian roulette */
-    if ((flags  & BSDF_SPECULAR) && (flags & BSDF_TRANSMISSION)) {
-      Float eta = isect.bsdf->eta;
-      etaScale *= (Dot(wo, isect.n) > 0) ? (eta * eta) : 1 / (eta * eta);
-    }
+      /* Update ETA scaling for russian roulette */
+      if ((flags  & BSDF_SPECULAR) && (flags & BSDF_TRANSMISSION)) {
+        Float eta = isect.bsdf->eta;
+        etaScale *= (Dot(wo, isect.n) > 0) ? (eta * eta) : 1 / (eta * eta);
+      }
 
-    /* Perform russian roulette, possibly terminating the path.
-       Factors out radiance scaling due to refraction in rrBeta. */
-    Spectrum rrBeta = beta * etaScale;
-    if (rrBeta.MaxComponentValue() < rrThreshold && bounces > 3) {
-      Float q = std::max((Float).05, 1 - rrBeta.MaxComponentValue());
-      if (sampler.Get1D() < q) { break; } // Terminate path
-      beta /= 1 - q;
-      DCHECK(!std::isinf(beta.y()));
-    }
+      /* Perform russian roulette, possibly terminating the path.
+         Factors out radiance scaling due to refraction in rrBeta. */
+      Spectrum rrBeta = beta * etaScale;
+      if (rrBeta.MaxComponentValue() < rrThreshold && bounces > 3) {
+        Float q = std::max((Float).05, 1 - rrBeta.MaxComponentValue());
+        if (sampler.Get1D() < q) { break; } // Terminate path
+        beta /= 1 - q;
+        DCHECK(!std::isinf(beta.y()));
+      }
 
-    /* Update status flags */
-    isWvlDependent |= isCurrentWvlDependent;
-    isLastSpecular = (flags & BSDF_SPECULAR) != 0;
+      /* Update status flags */
+      isWvlDependent |= isCurrentWvlDependent;
+      isLastSpecular = (flags & BSDF_SPECULAR) != 0;
+    }
+    ReportValue(pathLength, bounces);
+
+    /* Resume the next continuation split off at a dispersive refraction */
+    if (nPending == 0) { break; }
+    const SplitPath &split = pending[--nPending];
+    ray = split.ray;
+    beta = split.beta;
+    etaScale = split.etaScale;
+    bsdfPdf = split.bsdfPdf;
+    bounces = split.bounces;
+    splitWvl = split.wvl;
+    isLastSpecular = split.isLastSpecular;
+    isWvlDependent = false;
   }
 
-  ReportValue(pathLength, bounces);
   return Lo;
 }
 
@@ -354,7 +423,12 @@ HeroPathMISIntegrator *CreateHeroPathMISIntegrator(const ParamSet &params,
     Float rrThreshold = params.FindOneFloat("rrthreshold", 1.);
     std::string lightStrategy =
         params.FindOneString("lightsamplestrategy", "spatial");
+    std::string wvlStrategy =
+        params.FindOneString("wavelengthsamplestrategy", "xyz");
+    int trainingSpp = params.FindOneInt("spectraltrainingspp", 0);
+    int maxWvlSplits = params.FindOneInt("maxwavelengthsplits", 0);
     return new HeroPathMISIntegrator(maxDepth, camera, sampler, pixelBounds,
-                                  rrThreshold, lightStrategy);
+                                  rrThreshold, lightStrategy, wvlStrategy,
+                                  trainingSpp, maxWvlSplits);
 }
 } // namespace pbrt
\ No newline at end of file
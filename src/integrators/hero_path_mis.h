@@ -51,20 +51,27 @@ public:
                         std::shared_ptr<Sampler> sampler,
                         const Bounds2i &pixelBounds, 
                         Float rrThreshold = 1,
-                        const std::string &lightSampleStrategy = "spatial");
+                        const std::string &lightSampleStrategy = "spatial",
+                        const std::string &wvlSampleStrategy = "xyz",
+                        int spectralTrainingSpp = 0,
+                        int maxWvlSplits = 0);
   void Preprocess(const Scene &scene, 
                   Sampler &sampler);
-  Spectrum Li(const RayDifferential &ray, 
-              const Scene &scene,
-              Sampler &sampler,
-              MemoryArena &arena, 
-              int depth) const;
+  WvlPacketf LiWvls(const RayDifferential &ray, 
+                    const Scene &scene,
+                    Sampler &sampler,
+                    MemoryArena &arena, 
+                    Spectrum *Lfull,
+                    int depth) const;
 
 private:
   // HeroPathMISIntegrator private components
   const int maxDepth;
   const Float rrThreshold;
   const std::string lightSampleStrategy;
+  // Secondary wavelengths that may be split off into their own paths at the
+  // first dispersive refraction of a camera sample
+  const int maxWvlSplits;
   std::unique_ptr<LightDistribution> lightDistribution;
 };
 
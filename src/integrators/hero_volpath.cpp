@@ -0,0 +1,298 @@
+/*
+    pbrt source code is Copyright(c) 1998-2016
+                        Matt Pharr, Greg Humphreys, and Wenzel Jakob.
+
+    This file is part of pbrt.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are
+    met:
+
+    - Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    - Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+    IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+    TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+    PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include "integrators/hero_volpath.h"
+#include "camera.h"
+#include "film.h"
+#include "interaction.h"
+#include "medium.h"
+#include "paramset.h"
+#include "scene.h"
+#include "stats.h"
+
+namespace pbrt {
+
+STAT_INT_DISTRIBUTION("Integrator/Path length", pathLength);
+STAT_COUNTER("Integrator/Volume interactions", volumeInteractions);
+STAT_COUNTER("Integrator/Surface interactions", surfaceInteractions);
+
+HeroVolPathIntegrator::HeroVolPathIntegrator(int maxDepth,
+                                             std::shared_ptr<const Camera> camera,
+                                             std::shared_ptr<Sampler> sampler,
+                                             const Bounds2i &pixelBounds, 
+                                             Float rrThreshold,
+                                             const std::string &lightSampleStrategy,
+                                             const std::string &wvlSampleStrategy,
+                                             int spectralTrainingSpp)
+: HeroSamplerIntegrator(camera, sampler, pixelBounds, wvlSampleStrategy,
+                        spectralTrainingSpp),
+  maxDepth(maxDepth),
+  rrThreshold(rrThreshold),
+  lightSampleStrategy(lightSampleStrategy) {}
+
+void HeroVolPathIntegrator::Preprocess(const Scene &scene, Sampler &sampler) {
+  HeroSamplerIntegrator::Preprocess(scene, sampler);
+  lightDistribution = CreateLightSampleDistribution(lightSampleStrategy, scene);
+}
+
+Float HeroVolPathIntegrator::PdfEmitter(const Light *light,
+                                        const Interaction &ref,
+                                        const Vector3f &wi,
+                                        const Scene &scene) const {
+  /* Density of sampling _wi_ on the emitter, times that of having picked it */
+  const Distribution1D *distrib = lightDistribution->Lookup(ref.p);
+  return light->Pdf_Li(ref, wi) * scene.LightPdf(light, distrib);
+}
+
+WvlPacketf HeroVolPathIntegrator::SampleEmitter(const Interaction &it,
+                                                const BSDF *bsdf,
+                                                const WvlPacketi &wvlIdx,
+                                                const WvlPacketf &pathWvlPdf,
+                                                const Scene &scene,
+                                                Sampler &sampler) const {
+  if (scene.lights.empty()) { return WvlPacketf(0.f); }
+
+  /* Randomly pick an emitter to sample */
+  const Distribution1D *distrib = lightDistribution->Lookup(it.p);
+  Float lightPdf;
+  int lightNum = distrib->SampleDiscrete(sampler.Get1D(), &lightPdf);
+  if (lightPdf == 0.f) { return WvlPacketf(0.f); }
+  const std::shared_ptr<Light> &light = scene.lights[lightNum];
+
+  /* Sample the emitter for incident radiance */
+  Vector3f wi;
+  Float emPdf;
+  VisibilityTester visibility;
+  Spectrum Li = light->Sample_Li(it, sampler.Get2D(), &wi, &emPdf, &visibility);
+  if (emPdf == 0.f || Li.IsBlack()) { return WvlPacketf(0.f); }
+  emPdf *= lightPdf;
+
+  /* Evaluate the scattering function and its sampling density per wavelength */
+  WvlPacketf f, scatterPdf;
+  if (it.IsSurfaceInteraction()) {
+    const SurfaceInteraction &isect = (const SurfaceInteraction &)it;
+    f = bsdf->fWvls(isect.wo, wi, wvlIdx) * AbsDot(wi, isect.shading.n);
+    scatterPdf = bsdf->PdfWvls(isect.wo, wi);
+  } else {
+    const MediumInteraction &mi = (const MediumInteraction &)it;
+    f = scatterPdf = WvlPacketf(mi.phase->p(mi.wo, wi));
+  }
+  if (f == WvlPacketf(0.f)) { return WvlPacketf(0.f); }
+
+  /* Ratio track the shadow ray; its per-wavelength transmittance also is the
+     density with which scattering would have passed through the same media */
+  WvlPacketf Tr = visibility.TrWvls(scene, sampler);
+  if (Tr == WvlPacketf(0.f)) { return WvlPacketf(0.f); }
+  if (IsDeltaLight(light->flags)) { scatterPdf = WvlPacketf(0.f); }
+
+  /* Balance heuristic over emitter and scattering sampling of all wavelengths */
+  Float denom = Sum(pathWvlPdf * (WvlPacketf(emPdf) + scatterPdf * Tr));
+  if (denom == 0.f) { return WvlPacketf(0.f); }
+  return f * Tr * SpectrumAtWvls(Li, it.wvls) / denom;
+}
+
+WvlPacketf HeroVolPathIntegrator::LiWvls(const RayDifferential &r,
+                                         const Scene &scene,
+                                         Sampler &sampler, 
+                                         MemoryArena &arena, 
+                                         Spectrum *Lfull,
+                                         int depth) const {
+  ProfilePhase p(Prof::SamplerIntegratorLi);
+  RayDifferential ray(r);
+
+  /* Tracking values for path computation */
+  WvlPacketf Lo(0.f);           // Exitant radiance along path per wvl
+  WvlPacketf beta(1.f);         // Throughput along path per wvl, without pdf divides
+  Float etaScale = 1.f;         // Relative refractive index scaling along path
+  Interaction prevIt;           // Last scattering vertex, for emitter sampling densities
+
+  /* Status flags for path computation */
+  bool isLastSpecular = false;  // Was the last path vertex specular or some dirac delta?
+
+  /* Tracking values for spectral MIS. Both the throughput and the densities are 
+     kept relative to the hero wavelength's path density, as only their ratio matters */
+  WvlPacketf pathWvlPdf(1.f);   // Path sampling density per wvl
+  WvlPacketf prevPathWvlPdf(1.f); // Path sampling density per wvl, excl. the last vertex
+  WvlPacketi wvlIdx;            // Bin index of the packet wavelengths
+
+  /* Initialize HWSS tracking values */
+  for (int i = 0; i < nWvls; ++i) {
+    wvlIdx[i] = Spectrum::indexFromWavelength(ray.wvls[i]);
+  }
+
+  int bounces;
+  for (bounces = 0;; ++bounces) {
+    /* Find next path vertex by raytracing, and store details in _isect_ */
+    SurfaceInteraction isect;
+    bool foundIntersection = scene.Intersect(ray, &isect);
+
+    /* Sample the participating medium with one distance for the packet */
+    MediumInteraction mi;
+    if (ray.medium) {
+      WvlPacketf mediumWvlPdf;
+      beta *= ray.medium->SampleWvls(ray, sampler, arena, &mi, &mediumWvlPdf);
+      pathWvlPdf *= mediumWvlPdf;
+    }
+
+    /* Renormalize with respect to the hero wavelength */
+    const Float heroPdf = pathWvlPdf[0];
+    if (heroPdf == 0.f || beta == WvlPacketf(0.f)) { break; }
+    beta /= heroPdf;
+    pathWvlPdf /= heroPdf;
+    prevPathWvlPdf /= heroPdf;
+
+    /* Handle scattering in the medium */
+    if (mi.IsValid()) {
+      if (bounces >= maxDepth) { break; }
+      ++volumeInteractions;
+
+      // Sample an emitter for direct illumination
+      Lo += beta * SampleEmitter(mi, nullptr, wvlIdx, pathWvlPdf, scene, sampler);
+
+      // Sample the phase function; it does not depend on wavelength
+      Vector3f wo = -ray.d, wi;
+      const Float phasePdf = mi.phase->Sample_p(wo, &wi, sampler.Get2D());
+      prevPathWvlPdf = pathWvlPdf;
+      beta *= phasePdf;
+      pathWvlPdf *= phasePdf;
+      prevIt = mi;
+      isLastSpecular = false;
+      ray = mi.SpawnRay(wi);
+    } else {
+      ++surfaceInteractions;
+
+      /* Add radiance from environment emitters, or an emitter that was encountered */
+      if (!foundIntersection) {
+        for (const auto &light : scene.infiniteLights) {
+          Spectrum Le = light->Le(ray);
+          if (Le.IsBlack()) { continue; }
+          Float emPdf = (bounces == 0 || isLastSpecular) ? 0.f 
+                      : PdfEmitter(light.get(), prevIt, ray.d, scene);
+          Lo += beta * SpectrumAtWvls(Le, ray.wvls) 
+              / Sum(pathWvlPdf + prevPathWvlPdf * emPdf);
+        }
+        break; // Terminate path
+      }
+      Spectrum Le = isect.Le(-ray.d);
+      if (!Le.IsBlack()) {
+        const Light *light = isect.primitive->GetAreaLight();
+        Float emPdf = (bounces == 0 || isLastSpecular) ? 0.f 
+                    : PdfEmitter(light, prevIt, ray.d, scene);
+        Lo += beta * SpectrumAtWvls(Le, ray.wvls) 
+            / Sum(pathWvlPdf + prevPathWvlPdf * emPdf);
+      }
+
+      /* Terminate path if maximum path depth has been reached */
+      if (bounces >= maxDepth) { break; }
+
+      /* Compute scattering functions and skip over medium boundaries */
+      isect.ComputeScatteringFunctions(ray, arena, true);
+      const BSDF *bsdf = isect.bsdf;
+      if (!bsdf) {
+        ray = isect.SpawnRay(ray.d);
+        bounces--;
+        continue;
+      }
+
+      /* Sample an emitter for direct illumination; skip for specular BRDFs */
+      if (bsdf->NumComponents(BxDFType(BSDF_ALL & ~BSDF_SPECULAR))) {
+        Lo += beta * SampleEmitter(isect, bsdf, wvlIdx, pathWvlPdf, scene,
+                                   sampler);
+      }
+
+      /* Sample a new direction with the hero wavelength; the packet query
+         also returns the BSDF and its density for the remaining wavelengths */
+      Vector3f wo = -ray.d, wi;
+      WvlPacketf bsdfPdfs;
+      BxDFType flags;
+      WvlPacketf f = bsdf->Sample_fWvls(wo, &wi, sampler.Get2D(), wvlIdx,
+                                        &bsdfPdfs, BSDF_ALL, &flags);
+      if (f == WvlPacketf(0.f) || bsdfPdfs[0] == 0.f) { break; }
+
+      prevPathWvlPdf = pathWvlPdf;
+      beta *= f * AbsDot(wi, isect.shading.n);
+      pathWvlPdf *= bsdfPdfs;
+      prevIt = isect;
+      isLastSpecular = (flags & BSDF_SPECULAR) != 0;
+      ray = isect.SpawnRay(wi);
+
+      /* Update ETA scaling for russian roulette */
+      if ((flags & BSDF_SPECULAR) && (flags & BSDF_TRANSMISSION)) {
+        Float eta = bsdf->eta;
+        etaScale *= (Dot(wo, isect.n) > 0) ? (eta * eta) : 1 / (eta * eta);
+      }
+    }
+
+    /* Perform russian roulette on the MIS weighted throughput, possibly terminating
+       the path. Factors out radiance scaling due to refraction in rrBeta. */
+    Float rrBeta = 0.f;
+    for (int i = 0; i < nWvls; ++i) { rrBeta = std::max(rrBeta, beta[i]); }
+    rrBeta *= etaScale * nWvls / Sum(pathWvlPdf);
+    if (rrBeta < rrThreshold && bounces > 3) {
+      Float q = std::max((Float).05, 1 - rrBeta);
+      if (sampler.Get1D() < q) { break; } // Terminate path
+      beta /= 1 - q;
+    }
+  }
+
+  ReportValue(pathLength, bounces);
+  return Lo;
+}
+
+HeroVolPathIntegrator *CreateHeroVolPathIntegrator(const ParamSet &params,
+                                                   std::shared_ptr<Sampler> sampler,
+                                                   std::shared_ptr<const Camera> camera) {
+    int maxDepth = params.FindOneInt("maxdepth", 5);
+    int np;
+    const int *pb = params.FindInt("pixelbounds", &np);
+    Bounds2i pixelBounds = camera->film->GetSampleBounds();
+    if (pb) {
+        if (np != 4)
+            Error("Expected four values for \"pixelbounds\" parameter. Got %d.",
+                  np);
+        else {
+            pixelBounds = Intersect(pixelBounds,
+                                    Bounds2i{{pb[0], pb[2]}, {pb[1], pb[3]}});
+            if (pixelBounds.Area() == 0)
+                Error("Degenerate \"pixelbounds\" specified.");
+        }
+    }
+    Float rrThreshold = params.FindOneFloat("rrthreshold", 1.);
+    std::string lightStrategy =
+        params.FindOneString("lightsamplestrategy", "spatial");
+    std::string wvlStrategy =
+        params.FindOneString("wavelengthsamplestrategy", "xyz");
+    int trainingSpp = params.FindOneInt("spectraltrainingspp", 0);
+    return new HeroVolPathIntegrator(maxDepth, camera, sampler, pixelBounds,
+                                     rrThreshold, lightStrategy, wvlStrategy,
+                                     trainingSpp);
+}
+} // namespace pbrt
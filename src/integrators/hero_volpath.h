@@ -0,0 +1,95 @@
+/*
+    pbrt source code is Copyright(c) 1998-2016
+                        Matt Pharr, Greg Humphreys, and Wenzel Jakob.
+
+    This file is part of pbrt.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are
+    met:
+
+    - Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    - Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+    IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+    TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+    PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#if defined(_MSC_VER)
+#define NOMINMAX
+#pragma once
+#endif
+
+#ifndef PBRT_INTEGRATORS_HERO_VOLPATH_H
+#define PBRT_INTEGRATORS_HERO_VOLPATH_H
+
+#include "pbrt.h"
+#include "hero.h"
+#include "lightdistrib.h"
+
+namespace pbrt {
+
+/* Volumetric path tracer for hero wavelength packets. Distances through media 
+   are sampled once per packet with spectral delta tracking driven by the hero
+   wavelength, and each wavelength's contribution is weighted by the spectral MIS
+   balance heuristic over the densities of all wavelengths in the packet. */
+class HeroVolPathIntegrator : public HeroSamplerIntegrator {
+public:
+  // HeroVolPathIntegrator public methods
+  HeroVolPathIntegrator(int maxDepth, 
+                        std::shared_ptr<const Camera> camera,
+                        std::shared_ptr<Sampler> sampler,
+                        const Bounds2i &pixelBounds, 
+                        Float rrThreshold = 1,
+                        const std::string &lightSampleStrategy = "spatial",
+                        const std::string &wvlSampleStrategy = "xyz",
+                        int spectralTrainingSpp = 0);
+  void Preprocess(const Scene &scene, 
+                  Sampler &sampler);
+  WvlPacketf LiWvls(const RayDifferential &ray, 
+                    const Scene &scene,
+                    Sampler &sampler,
+                    MemoryArena &arena, 
+                    Spectrum *Lfull,
+                    int depth) const;
+
+private:
+  // HeroVolPathIntegrator private methods
+  WvlPacketf SampleEmitter(const Interaction &it,
+                           const BSDF *bsdf,
+                           const WvlPacketi &wvlIdx,
+                           const WvlPacketf &pathWvlPdf,
+                           const Scene &scene,
+                           Sampler &sampler) const;
+  Float PdfEmitter(const Light *light,
+                   const Interaction &ref,
+                   const Vector3f &wi,
+                   const Scene &scene) const;
+
+  // HeroVolPathIntegrator private components
+  const int maxDepth;
+  const Float rrThreshold;
+  const std::string lightSampleStrategy;
+  std::unique_ptr<LightDistribution> lightDistribution;
+};
+
+HeroVolPathIntegrator *CreateHeroVolPathIntegrator(const ParamSet &params,
+                                                   std::shared_ptr<Sampler> sampler,
+                                                   std::shared_ptr<const Camera> camera);
+} // namespace pbrt
+
+#endif  // PBRT_INTEGRATORS_HERO_VOLPATH_H
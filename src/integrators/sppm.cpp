@@ -112,6 +112,7 @@ void SPPMIntegrator::Render(const Scene &scene) {
     ProfilePhase p(Prof::IntegratorRender);
     // Initialize _pixelBounds_ and _pixels_ array for SPPM
     Bounds2i pixelBounds = camera->film->croppedPixelBounds;
+    camera->film->BufferSpectralImage();
     int nPixels = pixelBounds.Area();
     std::unique_ptr<SPPMPixel[]> pixels(new SPPMPixel[nPixels]);
     for (int i = 0; i < nPixels; ++i) pixels[i].radius = initialSearchRadius;
@@ -126,7 +127,7 @@ void SPPMIntegrator::Render(const Scene &scene) {
 
     // Compute number of tiles to use for SPPM camera pass
     Vector2i pixelExtent = pixelBounds.Diagonal();
-    const int tileSize = 16;
+    const int tileSize = Film::tileSize;
     Point2i nTiles((pixelExtent.x + tileSize - 1) / tileSize,
                    (pixelExtent.y + tileSize - 1) / tileSize);
     ProgressReporter progress(2 * nIterations, "Rendering");
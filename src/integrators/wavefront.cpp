@@ -0,0 +1,520 @@
+
+/*
+    pbrt source code is Copyright(c) 1998-2016
+                        Matt Pharr, Greg Humphreys, and Wenzel Jakob.
+
+    This file is part of pbrt.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are
+    met:
+
+    - Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    - Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+    IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+    TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+    PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+// integrators/wavefront.cpp*
+#include "integrators/wavefront.h"
+#include "bssrdf.h"
+#include "camera.h"
+#include "film.h"
+#include "interaction.h"
+#include "lights/portal_arealight.h"
+#include "paramset.h"
+#include "parallel.h"
+#include "progressreporter.h"
+#include "samplers/random.h"
+#include "scene.h"
+#include "stats.h"
+#include <chrono>
+
+namespace pbrt {
+
+STAT_COUNTER("Integrator/Camera rays traced", nCameraRays);
+STAT_INT_DISTRIBUTION("Integrator/Path length", pathLength);
+STAT_INT_DISTRIBUTION("Integrator/Wavefront paths in flight", pathsInFlight);
+STAT_RATIO("Integrator/Rays traced per thread-microsecond", nTileRays,
+           nTileMicroseconds);
+
+// Structure-of-arrays state of the paths in flight; a path keeps its slot
+// until the queue is flushed, and the index lists select the slots that
+// take part in the current stage
+struct PathQueue {
+    explicit PathQueue(int capacity)
+        : ray(capacity),
+          L(capacity),
+          beta(capacity),
+          etaScale(capacity),
+          rayWeight(capacity),
+          pFilm(capacity),
+          bounces(capacity),
+          specularBounce(capacity),
+          foundIntersection(capacity),
+          isect(capacity) {
+        active.reserve(capacity);
+        shading.reserve(capacity);
+        next.reserve(capacity);
+    }
+    bool Full() const { return size == (int)ray.size(); }
+    void Push(const RayDifferential &r, const Point2f &p, Float weight) {
+        int i = size++;
+        ray[i] = r;
+        L[i] = Spectrum(0.f);
+        beta[i] = Spectrum(1.f);
+        etaScale[i] = 1;
+        rayWeight[i] = weight;
+        pFilm[i] = p;
+        bounces[i] = 0;
+        specularBounce[i] = false;
+        if (weight > 0) active.push_back(i);
+    }
+    void Clear() {
+        size = 0;
+        active.clear();
+        shading.clear();
+        next.clear();
+    }
+
+    // PathQueue Per-Path Data
+    std::vector<RayDifferential> ray;
+    std::vector<Spectrum> L, beta;
+    std::vector<Float> etaScale, rayWeight;
+    std::vector<Point2f> pFilm;
+    std::vector<int> bounces;
+    std::vector<uint8_t> specularBounce, foundIntersection;
+    std::vector<SurfaceInteraction> isect;
+
+    // Slots still tracing, slots with a BSDF at the current vertex, and
+    // slots that continue with the next bounce
+    std::vector<int> active, shading, next;
+    int size = 0;
+};
+
+// Rays queued by light sampling, each carrying the contribution it adds to
+// its path if it reaches the light; _light_ is null for shadow rays
+struct LightRayQueue {
+    void Clear() {
+        path.clear();
+        ray.clear();
+        weight.clear();
+        light.clear();
+    }
+    void Push(int p, const Ray &r, const Spectrum &w, const Light *l) {
+        path.push_back(p);
+        ray.push_back(r);
+        weight.push_back(w);
+        light.push_back(l);
+    }
+    size_t size() const { return path.size(); }
+
+    // LightRayQueue Data
+    std::vector<int> path;
+    std::vector<Ray> ray;
+    std::vector<Spectrum> weight;
+    std::vector<const Light *> light;
+};
+
+// WavefrontPathIntegrator Method Definitions
+WavefrontPathIntegrator::WavefrontPathIntegrator(
+    int maxDepth, std::shared_ptr<const Camera> camera,
+    std::shared_ptr<Sampler> sampler, const Bounds2i &pixelBounds,
+    int queueSize, Float rrThreshold, const std::string &lightSampleStrategy)
+    : camera(camera),
+      sampler(sampler),
+      pixelBounds(pixelBounds),
+      maxDepth(maxDepth),
+      queueSize(queueSize),
+      rrThreshold(rrThreshold),
+      lightSampleStrategy(lightSampleStrategy) {}
+
+void WavefrontPathIntegrator::Render(const Scene &scene) {
+    lightDistribution =
+        CreateLightSampleDistribution(lightSampleStrategy, scene);
+
+    // Compute number of tiles, _nTiles_, to use for parallel rendering
+    Bounds2i sampleBounds = camera->film->GetSampleBounds();
+    Vector2i sampleExtent = sampleBounds.Diagonal();
+    const int tileSize = Film::tileSize;
+    Point2i nTiles((sampleExtent.x + tileSize - 1) / tileSize,
+                   (sampleExtent.y + tileSize - 1) / tileSize);
+    ProgressReporter reporter(nTiles.x * nTiles.y, "Rendering");
+    ParallelFor2D([&](Point2i tile) {
+        auto tileStart = std::chrono::steady_clock::now();
+        int64_t tileRaysStart = Scene::ThreadRaysTraced();
+        MemoryArena arena;
+        int seed = tile.y * nTiles.x + tile.x;
+        std::unique_ptr<Sampler> tileSampler = sampler->Clone(seed);
+
+        // The tile sampler's sample vectors are laid out per pixel and
+        // cannot be interleaved across the paths in flight, so it only
+        // provides camera samples; path stages draw independent uniform
+        // numbers in kernel order
+        RandomSampler pathSampler(1, seed);
+
+        // Compute sample bounds for tile
+        int x0 = sampleBounds.pMin.x + tile.x * tileSize;
+        int x1 = std::min(x0 + tileSize, sampleBounds.pMax.x);
+        int y0 = sampleBounds.pMin.y + tile.y * tileSize;
+        int y1 = std::min(y0 + tileSize, sampleBounds.pMax.y);
+        Bounds2i tileBounds(Point2i(x0, y0), Point2i(x1, y1));
+        LOG(INFO) << "Starting image tile " << tileBounds;
+        pathSampler.StartPixel(tileBounds.pMin);
+        std::unique_ptr<FilmTile> filmTile =
+            camera->film->GetFilmTile(tileBounds);
+
+        // Trace the queued paths together and add them to the image
+        PathQueue paths(queueSize);
+        LightRayQueue shadowRays, emitterRays;
+        auto flush = [&]() {
+            TracePaths(scene, paths, shadowRays, emitterRays, pathSampler,
+                       arena);
+            for (int i = 0; i < paths.size; ++i) {
+                Spectrum L = paths.L[i];
+                if (L.HasNaNs()) {
+                    LOG(ERROR) << "Not-a-number radiance value returned "
+                                  "for film position " << paths.pFilm[i] <<
+                                  ". Setting to black.";
+                    L = Spectrum(0.f);
+                } else if (L.y() < -1e-5) {
+                    LOG(ERROR) << StringPrintf(
+                        "Negative luminance value, %f, returned ", L.y()) <<
+                        "for film position " << paths.pFilm[i] <<
+                        ". Setting to black.";
+                    L = Spectrum(0.f);
+                } else if (std::isinf(L.y())) {
+                    LOG(ERROR) << "Infinite luminance value returned "
+                                  "for film position " << paths.pFilm[i] <<
+                                  ". Setting to black.";
+                    L = Spectrum(0.f);
+                }
+                filmTile->AddSample(paths.pFilm[i], L, paths.rayWeight[i]);
+            }
+            paths.Clear();
+        };
+
+        // Queue camera rays for every sample of the tile's pixels
+        for (Point2i pixel : tileBounds) {
+            {
+                ProfilePhase pp(Prof::StartPixel);
+                tileSampler->StartPixel(pixel);
+            }
+            if (!InsideExclusive(pixel, pixelBounds)) continue;
+            do {
+                CameraSample cameraSample =
+                    tileSampler->GetCameraSample(pixel);
+                RayDifferential ray;
+                Float rayWeight =
+                    camera->GenerateRayDifferential(cameraSample, &ray);
+                ray.ScaleDifferentials(
+                    1 / std::sqrt((Float)tileSampler->samplesPerPixel));
+                ++nCameraRays;
+                paths.Push(ray, cameraSample.pFilm, rayWeight);
+                if (paths.Full()) flush();
+            } while (tileSampler->StartNextSample());
+        }
+        flush();
+        LOG(INFO) << "Finished image tile " << tileBounds;
+
+        // Record the tile's ray throughput
+        nTileRays += std::max<int64_t>(
+            0, Scene::ThreadRaysTraced() - tileRaysStart);
+        nTileMicroseconds +=
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - tileStart)
+                .count();
+
+        // Merge image tile into _Film_
+        camera->film->MergeFilmTile(std::move(filmTile));
+        reporter.Update();
+    }, nTiles);
+    reporter.Done();
+    LOG(INFO) << "Rendering finished";
+
+    // Save final image after rendering
+    camera->film->WriteImage();
+}
+
+void WavefrontPathIntegrator::TracePaths(const Scene &scene, PathQueue &paths,
+                                         LightRayQueue &shadowRays,
+                                         LightRayQueue &emitterRays,
+                                         Sampler &sampler,
+                                         MemoryArena &arena) const {
+    // Advance all paths in flight by one vertex per iteration
+    while (!paths.active.empty()) {
+        ReportValue(pathsInFlight, paths.active.size());
+        IntersectKernel(scene, paths);
+        EmissionKernel(scene, paths);
+        MaterialKernel(paths, arena);
+        LightSampleKernel(scene, paths, shadowRays, emitterRays, sampler,
+                          arena);
+        ShadowKernel(scene, paths, shadowRays);
+        EmitterHitKernel(scene, paths, emitterRays);
+        ScatterKernel(scene, paths, sampler, arena);
+        std::swap(paths.active, paths.next);
+        paths.next.clear();
+        arena.Reset();
+    }
+}
+
+void WavefrontPathIntegrator::IntersectKernel(const Scene &scene,
+                                              PathQueue &paths) const {
+    for (int i : paths.active)
+        paths.foundIntersection[i] =
+            scene.Intersect(paths.ray[i], &paths.isect[i]);
+}
+
+void WavefrontPathIntegrator::EmissionKernel(const Scene &scene,
+                                             PathQueue &paths) const {
+    // Add emission found by camera and specular rays, then retire paths
+    // that escaped or reached _maxDepth_
+    size_t nActive = 0;
+    for (int i : paths.active) {
+        const RayDifferential &ray = paths.ray[i];
+        if (paths.bounces[i] == 0 || paths.specularBounce[i]) {
+            if (paths.foundIntersection[i])
+                paths.L[i] += paths.beta[i] * paths.isect[i].Le(-ray.d);
+            else
+                for (const auto &light : scene.infiniteLights)
+                    paths.L[i] += paths.beta[i] * light->Le(ray);
+        }
+        if (!paths.foundIntersection[i] || paths.bounces[i] >= maxDepth) {
+            ReportValue(pathLength, paths.bounces[i]);
+            continue;
+        }
+        paths.active[nActive++] = i;
+    }
+    paths.active.resize(nActive);
+}
+
+void WavefrontPathIntegrator::MaterialKernel(PathQueue &paths,
+                                             MemoryArena &arena) const {
+    // Compute scattering functions and skip over medium boundaries
+    paths.shading.clear();
+    for (int i : paths.active) {
+        SurfaceInteraction &isect = paths.isect[i];
+        isect.ComputeScatteringFunctions(paths.ray[i], arena, true);
+        if (isect.bsdf)
+            paths.shading.push_back(i);
+        else {
+            paths.ray[i] = isect.SpawnRay(paths.ray[i].d);
+            paths.next.push_back(i);
+        }
+    }
+}
+
+void WavefrontPathIntegrator::LightSampleKernel(
+    const Scene &scene, PathQueue &paths, LightRayQueue &shadowRays,
+    LightRayQueue &emitterRays, Sampler &sampler, MemoryArena &arena) const {
+    // Queue the rays of _UniformSampleOneLight()_'s two MIS strategies
+    shadowRays.Clear();
+    emitterRays.Clear();
+    if (scene.lights.empty()) return;
+    const BxDFType bsdfFlags = BxDFType(BSDF_ALL & ~BSDF_SPECULAR);
+    for (int i : paths.shading) {
+        const SurfaceInteraction &isect = paths.isect[i];
+        if (isect.bsdf->NumComponents(bsdfFlags) == 0) continue;
+
+        // Choose a light to sample
+        const Distribution1D *distrib = lightDistribution->Lookup(isect.p);
+        Float lightPdf;
+        int lightNum = distrib->SampleDiscrete(sampler.Get1D(), &lightPdf);
+        if (lightPdf == 0) continue;
+        const std::shared_ptr<Light> &light = scene.lights[lightNum];
+        Point2f uLight = sampler.Get2D();
+        Point2f uScattering = sampler.Get2D();
+
+        // Portal lights run their own estimator; evaluate them in place
+        if (std::dynamic_pointer_cast<PortalArealight>(light)) {
+            paths.L[i] += paths.beta[i] *
+                          EstimateDirect(isect, uScattering, light, uLight,
+                                         scene, sampler, arena) /
+                          lightPdf;
+            continue;
+        }
+        Spectrum scale = paths.beta[i] / lightPdf;
+
+        // Sample the light and queue a shadow ray towards it
+        Vector3f wi;
+        Float lightPdfDir = 0, scatteringPdf = 0;
+        VisibilityTester visibility;
+        Spectrum Li =
+            light->Sample_Li(isect, uLight, &wi, &lightPdfDir, &visibility);
+        if (lightPdfDir > 0 && !Li.IsBlack()) {
+            Spectrum f = isect.bsdf->f(isect.wo, wi, bsdfFlags) *
+                         AbsDot(wi, isect.shading.n);
+            scatteringPdf = isect.bsdf->Pdf(isect.wo, wi, bsdfFlags);
+            if (!f.IsBlack()) {
+                Float weight =
+                    IsDeltaLight(light->flags)
+                        ? 1
+                        : PowerHeuristic(1, lightPdfDir, 1, scatteringPdf);
+                shadowRays.Push(i, visibility.P0().SpawnRayTo(visibility.P1()),
+                                scale * f * Li * weight / lightPdfDir,
+                                nullptr);
+            }
+        }
+
+        // Sample the BSDF and queue a ray that may hit the light
+        if (IsDeltaLight(light->flags)) continue;
+        BxDFType sampledType;
+        Spectrum f = isect.bsdf->Sample_f(isect.wo, &wi, uScattering,
+                                          &scatteringPdf, bsdfFlags,
+                                          &sampledType);
+        if (f.IsBlack() || scatteringPdf == 0) continue;
+        f *= AbsDot(wi, isect.shading.n);
+        Float weight = 1;
+        if (!(sampledType & BSDF_SPECULAR)) {
+            lightPdfDir = light->Pdf_Li(isect, wi);
+            if (lightPdfDir == 0) continue;
+            weight = PowerHeuristic(1, scatteringPdf, 1, lightPdfDir);
+        }
+        emitterRays.Push(i, isect.SpawnRay(wi),
+                         scale * f * weight / scatteringPdf, light.get());
+    }
+}
+
+void WavefrontPathIntegrator::ShadowKernel(
+    const Scene &scene, PathQueue &paths,
+    const LightRayQueue &shadowRays) const {
+    // Shadow rays are queued in pixel order, so neighbouring rays tend to
+    // be coherent and the queue is traced as packets
+    int nRays = shadowRays.size();
+    std::unique_ptr<bool[]> occluded(new bool[nRays]);
+    scene.IntersectPPacket(shadowRays.ray.data(), nRays, occluded.get());
+    for (int k = 0; k < nRays; ++k)
+        if (!occluded[k]) paths.L[shadowRays.path[k]] += shadowRays.weight[k];
+}
+
+void WavefrontPathIntegrator::EmitterHitKernel(
+    const Scene &scene, PathQueue &paths,
+    const LightRayQueue &emitterRays) const {
+    // Add emission of the sampled light where BSDF-sampled rays reach it
+    for (size_t k = 0; k < emitterRays.size(); ++k) {
+        const Ray &ray = emitterRays.ray[k];
+        SurfaceInteraction lightIsect;
+        Spectrum Li(0.f);
+        if (scene.Intersect(ray, &lightIsect)) {
+            if (lightIsect.primitive->GetAreaLight() == emitterRays.light[k])
+                Li = lightIsect.Le(-ray.d);
+        } else
+            Li = emitterRays.light[k]->Le(RayDifferential(ray));
+        if (!Li.IsBlack())
+            paths.L[emitterRays.path[k]] += emitterRays.weight[k] * Li;
+    }
+}
+
+void WavefrontPathIntegrator::ScatterKernel(const Scene &scene,
+                                            PathQueue &paths,
+                                            Sampler &sampler,
+                                            MemoryArena &arena) const {
+    // Sample BSDFs for the next path directions and apply Russian roulette
+    for (int i : paths.shading) {
+        const SurfaceInteraction &isect = paths.isect[i];
+        Spectrum &beta = paths.beta[i];
+        Vector3f wo = -paths.ray[i].d, wi;
+        Float pdf;
+        BxDFType flags;
+        Spectrum f = isect.bsdf->Sample_f(wo, &wi, sampler.Get2D(), &pdf,
+                                          BSDF_ALL, &flags);
+        if (f.IsBlack() || pdf == 0.f) {
+            ReportValue(pathLength, paths.bounces[i]);
+            continue;
+        }
+        beta *= f * AbsDot(wi, isect.shading.n) / pdf;
+        DCHECK(!std::isinf(beta.y()));
+        paths.specularBounce[i] = (flags & BSDF_SPECULAR) != 0;
+        if ((flags & BSDF_SPECULAR) && (flags & BSDF_TRANSMISSION)) {
+            Float eta = isect.bsdf->eta;
+            paths.etaScale[i] *=
+                (Dot(wo, isect.n) > 0) ? (eta * eta) : 1 / (eta * eta);
+        }
+        paths.ray[i] = isect.SpawnRay(wi);
+
+        // Account for subsurface scattering in place; its probe rays do
+        // not fit the batched stages
+        if (isect.bssrdf && (flags & BSDF_TRANSMISSION)) {
+            SurfaceInteraction pi;
+            Spectrum S = isect.bssrdf->Sample_S(
+                scene, sampler.Get1D(), sampler.Get2D(), arena, &pi, &pdf);
+            if (S.IsBlack() || pdf == 0) {
+                ReportValue(pathLength, paths.bounces[i]);
+                continue;
+            }
+            beta *= S / pdf;
+            paths.L[i] += beta * UniformSampleOneLight(
+                                     pi, scene, arena, sampler, false,
+                                     lightDistribution->Lookup(pi.p));
+            f = pi.bsdf->Sample_f(pi.wo, &wi, sampler.Get2D(), &pdf, BSDF_ALL,
+                                  &flags);
+            if (f.IsBlack() || pdf == 0) {
+                ReportValue(pathLength, paths.bounces[i]);
+                continue;
+            }
+            beta *= f * AbsDot(wi, pi.shading.n) / pdf;
+            paths.specularBounce[i] = (flags & BSDF_SPECULAR) != 0;
+            paths.ray[i] = pi.SpawnRay(wi);
+        }
+
+        // Possibly terminate the path with Russian roulette
+        Spectrum rrBeta = beta * paths.etaScale[i];
+        if (rrBeta.MaxComponentValue() < rrThreshold && paths.bounces[i] > 3) {
+            Float q = std::max((Float).05, 1 - rrBeta.MaxComponentValue());
+            if (sampler.Get1D() < q) {
+                ReportValue(pathLength, paths.bounces[i]);
+                continue;
+            }
+            beta /= 1 - q;
+        }
+        ++paths.bounces[i];
+        paths.next.push_back(i);
+    }
+}
+
+WavefrontPathIntegrator *CreateWavefrontPathIntegrator(
+    const ParamSet &params, std::shared_ptr<Sampler> sampler,
+    std::shared_ptr<const Camera> camera) {
+    int maxDepth = params.FindOneInt("maxdepth", 5);
+    int np;
+    const int *pb = params.FindInt("pixelbounds", &np);
+    Bounds2i pixelBounds = camera->film->GetSampleBounds();
+    if (pb) {
+        if (np != 4)
+            Error("Expected four values for \"pixelbounds\" parameter. Got %d.",
+                  np);
+        else {
+            pixelBounds = Intersect(pixelBounds,
+                                    Bounds2i{{pb[0], pb[2]}, {pb[1], pb[3]}});
+            if (pixelBounds.Area() == 0)
+                Error("Degenerate \"pixelbounds\" specified.");
+        }
+    }
+    int queueSize = params.FindOneInt("queuesize", 4096);
+    if (queueSize < 1) {
+        Error("\"queuesize\" must be positive. Using 4096.");
+        queueSize = 4096;
+    }
+    Float rrThreshold = params.FindOneFloat("rrthreshold", 1.);
+    std::string lightStrategy =
+        params.FindOneString("lightsamplestrategy", "uniform");
+    return new WavefrontPathIntegrator(maxDepth, camera, sampler, pixelBounds,
+                                       queueSize, rrThreshold, lightStrategy);
+}
+
+}  // namespace pbrt
@@ -48,8 +48,14 @@ static void usage(const char *msg = nullptr) {
 Rendering options:
   --cropwindow <x0,x1,y0,y1> Specify an image crop window.
   --help               Print this help text.
+  --multiframe         Render each WorldBegin/WorldEnd block as a frame of
+                       one animation: object instances stay resident and
+                       the aggregate over them is refit between frames.
   --nthreads <num>     Use specified number of threads for rendering.
   --outfile <filename> Write the final image to the given filename.
+  --pinthreads         Pin each rendering thread to a core, spreading them
+                       over NUMA nodes, so that per-thread memory is
+                       allocated on the thread's own node.
   --quick              Automatically reduce a number of quality settings to
                        render more quickly.
   --quiet              Suppress all text output other than error messages.
@@ -113,6 +119,12 @@ int main(int argc, char *argv[]) {
             FLAGS_minloglevel = atoi(argv[++i]);
         } else if (!strncmp(argv[i], "--minloglevel=", 14)) {
             FLAGS_minloglevel = atoi(&argv[i][14]);
+        } else if (!strcmp(argv[i], "--multiframe") ||
+                   !strcmp(argv[i], "-multiframe")) {
+            options.multiFrame = true;
+        } else if (!strcmp(argv[i], "--pinthreads") ||
+                   !strcmp(argv[i], "-pinthreads")) {
+            options.pinThreads = true;
         } else if (!strcmp(argv[i], "--quick") || !strcmp(argv[i], "-quick")) {
             options.quickRender = true;
         } else if (!strcmp(argv[i], "--quiet") || !strcmp(argv[i], "-quiet")) {
@@ -38,6 +38,7 @@
 #include "paramset.h"
 #include "texture.h"
 #include "interaction.h"
+#include "textures/constant.h"
 
 namespace pbrt {
 
@@ -45,39 +46,76 @@ static const Float lambdaMinSq = sampledLambdaStart * sampledLambdaStart;
 static const Float lambdaMaxSq = sampledLambdaEnd * sampledLambdaEnd;
 
 // DispersiveGlassMaterial Method Definitions
+DispersiveGlassMaterial::DispersiveGlassMaterial(
+    const std::shared_ptr<Texture<Spectrum>> &Kr,
+    const std::shared_ptr<Texture<Spectrum>> &Kt,
+    const std::shared_ptr<Texture<Float>> &uRoughness,
+    const std::shared_ptr<Texture<Float>> &vRoughness,
+    const std::shared_ptr<Texture<Float>> &indexMin,
+    const std::shared_ptr<Texture<Float>> &indexMax,
+    const std::shared_ptr<Texture<Float>> &bumpMap, bool remapRoughness)
+    : Kr(Kr),
+      Kt(Kt),
+      uRoughness(uRoughness),
+      vRoughness(vRoughness),
+      indexMin(indexMin),
+      indexMax(indexMax),
+      bumpMap(bumpMap),
+      remapRoughness(remapRoughness),
+      cauchyB(0),
+      cauchyC(0) {
+    // Precompute Cauchy's equation if the index of refraction is constant
+    auto etaMinConst =
+        dynamic_cast<const ConstantTexture<Float> *>(indexMin.get());
+    auto etaMaxConst =
+        dynamic_cast<const ConstantTexture<Float> *>(indexMax.get());
+    constantEta = etaMinConst && etaMaxConst;
+    if (constantEta) {
+        SurfaceInteraction si;
+        CauchyCoefficients(etaMinConst->Evaluate(si),
+                           etaMaxConst->Evaluate(si), &cauchyB, &cauchyC);
+    }
+}
+
+void DispersiveGlassMaterial::CauchyCoefficients(Float etaMin, Float etaMax,
+                                                 Float *B, Float *C) {
+    *B = (lambdaMinSq * etaMax - lambdaMaxSq * etaMin)
+       / (lambdaMinSq - lambdaMaxSq);
+    *C = lambdaMinSq * (etaMax - *B);
+}
+
 void DispersiveGlassMaterial::ComputeScatteringFunctions(SurfaceInteraction *si,
                                                MemoryArena &arena,
                                                TransportMode mode,
                                                bool allowMultipleLobes) const {
     // Perform bump mapping with _bumpMap_, if present
     if (bumpMap) Bump(bumpMap, si);
-    Float etaMin = indexMin->Evaluate(*si);
-    Float etaMax = indexMax->Evaluate(*si);
     Float urough = uRoughness->Evaluate(*si);
     Float vrough = vRoughness->Evaluate(*si);
     Spectrum R = Kr->Evaluate(*si).Clamp();
-    Spectrum T = Kt->Evaluate(*si).Clamp();
 
-    // Compute cauchy's equation on the fly
-    const Float cauchyB = (lambdaMinSq * etaMax - lambdaMaxSq * etaMin)
-                        / (lambdaMinSq - lambdaMaxSq);
-    const Float cauchyC = lambdaMinSq * (etaMax - cauchyB);
+    // Refraction makes the path depend on the packet wavelengths, so only
+    // their bins of the transmittance are ever read
+    Spectrum T(0.f);
+    const WvlPacketf wvlT = EvaluateWvls(*Kt, *si);
+    for (int i = 0; i < wvlT.nSamples; ++i)
+        T[Spectrum::indexFromWavelength(si->wvls[i])] =
+            std::max(wvlT[i], (Float)0);
 
-    const Float t_eta = cauchyB + cauchyC / (sampledLambdaStart * sampledLambdaEnd);
-    // std::cout << "Recomputed ETA: " << t_eta << std::endl;
+    // Obtain Cauchy's equation, computing it on the fly for textured indices
+    Float B = cauchyB, C = cauchyC;
+    if (!constantEta)
+        CauchyCoefficients(indexMin->Evaluate(*si), indexMax->Evaluate(*si),
+                           &B, &C);
 
     // Compute ETA for given wavelength packet
-    const Vector4f wvl_etas = Vector4f(cauchyB)
-                            + Vector4f(cauchyC)
-                            / (si->wvls * si->wvls);
-
-    
-    // Initialize different scattering components for computed etas
-    si->bsdf = (arena.AllocUndeclared<BSDF>(4));
-    new(&si->bsdf[0]) BSDF(*si, wvl_etas[0]);
-    new(&si->bsdf[1]) BSDF(*si, wvl_etas[1]);
-    new(&si->bsdf[2]) BSDF(*si, wvl_etas[2]);
-    new(&si->bsdf[3]) BSDF(*si, wvl_etas[3]);
+    const WvlPacketf wvl_etas = WvlPacketf(B)
+                              + WvlPacketf(C)
+                              / (si->wvls * si->wvls);
+
+    // Initialize a single BSDF; secondary wavelengths are evaluated through
+    // the packet-aware _DispersiveDielectric_
+    si->bsdf = ARENA_ALLOC(arena, BSDF)(*si, wvl_etas[0]);
 
     // No reflective/transmittive components
     if (R.IsBlack() && T.IsBlack()) return;
@@ -85,41 +123,17 @@ void DispersiveGlassMaterial::ComputeScatteringFunctions(SurfaceInteraction *si,
     // Interacted with a dispersive material; introduce wavelength depencency
     si->isWvlDependent = true;
 
-    // Set up BSDF for each wavelength
     bool isSpecular = urough == 0 && vrough == 0;
-    for (int i = 0; i < 4; ++i) {
-        const Float eta = wvl_etas[i];
-        if (isSpecular && allowMultipleLobes) {
-            si->bsdf[i].Add(
-                ARENA_ALLOC(arena, FresnelSpecular)(R, T, 1.f, eta, mode));
-        } else {
-            if (remapRoughness) {
-                urough = TrowbridgeReitzDistribution::RoughnessToAlpha(urough);
-                vrough = TrowbridgeReitzDistribution::RoughnessToAlpha(vrough);
-            }
-            MicrofacetDistribution *distrib =
-                isSpecular ? nullptr
-                        : ARENA_ALLOC(arena, TrowbridgeReitzDistribution)(
-                                urough, vrough);
-            if (!R.IsBlack()) {
-                Fresnel *fresnel = ARENA_ALLOC(arena, FresnelDielectric)(1.f, eta);
-                if (isSpecular)
-                    si->bsdf[i].Add(
-                        ARENA_ALLOC(arena, SpecularReflection)(R, fresnel));
-                else
-                    si->bsdf[i].Add(ARENA_ALLOC(arena, MicrofacetReflection)(
-                        R, distrib, fresnel));
-            }
-            if (!T.IsBlack()) {
-                if (isSpecular)
-                    si->bsdf[i].Add(ARENA_ALLOC(arena, SpecularTransmission)(
-                        T, 1.f, eta, mode));
-                else
-                    si->bsdf[i].Add(ARENA_ALLOC(arena, MicrofacetTransmission)(
-                        T, distrib, 1.f, eta, mode));
-            }
+    MicrofacetDistribution *distrib = nullptr;
+    if (!isSpecular) {
+        if (remapRoughness) {
+            urough = TrowbridgeReitzDistribution::RoughnessToAlpha(urough);
+            vrough = TrowbridgeReitzDistribution::RoughnessToAlpha(vrough);
         }
+        distrib = ARENA_ALLOC(arena, TrowbridgeReitzDistribution)(urough, vrough);
     }
+    si->bsdf->Add(
+        ARENA_ALLOC(arena, DispersiveDielectric)(R, T, distrib, wvl_etas, mode));
 }
 
 DispersiveGlassMaterial *CreateDispersiveGlassMaterial(const TextureParams &mp) {
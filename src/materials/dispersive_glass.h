@@ -55,20 +55,16 @@ class DispersiveGlassMaterial : public Material {
                             const std::shared_ptr<Texture<Float>> &indexMin,
                             const std::shared_ptr<Texture<Float>> &indexMax,
                             const std::shared_ptr<Texture<Float>> &bumpMap,
-                            bool remapRoughness)
-        : Kr(Kr),
-          Kt(Kt),
-          uRoughness(uRoughness),
-          vRoughness(vRoughness),
-          indexMin(indexMin),
-          indexMax(indexMax),
-          bumpMap(bumpMap),
-          remapRoughness(remapRoughness) {}
+                            bool remapRoughness);
     void ComputeScatteringFunctions(SurfaceInteraction *si, MemoryArena &arena,
                                     TransportMode mode,
                                     bool allowMultipleLobes) const;
 
   private:
+    // DispersiveGlassMaterial Private Methods
+    static void CauchyCoefficients(Float etaMin, Float etaMax, Float *B,
+                                   Float *C);
+
     // DispersiveGlassMaterial Private Data
     std::shared_ptr<Texture<Spectrum>> Kr, Kt;
     std::shared_ptr<Texture<Float>> uRoughness, vRoughness;
@@ -76,6 +72,8 @@ class DispersiveGlassMaterial : public Material {
     std::shared_ptr<Texture<Float>> indexMax;
     std::shared_ptr<Texture<Float>> bumpMap;
     bool remapRoughness;
+    bool constantEta;
+    Float cauchyB, cauchyC;
 };
 
 DispersiveGlassMaterial *CreateDispersiveGlassMaterial(const TextureParams &mp);
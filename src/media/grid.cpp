@@ -117,4 +117,85 @@ Spectrum GridDensityMedium::Tr(const Ray &rWorld, Sampler &sampler) const {
     return Spectrum(Tr);
 }
 
+WvlPacketf GridDensityMedium::TrWvls(const Ray &rWorld,
+                                     Sampler &sampler) const {
+    ProfilePhase _(Prof::MediumTr);
+    ++nTrCalls;
+
+    Ray ray = WorldToMedium(
+        Ray(rWorld.o, Normalize(rWorld.d), rWorld.tMax * rWorld.d.Length()));
+    // Compute $[\tmin, \tmax]$ interval of _ray_'s overlap with medium bounds
+    const Bounds3f b(Point3f(0, 0, 0), Point3f(1, 1, 1));
+    Float tMin, tMax;
+    if (sigma_tMax == 0 || !b.IntersectP(ray, &tMin, &tMax))
+        return WvlPacketf(1.f);
+
+    // Perform ratio tracking against the spectral majorant; the tentative
+    // collisions are shared by all wavelengths of the packet
+    WvlPacketf sig_t = SpectrumAtWvls(sigma_a + sigma_s, rWorld.wvls);
+    WvlPacketf Tr(1.f);
+    Float t = tMin;
+    while (true) {
+        ++nTrSteps;
+        t -= std::log(1 - sampler.Get1D()) * invMaxDensity / sigma_tMax;
+        if (t >= tMax) break;
+        Float density = Density(ray(t)) * invMaxDensity / sigma_tMax;
+        Float TrMax = 0;
+        for (int i = 0; i < Tr.nSamples; ++i) {
+            Tr[i] *= 1 - std::max((Float)0, density * sig_t[i]);
+            TrMax = std::max(TrMax, Tr[i]);
+        }
+        // Apply Russian roulette once every wavelength carries little energy
+        const Float rrThreshold = .1;
+        if (TrMax < rrThreshold) {
+            Float q = std::max((Float).05, 1 - TrMax);
+            if (sampler.Get1D() < q) return WvlPacketf(0.f);
+            Tr /= 1 - q;
+        }
+    }
+    return Tr;
+}
+
+WvlPacketf GridDensityMedium::SampleWvls(const Ray &rWorld, Sampler &sampler,
+                                         MemoryArena &arena,
+                                         MediumInteraction *mi,
+                                         WvlPacketf *wvlPdf) const {
+    ProfilePhase _(Prof::MediumSample);
+    *wvlPdf = WvlPacketf(1.f);
+    Ray ray = WorldToMedium(
+        Ray(rWorld.o, Normalize(rWorld.d), rWorld.tMax * rWorld.d.Length()));
+    // Compute $[\tmin, \tmax]$ interval of _ray_'s overlap with medium bounds
+    const Bounds3f b(Point3f(0, 0, 0), Point3f(1, 1, 1));
+    Float tMin, tMax;
+    if (sigma_tMax == 0 || !b.IntersectP(ray, &tMin, &tMax))
+        return WvlPacketf(1.f);
+
+    // Run spectral delta tracking against the majorant; the hero wavelength
+    // classifies each tentative collision, and every wavelength records the
+    // probability with which it would have made the same choice
+    WvlPacketf sig_t = SpectrumAtWvls(sigma_a + sigma_s, rWorld.wvls);
+    WvlPacketf sig_s = SpectrumAtWvls(sigma_s, rWorld.wvls);
+    WvlPacketf f(1.f);
+    Float t = tMin;
+    while (true) {
+        t -= std::log(1 - sampler.Get1D()) * invMaxDensity / sigma_tMax;
+        if (t >= tMax) break;
+        Float density = Density(ray(t)) * invMaxDensity / sigma_tMax;
+        WvlPacketf pReal = sig_t * density;
+        if (sampler.Get1D() < pReal[0]) {
+            // Populate _mi_ with medium interaction information and return
+            PhaseFunction *phase = ARENA_ALLOC(arena, HenyeyGreenstein)(g);
+            *mi = MediumInteraction(rWorld(t), -rWorld.d, rWorld.wvls,
+                                    rWorld.time, this, phase);
+            *wvlPdf *= pReal;
+            return f * sig_s * density;
+        }
+        // Continue past a null collision
+        WvlPacketf pNull = WvlPacketf(1.f) - pReal;
+        f *= pNull;
+        *wvlPdf *= pNull;
+    }
+    return f;
+}
+
 }  // namespace pbrt
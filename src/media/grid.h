@@ -66,10 +66,7 @@ class GridDensityMedium : public Medium {
         memcpy((Float *)density.get(), d, sizeof(Float) * nx * ny * nz);
         // Precompute values for Monte Carlo sampling of _GridDensityMedium_
         sigma_t = (sigma_a + sigma_s)[0];
-        if (Spectrum(sigma_t) != sigma_a + sigma_s)
-            Error(
-                "GridDensityMedium requires a spectrally uniform attenuation "
-                "coefficient!");
+        sigma_tMax = (sigma_a + sigma_s).MaxComponentValue();
         Float maxDensity = 0;
         for (int i = 0; i < nx * ny * nz; ++i)
             maxDensity = std::max(maxDensity, density[i]);
@@ -77,6 +74,9 @@ class GridDensityMedium : public Medium {
     }
 
     Float Density(const Point3f &p) const;
+    bool SpectrallyUniform() const {
+        return Spectrum(sigma_t) == sigma_a + sigma_s;
+    }
     Float D(const Point3i &p) const {
         Bounds3i sampleBounds(Point3i(0, 0, 0), Point3i(nx, ny, nz));
         if (!InsideExclusive(p, sampleBounds)) return 0;
@@ -85,6 +85,9 @@ class GridDensityMedium : public Medium {
     Spectrum Sample(const Ray &ray, Sampler &sampler, MemoryArena &arena,
                     MediumInteraction *mi) const;
     Spectrum Tr(const Ray &ray, Sampler &sampler) const;
+    WvlPacketf TrWvls(const Ray &ray, Sampler &sampler) const;
+    WvlPacketf SampleWvls(const Ray &ray, Sampler &sampler, MemoryArena &arena,
+                          MediumInteraction *mi, WvlPacketf *wvlPdf) const;
 
   private:
     // GridDensityMedium Private Data
@@ -94,6 +97,9 @@ class GridDensityMedium : public Medium {
     const Transform WorldToMedium;
     std::unique_ptr<Float[]> density;
     Float sigma_t;
+    // Largest attenuation over the spectrum; with the density maximum it
+    // bounds the extinction of every wavelength for spectral tracking
+    Float sigma_tMax;
     Float invMaxDensity;
 };
 
@@ -75,4 +75,39 @@ Spectrum HomogeneousMedium::Sample(const Ray &ray, Sampler &sampler,
     return sampledMedium ? (Tr * sigma_s / pdf) : (Tr / pdf);
 }
 
+WvlPacketf HomogeneousMedium::TrWvls(const Ray &ray, Sampler &sampler) const {
+    ProfilePhase _(Prof::MediumTr);
+    WvlPacketf sig_t = SpectrumAtWvls(sigma_t, ray.wvls);
+    Float d = std::min(ray.tMax * ray.d.Length(), MaxFloat);
+    WvlPacketf Tr;
+    for (int i = 0; i < Tr.nSamples; ++i) Tr[i] = std::exp(-sig_t[i] * d);
+    return Tr;
+}
+
+WvlPacketf HomogeneousMedium::SampleWvls(const Ray &ray, Sampler &sampler,
+                                         MemoryArena &arena,
+                                         MediumInteraction *mi,
+                                         WvlPacketf *wvlPdf) const {
+    ProfilePhase _(Prof::MediumSample);
+    // Sample a distance along the ray with the hero wavelength's attenuation
+    WvlPacketf sig_t = SpectrumAtWvls(sigma_t, ray.wvls);
+    WvlPacketf sig_s = SpectrumAtWvls(sigma_s, ray.wvls);
+    Float dist = -std::log(1 - sampler.Get1D()) / sig_t[0];
+    Float t = std::min(dist / ray.d.Length(), ray.tMax);
+    bool sampledMedium = t < ray.tMax;
+    if (sampledMedium)
+        *mi = MediumInteraction(ray(t), -ray.d, ray.wvls, ray.time, this,
+                                ARENA_ALLOC(arena, HenyeyGreenstein)(g));
+
+    // Compute the transmittance, throughput and sampling density per wavelength
+    Float d = std::min(t, MaxFloat) * ray.d.Length();
+    WvlPacketf f;
+    for (int i = 0; i < f.nSamples; ++i) {
+        Float Tr = std::exp(-sig_t[i] * d);
+        f[i] = sampledMedium ? Tr * sig_s[i] : Tr;
+        (*wvlPdf)[i] = sampledMedium ? Tr * sig_t[i] : Tr;
+    }
+    return f;
+}
+
 }  // namespace pbrt
@@ -55,6 +55,9 @@ class HomogeneousMedium : public Medium {
     Spectrum Tr(const Ray &ray, Sampler &sampler) const;
     Spectrum Sample(const Ray &ray, Sampler &sampler, MemoryArena &arena,
                     MediumInteraction *mi) const;
+    WvlPacketf TrWvls(const Ray &ray, Sampler &sampler) const;
+    WvlPacketf SampleWvls(const Ray &ray, Sampler &sampler, MemoryArena &arena,
+                          MediumInteraction *mi, WvlPacketf *wvlPdf) const;
 
   private:
     // HomogeneousMedium Private Data
@@ -186,6 +186,50 @@ Bounds3f Triangle::WorldBound() const {
     return Union(Bounds3f(p0, p1), p2);
 }
 
+Bounds3f Triangle::ClippedWorldBound(const Bounds3f &clip) const {
+    // Clip the triangle against the six planes of _clip_ in turn; the
+    // polygon that remains has at most nine vertices
+    Point3f poly[9], clipped[9];
+    poly[0] = mesh->p[v[0]];
+    poly[1] = mesh->p[v[1]];
+    poly[2] = mesh->p[v[2]];
+    int nVertices = 3;
+    for (int axis = 0; axis < 3; ++axis) {
+        for (int side = 0; side < 2; ++side) {
+            Float plane = clip[side][axis];
+            int nClipped = 0;
+            for (int i = 0; i < nVertices; ++i) {
+                const Point3f &a = poly[i], &b = poly[(i + 1) % nVertices];
+                bool aInside = side == 0 ? a[axis] >= plane : a[axis] <= plane;
+                bool bInside = side == 0 ? b[axis] >= plane : b[axis] <= plane;
+                if (aInside) clipped[nClipped++] = a;
+                if (aInside != bInside) {
+                    // Add the edge's intersection with the plane
+                    Float t = (plane - a[axis]) / (b[axis] - a[axis]);
+                    Point3f p = Lerp(Clamp(t, 0, 1), a, b);
+                    p[axis] = plane;
+                    clipped[nClipped++] = p;
+                }
+            }
+            if (nClipped == 0) return Bounds3f();
+            nVertices = nClipped;
+            for (int i = 0; i < nVertices; ++i) poly[i] = clipped[i];
+        }
+    }
+
+    // Bound the clipped polygon, padding for the rounding error in the
+    // computed edge intersections
+    Bounds3f b(poly[0]);
+    for (int i = 1; i < nVertices; ++i) b = Union(b, poly[i]);
+    Bounds3f worldBound = WorldBound();
+    Float maxAbs = 0;
+    for (int c = 0; c < 3; ++c)
+        maxAbs = std::max({maxAbs, std::abs(worldBound.pMin[c]),
+                           std::abs(worldBound.pMax[c])});
+    b = Expand(b, gamma(16) * maxAbs);
+    return pbrt::Intersect(pbrt::Intersect(b, worldBound), clip);
+}
+
 bool Triangle::Intersect(const Ray &ray, Float *tHit, SurfaceInteraction *isect,
                          bool testAlphaTexture) const {
     ProfilePhase p(Prof::TriIntersect);
@@ -82,6 +82,13 @@ class Triangle : public Shape {
     }
     Bounds3f ObjectBound() const;
     Bounds3f WorldBound() const;
+    Bounds3f ClippedWorldBound(const Bounds3f &clip) const;
+    bool GetTriangleVertices(Point3f p[3]) const {
+        p[0] = mesh->p[v[0]];
+        p[1] = mesh->p[v[1]];
+        p[2] = mesh->p[v[2]];
+        return true;
+    }
     bool Intersect(const Ray &ray, Float *tHit, SurfaceInteraction *isect,
                    bool testAlphaTexture = true) const;
     bool IntersectP(const Ray &ray, bool testAlphaTexture = true) const;
@@ -0,0 +1,436 @@
+
+#include "tests/gtest/gtest.h"
+#include "pbrt.h"
+#include "accelerators/bvh.h"
+#include "accelerators/kdtreeaccel.h"
+#include "interaction.h"
+#include "parallel.h"
+#include "primitive.h"
+#include "rng.h"
+#include "sampling.h"
+#include "shapes/sphere.h"
+#include "shapes/triangle.h"
+#include <chrono>
+#ifdef PBRT_IS_WINDOWS
+#include <direct.h>
+#include <io.h>
+#else
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+using namespace pbrt;
+
+static std::vector<std::shared_ptr<Primitive>> RandomSpheres(
+    RNG &rng, int n, std::vector<Transform> *transforms) {
+    // Scatter small spheres through $[-10,10]^3$; _transforms_ keeps the
+    // object-to-world transforms alive for the shapes
+    transforms->clear();
+    transforms->reserve(2 * n);
+    std::vector<std::shared_ptr<Primitive>> prims;
+    MediumInterface mediumInterface;
+    for (int i = 0; i < n; ++i) {
+        Vector3f p(-10 + 20 * rng.UniformFloat(), -10 + 20 * rng.UniformFloat(),
+                   -10 + 20 * rng.UniformFloat());
+        transforms->push_back(Translate(p));
+        transforms->push_back(Inverse(transforms->back()));
+        Float radius = .1f + .5f * rng.UniformFloat();
+        std::shared_ptr<Shape> sphere = std::make_shared<Sphere>(
+            &(*transforms)[2 * i], &(*transforms)[2 * i + 1], false, radius,
+            -radius, radius, 360);
+        prims.push_back(std::make_shared<GeometricPrimitive>(
+            sphere, nullptr, nullptr, mediumInterface));
+    }
+    return prims;
+}
+
+TEST(BVHAccel, PacketMatchesSingleRay) {
+    RNG rng;
+    std::vector<Transform> transforms;
+    BVHAccel bvh(RandomSpheres(rng, 500, &transforms), 4);
+
+    const int nRays = 37;
+    for (int trial = 0; trial < 50; ++trial) {
+        // Alternate between coherent bundles that share an origin and
+        // incoherent ones that exercise the single-ray fallback
+        bool coherent = (trial & 1) == 0;
+        Point3f o(-15 + 30 * rng.UniformFloat(), -15 + 30 * rng.UniformFloat(),
+                  -15 + 30 * rng.UniformFloat());
+        Vector3f axis = Normalize(Point3f(0, 0, 0) - o);
+        Ray rays[nRays], packetRays[nRays];
+        for (int i = 0; i < nRays; ++i) {
+            Point2f u(rng.UniformFloat(), rng.UniformFloat());
+            Vector3f d = coherent
+                             ? Normalize(axis + .2f * UniformSampleSphere(u))
+                             : UniformSampleSphere(u);
+            Point3f org = coherent ? o
+                                   : Point3f(-15 + 30 * rng.UniformFloat(),
+                                             -15 + 30 * rng.UniformFloat(),
+                                             -15 + 30 * rng.UniformFloat());
+            Float tMax = (i % 3 == 0) ? 10.f : Infinity;
+            rays[i] = packetRays[i] = Ray(org, d, tMax);
+        }
+
+        // Shadow queries must agree before the closest-hit test shortens
+        // the rays' _tMax_
+        bool occluded[nRays];
+        bvh.IntersectPPacket(packetRays, nRays, occluded);
+        for (int i = 0; i < nRays; ++i)
+            EXPECT_EQ(bvh.IntersectP(rays[i]), occluded[i]);
+
+        SurfaceInteraction isects[nRays];
+        bool hits[nRays];
+        bvh.IntersectPacket(packetRays, nRays, isects, hits);
+        for (int i = 0; i < nRays; ++i) {
+            SurfaceInteraction isect;
+            EXPECT_EQ(bvh.Intersect(rays[i], &isect), hits[i]);
+            EXPECT_EQ(rays[i].tMax, packetRays[i].tMax);
+            if (hits[i]) EXPECT_EQ(isect.primitive, isects[i].primitive);
+        }
+    }
+}
+
+static std::vector<Ray> RandomRays(RNG &rng, int n) {
+    std::vector<Ray> rays;
+    for (int i = 0; i < n; ++i) {
+        Point3f o(-15 + 30 * rng.UniformFloat(), -15 + 30 * rng.UniformFloat(),
+                  -15 + 30 * rng.UniformFloat());
+        Point2f u(rng.UniformFloat(), rng.UniformFloat());
+        Vector3f d = UniformSampleSphere(u);
+        rays.push_back(Ray(o, d, (i % 3 == 0) ? 10.f : Infinity));
+    }
+    return rays;
+}
+
+// Checks that two aggregates over the same primitives agree on shadow
+// queries, closest-hit distances and the primitives hit.
+static void ExpectSameHits(const Primitive &a, const Primitive &b,
+                           const std::vector<Ray> &rays) {
+    for (const Ray &r : rays) {
+        EXPECT_EQ(a.IntersectP(r), b.IntersectP(r));
+        Ray ra = r, rb = r;
+        SurfaceInteraction isectA, isectB;
+        bool hit = a.Intersect(ra, &isectA);
+        EXPECT_EQ(hit, b.Intersect(rb, &isectB));
+        EXPECT_EQ(ra.tMax, rb.tMax);
+        if (hit) EXPECT_EQ(isectA.primitive, isectB.primitive);
+    }
+}
+
+TEST(BVHAccel, WideMatchesBinary) {
+    RNG rng;
+    std::vector<Transform> transforms;
+    std::vector<std::shared_ptr<Primitive>> prims =
+        RandomSpheres(rng, 1000, &transforms);
+    BVHAccel binary(prims, 4);
+    for (int layout = 0; layout < 6; ++layout) {
+        // Full-precision and 8- and 16-bit quantized bounds at each width
+        int width = (layout & 1) ? 8 : 4, quantizeBits = 8 * (layout / 2);
+        BVHAccel wide(prims, 4, BVHAccel::SplitMethod::SAH, width,
+                      quantizeBits);
+        EXPECT_EQ(binary.WorldBound(), wide.WorldBound());
+        ExpectSameHits(binary, wide, RandomRays(rng, 2000));
+    }
+}
+
+TEST(BVHAccel, ParallelBuildMatchesSerial) {
+    RNG rng;
+    std::vector<Transform> transforms;
+    std::vector<std::shared_ptr<Primitive>> prims =
+        RandomSpheres(rng, 100000, &transforms);
+
+    // Build once on a single thread and once with parallel tasks and
+    // binning; the trees should be identical
+    int nThreads = PbrtOptions.nThreads;
+    PbrtOptions.nThreads = 1;
+    BVHAccel serial(prims, 4);
+    PbrtOptions.nThreads = nThreads;
+    ParallelInit();
+    BVHAccel parallel(prims, 4);
+    ParallelCleanup();
+
+    EXPECT_EQ(serial.NodeBytes(), parallel.NodeBytes());
+    EXPECT_EQ(serial.WorldBound(), parallel.WorldBound());
+    ExpectSameHits(serial, parallel, RandomRays(rng, 2000));
+}
+
+TEST(KdTreeAccel, ParallelBuildMatchesSerial) {
+    RNG rng;
+    std::vector<Transform> transforms;
+    std::vector<std::shared_ptr<Primitive>> prims =
+        RandomSpheres(rng, 50000, &transforms);
+
+    // Subtrees built as parallel tasks are spliced back in serial order,
+    // so both builds should give the same tree
+    int nThreads = PbrtOptions.nThreads;
+    PbrtOptions.nThreads = 1;
+    KdTreeAccel serial(prims);
+    PbrtOptions.nThreads = nThreads;
+    ParallelInit();
+    KdTreeAccel parallel(prims);
+    ParallelCleanup();
+
+    EXPECT_EQ(serial.NodeBytes(), parallel.NodeBytes());
+    EXPECT_EQ(serial.WorldBound(), parallel.WorldBound());
+    ExpectSameHits(serial, parallel, RandomRays(rng, 2000));
+}
+
+// Creates an empty directory with a unique name so that cache files left
+// over from earlier runs can't be picked up.
+static std::string MakeTempDir() {
+#ifdef PBRT_IS_WINDOWS
+    char dir[] = "pbrt-test-XXXXXX";
+    if (_mktemp_s(dir, sizeof(dir)) != 0 || _mkdir(dir) != 0) return "";
+    return dir;
+#else
+    char dir[] = "/tmp/pbrt-test-XXXXXX";
+    return mkdtemp(dir) ? dir : "";
+#endif
+}
+
+static int RemoveDir(const std::string &dir) {
+#ifdef PBRT_IS_WINDOWS
+    return _rmdir(dir.c_str());
+#else
+    return rmdir(dir.c_str());
+#endif
+}
+
+TEST(BVHAccel, CacheRoundTrip) {
+    ParallelInit();
+    RNG rng;
+    std::vector<Transform> transforms;
+    std::vector<std::shared_ptr<Primitive>> prims =
+        RandomSpheres(rng, 1000, &transforms);
+    std::string cacheDir = MakeTempDir();
+    ASSERT_FALSE(cacheDir.empty());
+
+    // The first build writes the cache and the second one maps it
+    BVHAccel built(prims, 4, BVHAccel::SplitMethod::SAH, 2, 0, cacheDir);
+    EXPECT_FALSE(built.LoadedFromCache());
+    BVHAccel cached(prims, 4, BVHAccel::SplitMethod::SAH, 2, 0, cacheDir);
+    EXPECT_TRUE(cached.LoadedFromCache());
+    EXPECT_EQ(built.CacheFilename(), cached.CacheFilename());
+    EXPECT_EQ(built.NodeBytes(), cached.NodeBytes());
+    EXPECT_EQ(built.WorldBound(), cached.WorldBound());
+    ExpectSameHits(built, cached, RandomRays(rng, 2000));
+
+    // Different build parameters must not reuse the cache
+    BVHAccel other(prims, 2, BVHAccel::SplitMethod::SAH, 2, 0, cacheDir);
+    EXPECT_FALSE(other.LoadedFromCache());
+    EXPECT_NE(built.CacheFilename(), other.CacheFilename());
+
+    // SBVH builds depend on more than the primitive bounds and never cache
+    BVHAccel sbvh(prims, 4, BVHAccel::SplitMethod::SBVH, 2, 0, cacheDir);
+    EXPECT_FALSE(sbvh.LoadedFromCache());
+    EXPECT_TRUE(sbvh.CacheFilename().empty());
+
+    EXPECT_EQ(0, remove(built.CacheFilename().c_str()));
+    EXPECT_EQ(0, remove(other.CacheFilename().c_str()));
+    EXPECT_EQ(0, RemoveDir(cacheDir));
+    ParallelCleanup();
+}
+
+static std::vector<std::shared_ptr<Primitive>> RandomSlivers(
+    RNG &rng, int nTriangles, const Transform *identity) {
+    // Long, thin triangles running diagonally across $[-10,10]^3$
+    std::vector<Point3f> p;
+    std::vector<int> indices;
+    for (int i = 0; i < nTriangles; ++i) {
+        Point3f a(-10 + 20 * rng.UniformFloat(), -10 + 20 * rng.UniformFloat(),
+                  -10 + 20 * rng.UniformFloat());
+        Point3f b(-10 + 20 * rng.UniformFloat(), -10 + 20 * rng.UniformFloat(),
+                  -10 + 20 * rng.UniformFloat());
+        Vector3f offset(.05f * rng.UniformFloat(), .05f * rng.UniformFloat(),
+                        .05f * rng.UniformFloat());
+        for (Point3f v : {a, b, a + offset}) {
+            indices.push_back(p.size());
+            p.push_back(v);
+        }
+    }
+    std::vector<std::shared_ptr<Primitive>> prims;
+    MediumInterface mediumInterface;
+    for (const std::shared_ptr<Shape> &tri : CreateTriangleMesh(
+             identity, identity, false, nTriangles, indices.data(), p.size(),
+             p.data(), nullptr, nullptr, nullptr, nullptr, nullptr))
+        prims.push_back(std::make_shared<GeometricPrimitive>(
+            tri, nullptr, nullptr, mediumInterface));
+    return prims;
+}
+
+TEST(BVHAccel, SBVHMatchesSAH) {
+    // Diagonal slivers make the object split's children overlap, so the
+    // SBVH build clips and duplicates references
+    RNG rng;
+    Transform identity;
+    std::vector<std::shared_ptr<Primitive>> prims =
+        RandomSlivers(rng, 2000, &identity);
+    BVHAccel sah(prims, 4);
+    BVHAccel sbvh(prims, 4, BVHAccel::SplitMethod::SBVH);
+    EXPECT_EQ(sah.WorldBound(), sbvh.WorldBound());
+    ExpectSameHits(sah, sbvh, RandomRays(rng, 5000));
+}
+
+TEST(BVHAccel, TriangleBlocksMatchScalar) {
+    RNG rng;
+    Transform identity;
+    std::vector<std::shared_ptr<Primitive>> prims =
+        RandomSlivers(rng, 2000, &identity);
+    std::vector<Transform> transforms;
+    for (const std::shared_ptr<Primitive> &sphere :
+         RandomSpheres(rng, 100, &transforms))
+        prims.push_back(sphere);
+
+    // Leaves that mix in spheres keep using the per-primitive tests
+    for (int width : {2, 4}) {
+        BVHAccel scalar(prims, 8, BVHAccel::SplitMethod::SAH, width);
+        BVHAccel blocks(prims, 8, BVHAccel::SplitMethod::SAH, width, 0, "",
+                        0.3f, true);
+        ExpectSameHits(scalar, blocks, RandomRays(rng, 5000));
+    }
+}
+
+TEST(BVHAccel, RefitMatchesRebuild) {
+    // Place one instance many times, move the placements and compare the
+    // refit aggregate against one built from scratch
+    RNG rng;
+    std::vector<Transform> transforms;
+    std::shared_ptr<Primitive> instance =
+        std::make_shared<BVHAccel>(RandomSpheres(rng, 50, &transforms), 4);
+    const int nPlacements = 200;
+    std::vector<Transform> placements(2 * nPlacements);
+    std::vector<std::shared_ptr<TransformedPrimitive>> tprims;
+    std::vector<std::shared_ptr<Primitive>> prims;
+    auto place = [&](int i) {
+        Vector3f offset(-20 + 40 * rng.UniformFloat(),
+                        -20 + 40 * rng.UniformFloat(),
+                        -20 + 40 * rng.UniformFloat());
+        placements[2 * i] = Translate(offset) * Scale(.2f, .2f, .2f);
+        placements[2 * i + 1] = placements[2 * i];
+        return AnimatedTransform(&placements[2 * i], 0,
+                                 &placements[2 * i + 1], 1);
+    };
+    for (int i = 0; i < nPlacements; ++i) {
+        tprims.push_back(std::make_shared<TransformedPrimitive>(instance,
+                                                                place(i)));
+        prims.push_back(tprims.back());
+    }
+    BVHAccel refit(prims, 4);
+
+    for (int frame = 0; frame < 3; ++frame) {
+        for (int i = 0; i < nPlacements; ++i)
+            tprims[i]->SetPrimitiveToWorld(place(i));
+        ASSERT_TRUE(refit.Refit());
+        BVHAccel rebuilt(prims, 4);
+        EXPECT_EQ(rebuilt.WorldBound(), refit.WorldBound());
+        EXPECT_GE(refit.SAHCost(), 0);
+        ExpectSameHits(rebuilt, refit, RandomRays(rng, 2000));
+    }
+}
+
+TEST(BVHAccel, MotionSegmentsMatchFullShutter) {
+    // Move and spin instances across the shutter; per-segment node bounds
+    // must find the same hits as the whole-shutter bounds
+    RNG rng;
+    std::vector<Transform> transforms;
+    std::shared_ptr<Primitive> instance =
+        std::make_shared<BVHAccel>(RandomSpheres(rng, 50, &transforms), 4);
+    const int nPlacements = 200;
+    std::vector<Transform> placements(2 * nPlacements);
+    std::vector<std::shared_ptr<Primitive>> prims;
+    for (int i = 0; i < nPlacements; ++i) {
+        Vector3f offset(-20 + 40 * rng.UniformFloat(),
+                        -20 + 40 * rng.UniformFloat(),
+                        -20 + 40 * rng.UniformFloat());
+        Vector3f motion(-8 + 16 * rng.UniformFloat(),
+                        -8 + 16 * rng.UniformFloat(),
+                        -8 + 16 * rng.UniformFloat());
+        placements[2 * i] = Translate(offset) * Scale(.2f, .2f, .2f);
+        placements[2 * i + 1] = Translate(offset + motion) *
+                                Rotate(180 * rng.UniformFloat(), motion) *
+                                Scale(.2f, .2f, .2f);
+        prims.push_back(std::make_shared<TransformedPrimitive>(
+            instance, AnimatedTransform(&placements[2 * i], 0,
+                                        &placements[2 * i + 1], 1)));
+    }
+    BVHAccel full(prims, 4);
+    BVHAccel segmented(prims, 4);
+    segmented.BuildMotionBounds(8, 0, 1);
+    EXPECT_EQ(full.WorldBound(), segmented.WorldBound());
+
+    // Include times outside the segmented range
+    std::vector<Ray> rays = RandomRays(rng, 4000);
+    for (Ray &r : rays) r.time = -.25f + 1.5f * rng.UniformFloat();
+    ExpectSameHits(full, segmented, rays);
+}
+
+// Compares node memory and closest-hit throughput of the binary, wide and
+// quantized node layouts; run with --gtest_also_run_disabled_tests.
+TEST(BVHAccel, DISABLED_LayoutBenchmark) {
+    RNG rng;
+    std::vector<Transform> transforms;
+    std::vector<std::shared_ptr<Primitive>> prims =
+        RandomSpheres(rng, 200000, &transforms);
+    std::vector<Ray> rays = RandomRays(rng, 1000000);
+    ParallelInit();
+    const int layouts[][2] = {{2, 0}, {4, 0}, {8, 0}, {4, 8},
+                              {4, 16}, {8, 8}, {8, 16}};
+    for (const auto &layout : layouts) {
+        int width = layout[0], quantizeBits = layout[1];
+        BVHAccel bvh(prims, 4, BVHAccel::SplitMethod::SAH, width,
+                     quantizeBits);
+        auto start = std::chrono::steady_clock::now();
+        int nHits = 0;
+        for (Ray r : rays) {
+            SurfaceInteraction isect;
+            if (bvh.Intersect(r, &isect)) ++nHits;
+        }
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        printf("BVH width %d, quantize %2d: %.2f MB of nodes, %.2f Mrays/s "
+               "(%d hits)\n", width, quantizeBits,
+               bvh.NodeBytes() / (1024. * 1024.),
+               rays.size() / (1e6 * elapsed.count()), nHits);
+    }
+    ParallelCleanup();
+}
+
+// Compares closest-hit throughput of pinned threads sharing one copy of the
+// nodes, built on the main thread's node, against per-node replicas; run
+// with --gtest_also_run_disabled_tests on a multi-socket machine.
+TEST(BVHAccel, DISABLED_NumaReplicationBenchmark) {
+    RNG rng;
+    std::vector<Transform> transforms;
+    std::vector<std::shared_ptr<Primitive>> prims =
+        RandomSpheres(rng, 500000, &transforms);
+    std::vector<Ray> rays = RandomRays(rng, 2000000);
+    bool pinThreads = PbrtOptions.pinThreads;
+    PbrtOptions.pinThreads = true;
+    ParallelInit();
+    BVHAccel shared(prims, 4);
+    BVHAccel replicated(prims, 4);
+    replicated.ReplicatePerNumaNode();
+    const int64_t raysPerChunk = 4096;
+    for (const BVHAccel *bvh : {&shared, &replicated}) {
+        std::atomic<int> nHits{0};
+        auto start = std::chrono::steady_clock::now();
+        ParallelFor([&](int64_t chunk) {
+            int64_t end = std::min<int64_t>((chunk + 1) * raysPerChunk,
+                                            rays.size());
+            int hits = 0;
+            for (int64_t i = chunk * raysPerChunk; i < end; ++i) {
+                Ray r = rays[i];
+                SurfaceInteraction isect;
+                if (bvh->Intersect(r, &isect)) ++hits;
+            }
+            nHits += hits;
+        }, (rays.size() + raysPerChunk - 1) / raysPerChunk);
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        printf("%d NUMA nodes, %s nodes: %.2f Mrays/s (%d hits)\n",
+               NumaNodeCount(), bvh == &shared ? "shared    " : "replicated",
+               rays.size() / elapsed.count() / 1e6, int(nHits));
+    }
+    ParallelCleanup();
+    PbrtOptions.pinThreads = pinThreads;
+}
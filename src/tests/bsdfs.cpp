@@ -399,7 +399,7 @@ void TestBSDF(void (*createBSDF)(BSDF*, MemoryArena&),
         Point3f origin(0.1, 1,
                        0);  // offset slightly so we don't hit center of disk
         Vector3f direction(0, -1, 0);
-        Vector4f wvls(450, 500, 550, 600);
+        WvlPacketf wvls(550.f);
         Float tHit;
         Ray r(origin, direction, wvls);
         SurfaceInteraction isect;
@@ -555,3 +555,72 @@ TEST(BSDFSampling, TR_std_0p05_0p1) {
         createFresnelBlend(bsdf, arena, false, false, 0.05, 0.1);
     }, "Fresnel blend Trowbridge-Reitz, std sample, alpha = 0.05/0.1");
 }
+
+TEST(BSDFSampling, DispersiveDielectricWavelengths) {
+    // Every wavelength of the packet samples its own refracted directions
+    WvlPacketf etas;
+    for (int i = 0; i < nPacketWavelengths; ++i) etas[i] = 1.5f + .02f * i;
+    TrowbridgeReitzDistribution distrib(.3f, .3f);
+    DispersiveDielectric rough(Spectrum(1.f), Spectrum(1.f), &distrib, etas,
+                               TransportMode::Radiance);
+    DispersiveDielectric smooth(Spectrum(0.f), Spectrum(1.f), nullptr, etas,
+                                TransportMode::Radiance);
+    RNG rng;
+    for (int i = 0; i < 100; ++i) {
+        Vector3f wo = UniformSampleHemisphere(
+            Point2f(rng.UniformFloat(), rng.UniformFloat()));
+        Point2f u(rng.UniformFloat(), rng.UniformFloat());
+        for (int wvl = 0; wvl < nPacketWavelengths; ++wvl) {
+            Vector3f wi;
+            Float pdf;
+            Spectrum f = rough.Sample_f(wo, &wi, u, &pdf, wvl, nullptr);
+            if (pdf > 0) {
+                EXPECT_NEAR(pdf, rough.Pdf(wo, wi, wvl), 1e-3f * pdf);
+                EXPECT_NEAR(f[0], rough.f(wo, wi, wvl)[0], 1e-3f * f[0]);
+            }
+
+            // Smooth refraction follows Snell's law for the wavelength's eta
+            f = smooth.Sample_f(wo, &wi, u, &pdf, wvl, nullptr);
+            if (pdf > 0)
+                EXPECT_NEAR(SinTheta(wo), etas[wvl] * SinTheta(wi), 1e-4f);
+        }
+    }
+}
+
+TEST(BSDFSampling, DispersiveDielectricPackets) {
+    // Packet queries agree with querying each wavelength on its own; the
+    // spectra are constant, so every wavelength can share the first bin
+    WvlPacketf etas;
+    WvlPacketi wvlIdx(0);
+    for (int i = 0; i < nPacketWavelengths; ++i) etas[i] = 1.5f + .02f * i;
+    TrowbridgeReitzDistribution distrib(.3f, .3f);
+    DispersiveDielectric rough(Spectrum(1.f), Spectrum(1.f), &distrib, etas,
+                               TransportMode::Radiance);
+    DispersiveDielectric smooth(Spectrum(1.f), Spectrum(1.f), nullptr, etas,
+                                TransportMode::Radiance);
+    RNG rng;
+    for (int i = 0; i < 100; ++i) {
+        Vector3f wo = UniformSampleHemisphere(
+            Point2f(rng.UniformFloat(), rng.UniformFloat()));
+        Point2f u(rng.UniformFloat(), rng.UniformFloat());
+        Vector3f wi;
+        WvlPacketf pdfs;
+        WvlPacketf f = rough.Sample_fWvls(wo, &wi, u, wvlIdx, &pdfs, nullptr);
+        if (pdfs[0] > 0)
+            for (int wvl = 0; wvl < nPacketWavelengths; ++wvl) {
+                Float pdf = rough.Pdf(wo, wi, wvl);
+                Float fi = rough.f(wo, wi, wvl)[0];
+                EXPECT_NEAR(pdf, pdfs[wvl], 1e-3f * pdf);
+                EXPECT_NEAR(fi, f[wvl], 1e-3f * fi);
+            }
+
+        // Only the hero wavelength follows a sampled specular refraction
+        BxDFType type;
+        f = smooth.Sample_fWvls(wo, &wi, u, wvlIdx, &pdfs, &type);
+        if (pdfs[0] > 0 && (type & BSDF_TRANSMISSION))
+            for (int wvl = 1; wvl < nPacketWavelengths; ++wvl) {
+                EXPECT_EQ(0.f, pdfs[wvl]);
+                EXPECT_EQ(0.f, f[wvl]);
+            }
+    }
+}
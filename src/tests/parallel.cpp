@@ -3,6 +3,8 @@
 #include "pbrt.h"
 #include "parallel.h"
 #include <atomic>
+#include <chrono>
+#include <cmath>
 
 using namespace pbrt;
 
@@ -37,3 +39,92 @@ TEST(Parallel, DoNothing) {
 
     ParallelCleanup();
 }
+
+TEST(Parallel, Nested) {
+    // Loops started from inside other loops' iterations share the workers
+    int nThreads = PbrtOptions.nThreads;
+    PbrtOptions.nThreads = 4;
+    ParallelInit();
+
+    std::atomic<int> counter{0};
+    ParallelFor([&](int64_t) {
+        ParallelFor([&](int64_t) {
+            ParallelFor([&](int64_t) { ++counter; }, 50, 3);
+        }, 20);
+    }, 10);
+    EXPECT_EQ(10 * 20 * 50, counter);
+
+    counter = 0;
+    ParallelFor2D([&](Point2i p) {
+        ParallelFor([&](int64_t) { ++counter; }, 100);
+    }, Point2i(8, 8));
+    EXPECT_EQ(8 * 8 * 100, counter);
+
+    ParallelCleanup();
+    PbrtOptions.nThreads = nThreads;
+}
+
+TEST(Parallel, PinnedThreads) {
+    // Pinned threads record the NUMA node of their core
+    bool pinThreads = PbrtOptions.pinThreads;
+    int nThreads = PbrtOptions.nThreads;
+    PbrtOptions.pinThreads = true;
+    PbrtOptions.nThreads = 4;
+    ParallelInit();
+
+    std::atomic<int> counter{0}, badNodes{0};
+    ParallelFor([&](int64_t) {
+        ++counter;
+        if (ThreadNumaNode < 0 || ThreadNumaNode >= NumaNodeCount())
+            ++badNodes;
+    }, 1000);
+    EXPECT_EQ(1000, counter);
+    EXPECT_EQ(0, badNodes);
+
+    // Node threads aren't pool workers and can't start parallel loops
+    int lastNode = NumaNodeCount() - 1, node = -1, index = 0;
+    RunOnNumaNode(lastNode, [&]() {
+        node = ThreadNumaNode;
+        index = ThreadIndex;
+    });
+    EXPECT_EQ(lastNode, node);
+    EXPECT_LT(index, 0);
+    EXPECT_EQ(0, ThreadIndex);
+
+    ParallelCleanup();
+    EXPECT_EQ(0, ThreadNumaNode);
+    PbrtOptions.pinThreads = pinThreads;
+    PbrtOptions.nThreads = nThreads;
+}
+
+// Reports loop throughput with small chunks as the thread count grows;
+// run with --gtest_also_run_disabled_tests.
+TEST(Parallel, DISABLED_ScalingBenchmark) {
+    int nThreads = PbrtOptions.nThreads;
+    const int64_t count = 1 << 22;
+    std::vector<float> values(count);
+    for (int n = 1; n <= NumSystemCores(); n *= 2) {
+        PbrtOptions.nThreads = n;
+        ParallelInit();
+        for (int chunkSize : {1, 16, 256}) {
+            auto start = std::chrono::steady_clock::now();
+            ParallelFor([&](int64_t i) { values[i] = std::sqrt(float(i)); },
+                        count, chunkSize);
+            std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+            printf("%3d threads, chunk size %3d: %7.1f M iterations/s\n", n,
+                   chunkSize, count / elapsed.count() / 1e6);
+        }
+        auto start = std::chrono::steady_clock::now();
+        ParallelFor2D([&](Point2i p) {
+            for (int i = 0; i < 1024; ++i)
+                values[(p.y * 64 + p.x) * 1024 + i] += 1;
+        }, Point2i(64, 64));
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        printf("%3d threads, 2D 64x64:       %7.1f K tiles/s\n", n,
+               64 * 64 / elapsed.count() / 1e3);
+        ParallelCleanup();
+    }
+    PbrtOptions.nThreads = nThreads;
+}
@@ -92,6 +92,11 @@ class ImageTexture : public Texture<Treturn> {
         convertOut(mem, &ret);
         return ret;
     }
+    bool EvaluateRGB(const SurfaceInteraction &si, Float rgb[3]) const {
+        Vector2f dstdx, dstdy;
+        Point2f st = mapping->Map(si, &dstdx, &dstdy);
+        return convertOutRGB(mipmap->Lookup(st, dstdx, dstdy), rgb);
+    }
 
   private:
     // ImageTexture Private Methods
@@ -113,6 +118,11 @@ class ImageTexture : public Texture<Treturn> {
         *to = Spectrum::FromRGB(rgb);
     }
     static void convertOut(Float from, Float *to) { *to = from; }
+    static bool convertOutRGB(const RGBSpectrum &from, Float rgb[3]) {
+        from.ToRGB(rgb);
+        return true;
+    }
+    static bool convertOutRGB(Float from, Float rgb[3]) { return false; }
 
     // ImageTexture Private Data
     std::unique_ptr<TextureMapping2D> mapping;
@@ -52,11 +52,17 @@ class UVTexture : public Texture<Spectrum> {
     UVTexture(std::unique_ptr<TextureMapping2D> mapping)
         : mapping(std::move(mapping)) {}
     Spectrum Evaluate(const SurfaceInteraction &si) const {
+        Float rgb[3];
+        EvaluateRGB(si, rgb);
+        return Spectrum::FromRGB(rgb);
+    }
+    bool EvaluateRGB(const SurfaceInteraction &si, Float rgb[3]) const {
         Vector2f dstdx, dstdy;
         Point2f st = mapping->Map(si, &dstdx, &dstdy);
-        Float rgb[3] = {st[0] - std::floor(st[0]), st[1] - std::floor(st[1]),
-                        0};
-        return Spectrum::FromRGB(rgb);
+        rgb[0] = st[0] - std::floor(st[0]);
+        rgb[1] = st[1] - std::floor(st[1]);
+        rgb[2] = 0;
+        return true;
     }
 
   private:
@@ -178,7 +178,7 @@ int main(int argc, char* argv[]) {
             Point3f origin(
                 0.1, 1, 0);  // offset slightly so we don't hit center of disk
             Vector3f direction(0, -1, 0);
-            Vector4f wvls(450, 500, 550, 600);
+            WvlPacketf wvls(550.f);
             Float tHit;
             Ray r(origin, direction, wvls);
             SurfaceInteraction isect;
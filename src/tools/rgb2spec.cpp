@@ -0,0 +1,96 @@
+//
+// rgb2spec.cpp
+//
+// Fits the sigmoid polynomial coefficient table that SampledSpectrum uses
+// to convert RGB values to spectra, and writes it out as the source file
+// core/rgbspectrumtable.cpp. Rerun it whenever the spectral sampling range,
+// the number of spectral samples, or the CIE or illuminant data change.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "pbrt.h"
+#include "spectrum.h"
+
+using namespace pbrt;
+
+static const char *license = R"(/*
+    pbrt source code is Copyright(c) 1998-2016
+                        Matt Pharr, Greg Humphreys, and Wenzel Jakob.
+
+    This file is part of pbrt.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are
+    met:
+
+    - Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    - Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+    IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+    TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+    PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+)";
+
+static void writeValues(FILE *f, const char *name, const char *size,
+                        const Float *v, int n) {
+    fprintf(f, "const float %s[%s] = {\n", name, size);
+    for (int i = 0; i < n; ++i)
+        fprintf(f, "%s%.8ef,%s", (i % 4) ? " " : "    ", v[i],
+                (i % 4 == 3 || i == n - 1) ? "\n" : "");
+    fprintf(f, "};\n");
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: rgb2spec <output.cpp>\n");
+        return 1;
+    }
+
+    // Fit the table against the RGB response of the white illuminant
+    SampledSpectrum::Init();
+    Float rgbResponse[3][nSpectralSamples];
+    SampledSpectrum::RGBResponse(rgbResponse);
+    std::vector<Float> zNodes(RGBToSpectrumTable::res);
+    std::vector<Float> coeffs(RGBToSpectrumTable::nCoeffs);
+    RGBToSpectrumTable::Fit(rgbResponse, &zNodes[0], &coeffs[0]);
+
+    FILE *f = fopen(argv[1], "w");
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+    fprintf(f, "%s\n", license);
+    fprintf(f,
+            "// core/rgbspectrumtable.cpp*\n"
+            "// Generated by src/tools/rgb2spec.cpp for %d spectral samples "
+            "over\n// [%d, %d] nm; do not edit.\n"
+            "#include \"spectrum.h\"\n\nnamespace pbrt {\n\n",
+            nSpectralSamples, sampledLambdaStart, sampledLambdaEnd);
+    writeValues(f, "RGBToSpectrumZNodes", "RGBToSpectrumTable::res",
+                &zNodes[0], RGBToSpectrumTable::res);
+    fprintf(f, "\n");
+    writeValues(f, "RGBToSpectrumCoeffs", "RGBToSpectrumTable::nCoeffs",
+                &coeffs[0], RGBToSpectrumTable::nCoeffs);
+    fprintf(f, "\n}  // namespace pbrt\n");
+    if (fclose(f) != 0) {
+        perror(argv[1]);
+        return 1;
+    }
+    return 0;
+}